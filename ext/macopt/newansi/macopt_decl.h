@@ -0,0 +1,210 @@
+/*   macopt library header file         release 1.1          gradient-based optimizer
+
+     Copyright   (c) 2002   David J.C. MacKay
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+    GNU licenses are here :
+    http://www.gnu.org/licenses/licenses.html
+
+    Author contact details are here :
+    http://www.inference.phy.cam.ac.uk/mackay/c/macopt.html       mackay@mrao.cam.ac.uk
+
+    If you find macopt useful, please feel free to make a donation to
+    support David MacKay's research group.
+*/
+
+/* The declarations of macopt, shared by both precisions.  This file has no
+   include guard: macopt_float.h and macopt_double.h each include it once 
+   after defining REAL, the type of positions, and PREFIX(name), the public
+   name of name in that precision. */
+
+/* structure for macopt */
+typedef struct {
+  REAL tol ;    /* convergence declared when the gradient vector is smaller
+		     in magnitude than this, or when the mean absolute 
+		     step is less than this (see above) */
+  REAL grad_tol_tiny ; /* if gradient is less than this, we definitely 
+			    stop, even if we are not using a gradient 
+			    tolerance */
+  REAL step_tol_tiny ; /* if step is less than this, we stop, even if 
+			    we are not using a step tolerance */
+  int end_if_small_step ; /* defines the role of tol -- alternative is
+			     end_on_small_grad */
+  int its ;               /* number of its */
+  int itmax ;             /* max */
+  int rich ; /* whether to do the extra gradient evaluation at the beginning 
+	      of each new line min */
+  int verbose ; 
+  REAL stepmax ;        /* largest step permitted (not used in macopt) */
+
+  int linmin_maxits ;     /* in maclinmin */
+  REAL linmin_g1 ;      /* factors for growing and shrinking the interval */
+  REAL linmin_g2 ;
+  REAL linmin_g3 ;
+  REAL lastx     ;      /* keeps track of typical step length */
+  REAL lastx_default ;  /* if maclinmin is reset, lastx is set to this */
+
+
+  int  do_newitfunc ;  /* whether to run newitfunc each new iteration */
+  void (*newitfunc)(REAL *,int, void *) ; /* this function might for example
+					print the current state of the
+					simulation */
+  void *newitfuncarg ; 
+
+  /* Budget, checked between line searches.  Zero means unlimited. */
+  long max_evals ;        /* stop once this many gradients have been evaluated */
+  long long max_ns ;      /* stop once this many nanoseconds have elapsed */
+  REAL (*valuefunc)(void *) ; /* optional; returns the objective at the 
+				   point of the most recent dfunc call, which 
+				   dfunc computes along the way.  If set, the 
+				   evaluated point with the lowest value is 
+				   returned */
+  void *valuefuncarg ; 
+  void (*bestfunc)(void *) ; /* optional, with valuefunc; called with 
+				valuefuncarg whenever the most recent 
+				evaluation becomes the best point, so that 
+				the caller can keep whatever else it computed
+				there */
+
+  int (*progressfunc)(const REAL *, int, int, REAL, void *) ; 
+                          /* optional; called at the start of each line 
+			     search with the current point as a zero-based 
+			     array x[0..n-1] (no copy is made), n, the 
+			     iteration number and the objective (zero unless
+			     valuefunc is set).  Return non-zero to stop. */
+  void *progressfuncarg ; 
+
+  int keep_workspace ;    /* if non-zero, the work vectors are kept after 
+			     macopt returns and reused by later calls of no
+			     larger dimension; macopt_release frees them */
+
+  /* Filled in by macopt */
+  long evals ;            /* number of gradient evaluations made */
+  int restarts ;          /* number of times the cg directions were reset */
+  long long eval_ns ;     /* nanoseconds spent evaluating gradients */
+  long long total_ns ;    /* nanoseconds spent in total; the difference is 
+			     the optimizer's own vector arithmetic */
+  int stop_reason ;       /* one of the MACOPT_STOP_ values below */
+
+/* These should not be touched by the user. They are handy pointers for macopt
+   to use 
+*/
+  REAL gtyp ; /* stores the rms gradient for linmin */
+  REAL *best ; /* best point evaluated, when valuefunc is set */
+  REAL best_f ; 
+  REAL cur_f ; /* objective at the most recent evaluation, when valuefunc is set */
+  int cur_f_at_p ; /* whether that evaluation was at the current point */
+  long long start_ns ; /* clock at the start of the optimization */
+  REAL *pt , *gx , *gy , *gunused ;
+  REAL *xi , *g , *h ;
+  REAL *m ;  /* the metric, used in macoptIIc */
+  /* the user is responsible for allocating this and setting it */
+  REAL *mg ;  /* the natural gradient */
+  /* g, xi is covariant,  and h and mg are covariant, as is x */
+  int metric ; /* whether we are using the metric */
+  int n ;                 /* dimension of parameter space */
+  int workspace_n ;       /* dimension of the kept work vectors, or 0 */
+  int restart ;           /* whether to restart macopt - fresh cg directions */
+  /* this is only set to 1 by maclinmin or macopt */
+} PREFIX(macopt_args) ; 
+
+/* values of stop_reason, shared by both precisions */
+#ifndef MACOPT_STOP_ITMAX
+#define MACOPT_STOP_SMALL_GRAD  1  /* normal end: small gradient */
+#define MACOPT_STOP_SMALL_STEP  2  /* normal end: small step */
+#define MACOPT_STOP_ITMAX       0  /* ran out of iterations */
+#define MACOPT_STOP_EVALS       3  /* ran out of gradient evaluations */
+#define MACOPT_STOP_TIME        4  /* ran out of time */
+#define MACOPT_STOP_PROGRESS    5  /* stopped by progressfunc */
+#endif
+
+
+/* lastx :--- 1.0 might make general sense, (cf N.R.)
+				  but the best setting of all is to have 
+				  a prior idea of the eigenvalues. If 
+				  the objective function is equal to sum of N
+				  terms then set this to 1/N, for example 
+				  Err on the small side to be conservative. */
+int PREFIX(macoptIIc)
+  (REAL *,            /* starting vector                                */
+   int    ,             /* number of dimensions                           */
+   void   (*dfunc)(REAL *,REAL *, void *), /* evaluates the gradient   */
+   void   *, 
+   PREFIX(macopt_args) *
+   )  ; /* returns a status variable: 1/2 = normal end states 
+	   0 = over ran itmax */
+
+void PREFIX(macoptII)
+  (REAL *,            /* starting vector                                */
+   int    ,             /* number of dimensions                           */
+   void   (*dfunc)(REAL *,REAL *, void *), /* evaluates the gradient   */
+   void   *, 
+   PREFIX(macopt_args) *
+   )  ; 
+
+void PREFIX(maccheckgradc)(REAL *, int, REAL, 
+	       REAL (*f)(REAL *, void *), void *,
+	       void (*g)(REAL *,REAL *, void *), void * , int );	
+
+
+void PREFIX(maccheckgrad)(REAL *, int, REAL, 
+	       REAL (*f)(REAL *, void *), void *,
+	       void (*g)(REAL *,REAL *, void *), void * , int );	
+
+void PREFIX(macopt_defaults) ( PREFIX(macopt_args) * ) ;
+
+void PREFIX(macopt_allocate_metric) ( PREFIX(macopt_args) * , int ) ;
+void PREFIX(macopt_allocate) ( PREFIX(macopt_args) * , int ) ;
+void PREFIX(macopt_free) ( PREFIX(macopt_args) * ) ;
+void PREFIX(macopt_release) ( PREFIX(macopt_args) * ) ;
+
+/* the following functions could be declared static within macopt_impl.h */
+
+REAL PREFIX(maclinminII)  /* used by both macoptII and macoptIIc */
+(
+ REAL * ,
+ void   (*dfunc)(REAL *,REAL *, void *), /* evaluates the gradient */
+ void   * ,
+ PREFIX(macopt_args) * ) ;
+
+REAL PREFIX(macprodII) 
+( 
+ REAL * , REAL * , REAL  ,
+ void   (*dfunc)(REAL *,REAL *, void *), 
+ void   * , 
+ PREFIX(macopt_args) *
+) ;
+
+void PREFIX(macopt_restart) ( PREFIX(macopt_args) * , int ) ;
+
+void    PREFIX(evaluate_hessian) 
+( REAL ** ,
+  REAL * , 
+  int  ,     
+  REAL  ,
+  void   (*dfunc)(REAL *,REAL *, void *), 
+  void   *dfunc_arg, 
+  int  ) ;
+
+void    PREFIX(evaluate_hessianc) 
+( REAL ** ,
+  REAL * , 
+  int  ,     
+  REAL  ,
+  void   (*dfunc)(REAL *,REAL *, void *), 
+  void   *dfunc_arg, 
+  int  ) ;
+
@@ -0,0 +1,45 @@
+/*   macopt library          release 1.1          gradient-based optimizer
+
+     Copyright   (c) 2002   David J.C. MacKay
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+    GNU licenses are here :
+    http://www.gnu.org/licenses/licenses.html
+
+    Author contact details are here :
+    http://www.inference.phy.cam.ac.uk/mackay/c/macopt.html       mackay@mrao.cam.ac.uk
+
+    If you find macopt useful, please feel free to make a donation to
+    support David MacKay's research group.
+*/
+/* For clock_gettime */
+#define _POSIX_C_SOURCE 199309L
+
+/* #include <stdio.h>
+#include <math.h> */
+#include "../newansi/r.h"   
+/* #include "../ansi/nrutil.h" */
+/* #include "../newansi/mynr.h" */
+#include "../newansi/macopt_double.h"
+#include <float.h>
+
+#define REAL double
+#define REAL_MAX DBL_MAX
+#define PREFIX(name) d ## name
+#define PREFIX_NAME "d"
+#define VECTOR dvector
+#define FREE_VECTOR free_dvector
+#include "../newansi/macopt_impl.h"
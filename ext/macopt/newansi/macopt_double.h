@@ -0,0 +1,37 @@
+/*   macopt library header file         release 1.1          gradient-based optimizer
+
+     Copyright   (c) 2002   David J.C. MacKay
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+    GNU licenses are here :
+    http://www.gnu.org/licenses/licenses.html
+
+    Author contact details are here :
+    http://www.inference.phy.cam.ac.uk/mackay/c/macopt.html       mackay@mrao.cam.ac.uk
+
+    If you find macopt useful, please feel free to make a donation to
+    support David MacKay's research group.
+*/
+
+/* Modified to use floats by Adrian Secord 2009.  This is the double 
+   precision build of macopt_float, with the same extensions; its names 
+   start with d so that both can be linked into one program. */
+
+#define REAL double
+#define PREFIX(name) d ## name
+#include "../newansi/macopt_decl.h"
+#undef PREFIX
+#undef REAL
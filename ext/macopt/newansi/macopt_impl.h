@@ -25,12 +25,122 @@
     If you find macopt useful, please feel free to make a donation to
     support David MacKay's research group.
 */
-/* #include <stdio.h>
-#include <math.h> */
-#include "../newansi/r.h"   
-/* #include "../ansi/nrutil.h" */
-/* #include "../newansi/mynr.h" */
-#include "../newansi/macopt.h"
+
+/* The implementation of macopt, shared by both precisions.  This file has 
+   no include guard: macopt_float.c and macopt_double.c each include it once
+   after defining
+
+     REAL          the type of positions, gradients and step lengths
+     REAL_MAX      the largest finite REAL
+     PREFIX(name)  the public name of name in this precision
+     PREFIX_NAME   the same prefix as a string, for messages
+     VECTOR        nrutil's allocator of a REAL vector, and 
+     FREE_VECTOR   its deallocator
+
+   and including the header that declares PREFIX(macopt_args). */
+
+#include <time.h>
+
+/* Monotonic clock in nanoseconds, for the time budget */
+static long long macopt_clock_ns ( void ) 
+{
+  struct timespec t ; 
+  clock_gettime ( CLOCK_MONOTONIC , &t ) ; 
+  return (long long) t.tv_sec * 1000000000LL + t.tv_nsec ; 
+}
+
+/* Start of an optimization: reset the counters and the best point */
+static void macopt_begin ( PREFIX(macopt_args) *a ) 
+{
+  a->evals = 0 ; 
+  a->restarts = 0 ; 
+  a->eval_ns = 0 ; 
+  a->total_ns = 0 ; 
+  a->stop_reason = MACOPT_STOP_ITMAX ; 
+  a->best_f = REAL_MAX ; 
+  a->cur_f = 0.0 ; 
+  a->cur_f_at_p = 0 ; 
+  a->start_ns = macopt_clock_ns () ; 
+}
+
+/* Evaluate the gradient at x, which is either the current point or the 
+   line search's pt, counting and timing the evaluation.  If valuefunc is 
+   set, the objective that came with the gradient is recorded, and x is 
+   kept as the best point if it has the lowest objective so far */
+static void macopt_dfunc ( REAL *x , REAL *g , 
+			   void (*dfunc)(REAL *,REAL *, void *), void *arg , 
+			   PREFIX(macopt_args) *a ) 
+{
+  int j ; 
+  REAL f ; 
+  long long t = macopt_clock_ns () ; 
+  (*dfunc)( x , g , arg ) ; 
+  a->eval_ns += macopt_clock_ns () - t ; 
+  a->evals ++ ; 
+  if ( !a->valuefunc ) return ; 
+  f = a->cur_f = (*(a->valuefunc))( a->valuefuncarg ) ; 
+  a->cur_f_at_p = ( x != a->pt ) ; 
+  if ( f < a->best_f ) {
+    a->best_f = f ; 
+    for ( j = 1 ; j <= a->n ; j ++ ) a->best[j] = x[j] ; 
+    if ( a->bestfunc ) (*(a->bestfunc))( a->valuefuncarg ) ; 
+  }
+}
+
+/* Which budget has run out: MACOPT_STOP_EVALS, MACOPT_STOP_TIME or 0 */
+static int macopt_spent ( PREFIX(macopt_args) *a ) 
+{
+  if ( a->max_evals > 0 && a->evals >= a->max_evals ) 
+    return MACOPT_STOP_EVALS ; 
+  if ( a->max_ns > 0 && macopt_clock_ns () - a->start_ns >= a->max_ns ) 
+    return MACOPT_STOP_TIME ; 
+  return 0 ; 
+}
+
+/* Whether the evaluation or time budget has run out; sets stop_reason */
+static int macopt_out_of_budget ( PREFIX(macopt_args) *a ) 
+{
+  int reason = macopt_spent ( a ) ; 
+  if ( reason ) 
+    a->stop_reason = reason ; 
+  return reason != 0 ; 
+}
+
+/* Report progress; returns non-zero and sets stop_reason if asked to stop */
+static int macopt_progress ( REAL *p , PREFIX(macopt_args) *a ) 
+{
+  if ( a->progressfunc && 
+       (*(a->progressfunc))( p + 1 , a->n , a->its , a->cur_f , a->progressfuncarg ) ) {
+    a->stop_reason = MACOPT_STOP_PROGRESS ; 
+    return 1 ; 
+  }
+  return 0 ; 
+}
+
+/* End of an optimization: leave the best point evaluated in p.  p itself 
+   has only been evaluated if the run did not stop just after a line 
+   search (with rich set, every stop between line searches follows an 
+   evaluation at p), so at most one evaluation is added here per run, and
+   none once the budget has run out: p then counts as worse than any 
+   point evaluated */
+static void macopt_end ( REAL *p , 
+			 void (*dfunc)(REAL *,REAL *, void *), void *arg , 
+			 PREFIX(macopt_args) *a ) 
+{
+  int j ; 
+  if ( a->valuefunc ) {
+    if ( !a->cur_f_at_p ) {
+      if ( macopt_spent ( a ) ) 
+	a->cur_f = REAL_MAX ; 
+      else 
+	macopt_dfunc ( p , a->gy , dfunc , arg , a ) ; 
+    }
+    if ( a->best_f < a->cur_f ) 
+      for ( j = 1 ; j <= a->n ; j ++ ) p[j] = a->best[j] ; 
+  }
+  a->total_ns = macopt_clock_ns () - a->start_ns ; 
+  PREFIX(macopt_free) ( a ) ; 
+}
 
 /* 
    
@@ -104,20 +214,22 @@
 
  /* macoptIIc returns a status variable: 1/2 = normal end states 
 	   -1 = overran itmax */
-int macoptIIc
-  (double *p,            /* starting vector                                */
+int PREFIX(macoptIIc)
+  (REAL *p,            /* starting vector                                */
    int    n,             /* number of dimensions                           */
-   void   (*dfunc)(double *,double *, void *), 
+   void   (*dfunc)(REAL *,REAL *, void *), 
                          /* evaluates the gradient of the optimized function */
    void   *dfunc_arg,    /* arguments that get passed to dfunc             */
-   macopt_args *a        /* structure in which optimizer arguments stored  */
-   )                     /* Note, (*func)(double *,void *) is not used     */
+   PREFIX(macopt_args) *a        /* structure in which optimizer arguments stored  */
+   )                     /* Note, (*func)(REAL *,void *) is not used     */
 {
   int j , actual_itmax ;
-  double gg , gam , dgg ;
-  double *g , *h , *xi , *mg , *m ;
+  double gg , dgg ;     /* inner products are accumulated in double */
+  REAL gam ;
+  REAL *g , *h , *xi , *mg , *m ;
   int end_if_small_grad = 1 - a->end_if_small_step ;
-  double step , tmpd ;
+  REAL step ;
+  double tmpd ;
 
   /* 
      p           is provided when the optimizer is called 
@@ -132,10 +244,11 @@ int macoptIIc
 */
 
   if ( !(a->metric) ) {
-    fprintf(stderr,"warning, macoptIIc requires metric, continuing, assuming it is there\n");
+    fprintf(stderr,"warning, " PREFIX_NAME "macoptIIc requires metric, continuing, assuming it is there\n");
     a->metric = 1 ;
   }
-  macopt_allocate ( a , n ) ; 
+  PREFIX(macopt_allocate) ( a , n ) ; 
+  macopt_begin ( a ) ; 
 
   mg = a->mg ;    
   m = a->m ;    
@@ -143,26 +256,34 @@ int macoptIIc
   h = a->h ;    
   xi = a->xi ; 
   
-  (*dfunc)( p , xi , dfunc_arg );
+  macopt_dfunc ( p , xi , dfunc , dfunc_arg , a ) ; 
   for ( j = 1 ; j <= n ; j ++ ) mg[j] = - m[j] * xi[j] ; /* macoptIIc */
-  macopt_restart ( a , 1 ) ; 
+  PREFIX(macopt_restart) ( a , 1 ) ; 
   actual_itmax = ( n > 1 ) ?  a->itmax : 1 ; 
   for ( a->its = 1 ; a->its <= actual_itmax ; a->its ++ ) {
 
     for ( gg = 0.0 , j = 1 ; j <= n ; j ++ ) /* g is minus the gradient, so is mg */
       gg += g[j]*mg[j];          /* find the magnitude of the old gradient */
-    a->gtyp = sqrt ( gg / (double)(n) ) ; 
+    a->gtyp = sqrt ( gg / (REAL)(n) ) ; 
 
     if ( a->verbose > 0 ) 
       printf ( "mac_it %d of %d : gg = %6.3g tol = %6.3g: ", a->its , a->itmax , gg , a->tol ) ;
 
     if ( ( end_if_small_grad && ( gg <= a->tol ) ) 
 	|| ( gg <= a->grad_tol_tiny ) ) {
-      macopt_free ( a ) ;
+      a->stop_reason = MACOPT_STOP_SMALL_GRAD ; 
+      macopt_end ( p , dfunc , dfunc_arg , a ) ;
       if ( a->verbose > 0 ) printf ("\n");
       return (1) ; /* normal end caused by small grad */
     }
 
+    /* Report progress, and stop here, between line searches, if the 
+       budget has run out or we are asked to */
+    if ( macopt_out_of_budget ( a ) || macopt_progress ( p , a ) ) {
+      macopt_end ( p , dfunc , dfunc_arg , a ) ;
+      return ( a->stop_reason ) ;
+    }
+
     /* The following option allows you to call a subroutine which records 
        or reports the current value of the parameter vector.
        This is the beginning of a new line search
@@ -172,14 +293,15 @@ int macoptIIc
       (*(a->newitfunc))(p, a->its, a->newitfuncarg); 
     }
 
-    step = maclinminII ( p , dfunc , dfunc_arg , a ) ; 
+    step = PREFIX(maclinminII) ( p , dfunc , dfunc_arg , a ) ; 
 
     if ( a->restart == 0 ) {
       if ( a->verbose > 1 ) printf (" (step %9.5g)",step);
       if ( a->verbose > 0 ) printf ("\n");
       if ( ( a->end_if_small_step  && ( step <= a->tol ) ) 
 	  || ( step <= a->step_tol_tiny ) ) {
-	macopt_free ( a ) ;
+	a->stop_reason = MACOPT_STOP_SMALL_STEP ; 
+	macopt_end ( p , dfunc , dfunc_arg , a ) ;
 	return (2) ;  /* normal end caused by small step */
       }
     }
@@ -190,12 +312,14 @@ int macoptIIc
        left it in xi */
     if ( a->its < actual_itmax ) { /* i.e. if it is worth thinking any more.... */
       if ( a->rich || a->restart ) { 
-	(*dfunc)( p , xi , dfunc_arg ) ; 
+	macopt_dfunc ( p , xi , dfunc , dfunc_arg , a ) ; 
 	for ( j = 1 ; j <= n ; j ++ ) mg[j] = - m[j] * xi[j] ; /* macoptIIc */
       }
       if ( a->restart ) {
-	fprintf(stderr,"Restarting macopt (1)\n" ) ; 
-	macopt_restart ( a , 0 ) ;
+	if ( a->verbose > 0 ) 
+	  fprintf(stderr,"Restarting macopt (1)\n" ) ; 
+	a->restarts ++ ; 
+	PREFIX(macopt_restart) ( a , 0 ) ;
 /* this is not quite right
    should distinguish whether there was an overrun indicating that the 
    value of lastx needs to be bigger / smaller; 
@@ -215,45 +339,50 @@ int macoptIIc
 	  /* check that the inner product of gradient and line search is < 0 */
 	  tmpd -= xi[j] * g[j] ; 
 	}
-	if ( tmpd > 0.0  || a->verbose > 2 ) {
+	if ( ( tmpd > 0.0 && a->verbose > 0 ) || a->verbose > 2 ) {
 	  fprintf(stderr,"new line search has inner prod %9.4g\n", tmpd ) ; 
 	}
 	if ( tmpd > 0.0 ) { 
 	  if ( a->rich == 0 ) {
-	    fprintf (stderr, "macoptIIc - Setting rich to 1; " ) ; 
+	    if ( a->verbose > 0 ) 
+	      fprintf (stderr, PREFIX_NAME "macoptIIc - Setting rich to 1; " ) ; 
 	    a->rich = 1 ; 
 	  }
 	  a->restart = 2 ; /* signifies that g[j] = -xi[j] is already done */
-	  fprintf(stderr,"Restarting macopt (2)\n" ) ; /* is mg correct here? */
-	  macopt_restart ( a , 0 ) ;
+	  if ( a->verbose > 0 ) 
+	    fprintf(stderr,"Restarting macopt (2)\n" ) ; /* is mg correct here? */
+	  a->restarts ++ ; 
+	  PREFIX(macopt_restart) ( a , 0 ) ;
 	}
       }
     }
   }
   if ( actual_itmax > 1 )
     fprintf(stderr,"Reached iteration limit (%d) in macopt; continuing.\n",a->itmax); 
-  macopt_free ( a ) ;	
+  macopt_end ( p , dfunc , dfunc_arg , a ) ;	
   return ( actual_itmax > 1 ) ? (-1) : (0) ;   /* abnormal end caused by itn limit - BAD, unless n=1 */
 } /* NB this leaves the best value of p in the p vector, but
      the function has not been evaluated there if rich=0     */
 
 
-void macoptII
-  (double *p,            /* starting vector                                */
+void PREFIX(macoptII)
+  (REAL *p,            /* starting vector                                */
    int    n,             /* number of dimensions                           */
-   void   (*dfunc)(double *,double *, void *), 
+   void   (*dfunc)(REAL *,REAL *, void *), 
                          /* evaluates the gradient of the optimized function */
    void   *dfunc_arg,    /* arguments that get passed to dfunc             */
-   macopt_args *a        /* structure in which optimizer arguments stored  */
-   )                     /* Note, (*func)(double *,void *) is not used     */
+   PREFIX(macopt_args) *a        /* structure in which optimizer arguments stored  */
+   )                     /* Note, (*func)(REAL *,void *) is not used     */
 {
   int j , actual_itmax ;
-  double gg , gam , dgg ;
-  double *g , *h , *xi ;
+  double gg , dgg ;     /* inner products are accumulated in double */
+  REAL gam ;
+  REAL *g , *h , *xi ;
   int end_if_small_grad = 1 - a->end_if_small_step ;
-  double step , tmpd ;
+  REAL step ;
+  double tmpd ;
 
-  /* A total of 7 double * 1..n are used by this optimizer. 
+  /* A total of 7 REAL * 1..n are used by this optimizer. 
      p           is provided when the optimizer is called 
      pt          is used by the line minimizer as the temporary vector. 
                     this could be cut out with minor rewriting, using p alone
@@ -262,31 +391,40 @@ void macoptII
      the line minimizer uses an extra gx and gy to evaluate two gradients. 
      */
 
-  macopt_allocate ( a , n ) ; 
+  PREFIX(macopt_allocate) ( a , n ) ; 
+  macopt_begin ( a ) ; 
 
   g = a->g ;    
   h = a->h ;    
   xi = a->xi ; 
   
-  (*dfunc)( p , xi , dfunc_arg );
-  macopt_restart ( a , 1 ) ; 
+  macopt_dfunc ( p , xi , dfunc , dfunc_arg , a ) ; 
+  PREFIX(macopt_restart) ( a , 1 ) ; 
   actual_itmax = ( n > 1 ) ?  a->itmax : 1 ; 
   for ( a->its = 1 ; a->its <= actual_itmax ; a->its ++ ) {
 
     for ( gg = 0.0 , j = 1 ; j <= n ; j ++ ) 
       gg += g[j]*g[j];          /* find the magnitude of the old gradient */
-    a->gtyp = sqrt ( gg / (double)(n) ) ; 
+    a->gtyp = sqrt ( gg / (REAL)(n) ) ; 
 
     if ( a->verbose > 0 ) 
       printf ( "mac_it %d of %d : gg = %6.3g tol = %6.3g: ", a->its , a->itmax , gg , a->tol ) ;
 
     if ( ( end_if_small_grad && ( gg <= a->tol ) ) 
 	|| ( gg <= a->grad_tol_tiny ) ) {
-      macopt_free ( a ) ;
+      a->stop_reason = MACOPT_STOP_SMALL_GRAD ; 
+      macopt_end ( p , dfunc , dfunc_arg , a ) ;
       if ( a->verbose > 0 ) printf ("\n");
       return; /* (1) ; normal end caused by small grad */
     }
 
+    /* Report progress, and stop here, between line searches, if the 
+       budget has run out or we are asked to */
+    if ( macopt_out_of_budget ( a ) || macopt_progress ( p , a ) ) {
+      macopt_end ( p , dfunc , dfunc_arg , a ) ;
+      return;
+    }
+
     /* The following option allows you to call a subroutine which records 
        or reports the current value of the parameter vector.
        This is the beginning of a new line search
@@ -296,14 +434,15 @@ void macoptII
       (*(a->newitfunc))(p, a->its, a->newitfuncarg); 
     }
 
-    step = maclinminII ( p , dfunc , dfunc_arg , a ) ; 
+    step = PREFIX(maclinminII) ( p , dfunc , dfunc_arg , a ) ; 
 
     if ( a->restart == 0 ) {
       if ( a->verbose > 1 ) printf (" (step %9.5g)",step);
       if ( a->verbose > 0 ) printf ("\n");
       if ( ( a->end_if_small_step  && ( step <= a->tol ) ) 
 	  || ( step <= a->step_tol_tiny ) ) {
-	macopt_free ( a ) ;
+	a->stop_reason = MACOPT_STOP_SMALL_STEP ; 
+	macopt_end ( p , dfunc , dfunc_arg , a ) ;
 	return;  /* (2) ; normal end caused by small step */
       }
     }
@@ -314,11 +453,13 @@ void macoptII
        left it in xi */
     if ( a->its < actual_itmax ) { /* i.e. if it is worth thinking any more.... */
       if ( a->rich || a->restart ) { 
-	(*dfunc)( p , xi , dfunc_arg ) ; 
+	macopt_dfunc ( p , xi , dfunc , dfunc_arg , a ) ; 
       }
       if ( a->restart ) {
-	fprintf(stderr,"Restarting macoptII (1)\n" ) ; 
-	macopt_restart ( a , 0 ) ;
+	if ( a->verbose > 0 ) 
+	  fprintf(stderr,"Restarting " PREFIX_NAME "macoptII (1)\n" ) ; 
+	a->restarts ++ ; 
+	PREFIX(macopt_restart) ( a , 0 ) ;
 /* this is not quite right
    should distinguish whether there was an overrun indicating that the 
    value of lastx needs to be bigger / smaller; 
@@ -338,24 +479,27 @@ void macoptII
 	  /* check that the inner product of gradient and line search is < 0 */
 	  tmpd -= xi[j] * g[j] ; 
 	}
-	if ( tmpd > 0.0  || a->verbose > 2 ) {
+	if ( ( tmpd > 0.0 && a->verbose > 0 ) || a->verbose > 2 ) {
 	  fprintf(stderr,"new line search has inner prod %9.4g\n", tmpd ) ; 
 	}
 	if ( tmpd > 0.0 ) { 
 	  if ( a->rich == 0 ) {
-	    fprintf (stderr, "macoptII - Setting rich to 1; " ) ; 
+	    if ( a->verbose > 0 ) 
+	      fprintf (stderr, PREFIX_NAME "macoptII - Setting rich to 1; " ) ; 
 	    a->rich = 1 ; 
 	  }
 	  a->restart = 2 ; /* signifies that g[j] = -xi[j] is already done */
-	  fprintf(stderr,"Restarting macoptII (2)\n" ) ; 
-	  macopt_restart ( a , 0 ) ;
+	  if ( a->verbose > 0 ) 
+	    fprintf(stderr,"Restarting " PREFIX_NAME "macoptII (2)\n" ) ; 
+	  a->restarts ++ ; 
+	  PREFIX(macopt_restart) ( a , 0 ) ;
 	}
       }
     }
   }
   if ( actual_itmax > 1 )
     fprintf(stderr,"Reached iteration limit (%d) in macopt; continuing.\n",a->itmax); 
-  macopt_free ( a ) ;	
+  macopt_end ( p , dfunc , dfunc_arg , a ) ;	
   return;  /* (0/-1) ; abnormal end caused by time limit */
 } /* NB this leaves the best value of p in the p vector, but
      the function has not been evaluated there if rich=0     */
@@ -370,20 +514,21 @@ a simple bracketing and linear interpolation is not accurate enough.
 I wrote it this way assuming we are doing a lengthy high-d optimization
 and this would be accurate enough.
 */
-double maclinminII 
+REAL PREFIX(maclinminII) 
 (
- double *p , 
- void   (*dfunc)(double *,double *, void *), /* evaluates the gradient */
+ REAL *p , 
+ void   (*dfunc)(REAL *,REAL *, void *), /* evaluates the gradient */
  void   *arg ,
- macopt_args *a )
+ PREFIX(macopt_args) *a )
 {
   int n = a->n ; 
 
-  double x , y ;
-  double s , t , m ;
+  REAL x , y ;
+  REAL s , t , m ;
   int    its = 1 , i ;
-  double step , tmpd ; 
-  double  *gx = a->gx , *gy = a->gy , *met = a->m  , *xi = a->xi ;
+  double step ;          /* accumulated in double */
+  REAL tmpd ; 
+  REAL  *gx = a->gx , *gy = a->gy , *met = a->m  , *xi = a->xi ;
 
   if ( a->verbose >= 2 ) {
     fprintf (stderr, "doing line search in direction \n" ) ;
@@ -399,13 +544,13 @@ double maclinminII
     x = a->lastx / a->gtyp ;
     fprintf (stderr, "inner product at:\n" ) ; 
     for ( i = -TESTS ; i <= TESTS ; i += 2 ) {
-      step = x * 2.0 * (double) i / (double) TESTS ; 
+      step = x * 2.0 * (REAL) i / (REAL) TESTS ; 
       fprintf (stderr, "%9.5g %9.5g\n" , step ,
 	       tmpd = macprodII ( p , gy , step , dfunc , arg , a ) ) ; 
     }
 */
     fprintf (stderr, "inner product at 0 = %9.4g\n" ,
-	     tmpd = macprodII ( p , gy , 0.0 , dfunc , arg , a ) ) ; 
+	     tmpd = PREFIX(macprodII) ( p , gy , 0.0 , dfunc , arg , a ) ) ; 
     if ( tmpd > 0.0 ) { 
       a->restart = 1 ; 
       return 0.0 ; 
@@ -413,12 +558,12 @@ double maclinminII
   }
 
   x = a->lastx / a->gtyp ;
-  s = macprodII ( p , gx , x , dfunc , arg , a ) ; 
+  s = PREFIX(macprodII) ( p , gx , x , dfunc , arg , a ) ; 
   
   if ( s < 0 )  {  /* we need to go further */
     do {
       y = x * a->linmin_g1 ;
-      t = macprodII ( p , gy , y , dfunc , arg , a ) ; 
+      t = PREFIX(macprodII) ( p , gy , y , dfunc , arg , a ) ; 
       if ( a->verbose > 1 ) 
 	printf ("s = %6.3g: t = %6.3g; x = %6.3g y = %6.3g\n",s, t , x , y );
       if ( t >= 0.0 ) break ;
@@ -429,7 +574,7 @@ double maclinminII
   } else if ( s > 0 ) { /* need to step back inside interval */
     do {
       y = x * a->linmin_g3 ;
-      t = macprodII ( p , gy , y , dfunc , arg , a ) ; 
+      t = PREFIX(macprodII) ( p , gy , y , dfunc , arg , a ) ; 
       if ( a->verbose > 1 ) 
 	printf ("s = %6.3g: t = %6.3g; x = %6.3g y = %6.3g\n",s, t , x , y );
       if ( t <= 0.0 ) break ;
@@ -463,7 +608,7 @@ double maclinminII
  at zero? 
 */
     fprintf (stderr, "- inner product at 0 = %9.4g\n" ,
-	     tmpd = macprodII ( p , gy , 0.0 , dfunc , arg , a ) ) ; 
+	     tmpd = PREFIX(macprodII) ( p , gy , 0.0 , dfunc , arg , a ) ) ; 
     if ( tmpd > 0 && a->rich == 0 ) {
       fprintf (stderr, "setting rich to 1\n" ) ;       a->rich = 1 ; 
     }
@@ -491,34 +636,35 @@ double maclinminII
     }
 /* send back the estimated gradient in xi (NB not like linmin) */
   }
+  a->cur_f_at_p = 0 ; /* p has moved since it was last evaluated */
   a->lastx = m * a->linmin_g2 *  a->gtyp ;
-  step =  step / (double) ( n )  ;
+  step =  step / (REAL) ( n )  ;
   if ( a->metric ) { /* macoptIIc step length */
     step = sqrt(step) ; 
   }
   return ( step ) ; 
 }
 
-double macprodII 
+REAL PREFIX(macprodII) 
 ( 
- double *p , double *gy , double y , 
- void   (*dfunc)(double *,double *, void *), 
+ REAL *p , REAL *gy , REAL y , 
+ void   (*dfunc)(REAL *,REAL *, void *), 
  void   *arg , 
- macopt_args *a
+ PREFIX(macopt_args) *a
 ) {
-  double *pt = a->pt ; 
-  double *xi = a->xi ; 
+  REAL *pt = a->pt ; 
+  REAL *xi = a->xi ; 
   /* finds pt = p + y xi and gets gy there, 
 				       returning gy . xi */
   int n = a->n ; 
 
   int i;
-  double s = 0.0 ;
+  double s = 0.0 ;   /* accumulated in double */
 
   for ( i = 1 ; i <= n ; i ++ ) 
     pt[i] = p[i] + y * xi[i] ;
   
-  dfunc( pt , gy , arg ) ;
+  macopt_dfunc ( pt , gy , dfunc , arg , a ) ; 
 
   for ( i = 1 ; i <= n ; i ++ ) 
     s += gy[i] * xi[i] ;
@@ -526,7 +672,7 @@ double macprodII
   return s ;
 }
   
-void macopt_defaults ( macopt_args *a ) {
+void PREFIX(macopt_defaults) ( PREFIX(macopt_args) *a ) {
   a->verbose = 2 ; /* if verbose = 1 then there is one report for each
 		      line minimization.
 		      if verbose = 2 then there is an additional report for
@@ -552,6 +698,16 @@ void macopt_defaults ( macopt_args *a ) {
 
   a->do_newitfunc = 0 ;     /* this says whether newitfunc is set to something */
 
+  a->max_evals = 0 ;        /* no budget */
+  a->max_ns = 0 ; 
+  a->valuefunc = NULL ;     /* don't keep track of the best point */
+  a->valuefuncarg = NULL ; 
+  a->bestfunc = NULL ; 
+  a->progressfunc = NULL ;  /* no progress reports */
+  a->progressfuncarg = NULL ; 
+  a->keep_workspace = 0 ;   /* free the work vectors on return */
+  a->workspace_n = 0 ; 
+
 /* don't fiddle with the following, unless you really mean it */
   a->linmin_g1 = 2.0 ; 
   a->linmin_g2 = 1.25 ; 
@@ -560,44 +716,74 @@ void macopt_defaults ( macopt_args *a ) {
   a->metric = 0 ; /* whether we are doing things the macoptIIc way */
 }
 
-void macopt_allocate_metric (  macopt_args *a , int n ) {
+void PREFIX(macopt_allocate_metric) (  PREFIX(macopt_args) *a , int n ) {
   /* this routine illustrates how the metric should be allocated
      and set, except the 1.0s should be more interesting */
-  a->m = dvector ( 1 , n ) ; /* metric for macoptIIc */
+  a->m = VECTOR ( 1 , n ) ; /* metric for macoptIIc */
   for ( ; n >= 1 ; n -- ) a->m[n] = 1.0 ; 
-  /*    free_dvector ( a->m , 1 , n ) ;   */
+  /*    FREE_VECTOR ( a->m , 1 , n ) ;   */
 }
-void macopt_allocate (  macopt_args *a , int n ) {
+void PREFIX(macopt_allocate) (  PREFIX(macopt_args) *a , int n ) {
   a->n = n ; 
-  a->g = dvector ( 1 , n ) ; /* vectors as in NR code */
-  a->h = dvector ( 1 , n ) ; /*                       */
-  a->xi = dvector ( 1 , n ) ;/*                       */
-  a->pt = dvector ( 1 , n ) ; /* scratch vector for sole use of macprod */
-  a->gx = dvector ( 1 , n ) ; /* scratch gradients             */
-  a->gy = dvector ( 1 , n ) ; /* used by maclinmin and macprod */
-  if ( a->metric ) {  /* macoptIIc */
-    a->mg = dvector ( 1 , n ) ; /* natural gradient (contravariant) */
+  if ( a->keep_workspace ) { 
+    /* every vector is kept, so that any later call can use them */
+    if ( a->workspace_n >= n ) return ; 
+    PREFIX(macopt_release) ( a ) ; 
+    a->mg = VECTOR ( 1 , n ) ; 
+    a->best = VECTOR ( 1 , n ) ; 
+    a->workspace_n = n ; 
+  } else { 
+    if ( a->metric ) {  /* macoptIIc */
+      a->mg = VECTOR ( 1 , n ) ; /* natural gradient (contravariant) */
+    }
+    if ( a->valuefunc ) { /* best point evaluated */
+      a->best = VECTOR ( 1 , n ) ; 
+    }
   }
+  a->g = VECTOR ( 1 , n ) ; /* vectors as in NR code */
+  a->h = VECTOR ( 1 , n ) ; /*                       */
+  a->xi = VECTOR ( 1 , n ) ;/*                       */
+  a->pt = VECTOR ( 1 , n ) ; /* scratch vector for sole use of macprod */
+  a->gx = VECTOR ( 1 , n ) ; /* scratch gradients             */
+  a->gy = VECTOR ( 1 , n ) ; /* used by maclinmin and macprod */
 }
-void macopt_free ( macopt_args *a ) 
+void PREFIX(macopt_free) ( PREFIX(macopt_args) *a ) 
 {
   int n = a->n ; 
-  free_dvector ( a->xi , 1 , n ) ;
-  free_dvector ( a->h  , 1 , n ) ;
-  free_dvector ( a->g  , 1 , n ) ;  
-  free_dvector ( a->pt , 1 , n ) ;   
-  free_dvector ( a->gx , 1 , n ) ;  
-  free_dvector ( a->gy , 1 , n ) ;
+  if ( a->keep_workspace ) return ; 
+  FREE_VECTOR ( a->xi , 1 , n ) ;
+  FREE_VECTOR ( a->h  , 1 , n ) ;
+  FREE_VECTOR ( a->g  , 1 , n ) ;  
+  FREE_VECTOR ( a->pt , 1 , n ) ;   
+  FREE_VECTOR ( a->gx , 1 , n ) ;  
+  FREE_VECTOR ( a->gy , 1 , n ) ;
   if ( a->metric ) { /* macoptIIc */
-    free_dvector ( a->mg , 1 , n ) ;
+    FREE_VECTOR ( a->mg , 1 , n ) ;
+  }
+  if ( a->valuefunc ) {
+    FREE_VECTOR ( a->best , 1 , n ) ;
   }
 }
+void PREFIX(macopt_release) ( PREFIX(macopt_args) *a ) 
+{
+  int n = a->workspace_n ; 
+  if ( n == 0 ) return ; 
+  FREE_VECTOR ( a->xi , 1 , n ) ;
+  FREE_VECTOR ( a->h  , 1 , n ) ;
+  FREE_VECTOR ( a->g  , 1 , n ) ;  
+  FREE_VECTOR ( a->pt , 1 , n ) ;   
+  FREE_VECTOR ( a->gx , 1 , n ) ;  
+  FREE_VECTOR ( a->gy , 1 , n ) ;
+  FREE_VECTOR ( a->mg , 1 , n ) ;
+  FREE_VECTOR ( a->best , 1 , n ) ;
+  a->workspace_n = 0 ; 
+}
 
-void macopt_restart ( macopt_args *a , int start ) 
+void PREFIX(macopt_restart) ( PREFIX(macopt_args) *a , int start ) 
 /* if start == 1 then this is the start of a fresh macopt, not a restart */
 {
   int j , n=a->n ; 
-  double *g, *h, *xi , *mg ;
+  REAL *g, *h, *xi , *mg ;
   g = a->g ; mg = a->mg ;  h = a->h ;  xi = a->xi ; 
 
   if ( start == 0 ) a->lastx = a->lastx_default ; 
@@ -610,26 +796,26 @@ void macopt_restart ( macopt_args *a , int start )
   a->restart = 0 ; 
 }
 
-void maccheckgrad 
+void PREFIX(maccheckgrad) 
 /* Examines objective function and d_objective function to see if 
    they agree for a step of size epsilon */
-  (double *p,
+  (REAL *p,
    int    n,
-   double epsilon,
-   double (*func)(double *, void *),
+   REAL epsilon,
+   REAL (*func)(REAL *, void *),
    void   *func_arg,
-   void   (*dfunc)(double *,double *, void *),
+   void   (*dfunc)(REAL *,REAL *, void *),
    void   *dfunc_arg ,
    int    stopat          /* stop at this component. If 0, do the lot. */
 )
 {
   int j;
-  double f1;
-  double *g,*h;
-  double tmpp ; 
+  REAL f1;
+  REAL *g,*h;
+  REAL tmpp ; 
   
-  h=dvector(1,n);
-  g=dvector(1,n);
+  h=VECTOR(1,n);
+  g=VECTOR(1,n);
   f1=(*func)(p,func_arg);
   (*dfunc)(p,g,dfunc_arg);
   if ( stopat <= 0 || stopat > n ) stopat = n ; 
@@ -645,8 +831,8 @@ void maccheckgrad
     printf("%2d %12.5g %12.5g %12.5g\n" , j , g[j] , h[j]/epsilon , g[j] - h[j]/epsilon );
     fflush(stdout) ; 
   }
-  free_dvector(h,1,n);
-  free_dvector(g,1,n);
+  FREE_VECTOR(h,1,n);
+  FREE_VECTOR(g,1,n);
   printf("      --------     ---------\n");
 }
 
@@ -654,22 +840,22 @@ void maccheckgrad
   find second derivative of the log likelihood using
   the first-derivative function 
   ****************************************************/
-void    evaluate_hessian 
-( double **H , /* put the hessian here */
-  double *p ,  /* point for evaluation */
+void    PREFIX(evaluate_hessian) 
+( REAL **H , /* put the hessian here */
+  REAL *p ,  /* point for evaluation */
   int n ,               /* number of dimensions                           */
-  double epsilon ,
-  void   (*dfunc)(double *,double *, void *), 
+  REAL epsilon ,
+  void   (*dfunc)(REAL *,REAL *, void *), 
                       /* evaluates the gradient of the optimized function */
   void   *dfunc_arg,    /* arguments that get passed to dfunc             */
   int verbose )
 {
   int i,j;
-  double *g,*h;
-  double tmpp ; 
+  REAL *g,*h;
+  REAL tmpp ; 
   
-  h=dvector(1,n); /* this will store the original gradient */
-  g=dvector(1,n); /* and this the new one */
+  h=VECTOR(1,n); /* this will store the original gradient */
+  g=VECTOR(1,n); /* and this the new one */
   (*dfunc)(p,h,dfunc_arg);
 
   if ( verbose >= 1  ) {
@@ -692,8 +878,8 @@ void    evaluate_hessian
       fflush(stdout) ; 
     }
   }
-  free_dvector(h,1,n);
-  free_dvector(g,1,n);
+  FREE_VECTOR(h,1,n);
+  FREE_VECTOR(g,1,n);
 }
 
 /*
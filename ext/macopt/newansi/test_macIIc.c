@@ -24,7 +24,7 @@
 */
 #include "../newansi/r.h" 
 /* #include "../newansi/mynr.h" */
-#include "../newansi/macopt.h"
+#include "../newansi/macopt_double.h"
 
 /* 
    test program for macopt solution of equation A x = b. 
@@ -38,7 +38,7 @@ void state_printer ( double *w, int its, void *arg ) ;
 void main(int argc, char *argv[])
 {
   gq_args param;
-  macopt_args a ;
+  dmacopt_args a ;
   double *x ;
   int n , status ;
   double epsilon=0.001 ;
@@ -66,14 +66,14 @@ void main(int argc, char *argv[])
 
   /* Check that the gradient_function is the gradient of the function  */
   /* You don't have to do this, but it is a good idea when debugging ! */
-  maccheckgrad (  x , param.n , epsilon , 
+  dmaccheckgrad (  x , param.n , epsilon , 
 		quadratic , (void *)(&param) , 
 		vgrad_quadratic , (void *)(&param) , 
 		0
 		) ;
 
   /* initialize the arguments of the optimizer */
-  macopt_defaults ( &a ) ; 
+  dmacopt_defaults ( &a ) ; 
 
   /* modify macopt parameters from their default values */
   a.do_newitfunc = 1 ; /* this means that I want to have an auxiliary
@@ -87,7 +87,7 @@ void main(int argc, char *argv[])
   a.rich = 0 ; /* verbosity */
   
   /* Do an optimization */
-  status = macoptIIc ( x , param.n , 
+  status = dmacoptIIc ( x , param.n , 
 	    vgrad_quadratic , (void *)(&param) , &a
 	    ) ;
 
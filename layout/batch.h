@@ -0,0 +1,126 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_BATCH_H
+#define LAY_BATCH_H
+
+/** \file layout/batch.h
+* Optimization of many independent layouts in one call.
+*/
+
+#include <stddef.h>
+#include <layout/types.h>
+#include <layout/layout.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /** One independent layout problem for lay_optimize_batch().  The 
+        rectangle fields are as for lay_register_rects(), the margin fields 
+        as for lay_register_margins(), the per-rectangle weight fields as for
+        lay_register_weights() and the fixed flags as for 
+        lay_register_fixed().  Every per-rectangle array is registered for 
+        each problem, so a NULL array is never taken from another one.
+        
+        The problem is optimized with the settings of \c settings: its 
+        margin, broad phase, internal order, precision, number of threads and
+        optimizer settings, such as the tolerance and the iteration limit.  
+        The four penalty weights of the problem replace those of 
+        \c settings.  A zero-filled problem uses the default settings.
+    */
+    typedef struct {
+        lay_coord_t* rect_pos;      /**< Pointer to the position of the first rectangle. */
+        ptrdiff_t pos_skip;         /**< Bytes between consecutive positions, or zero if packed. */
+        lay_extent_t* rect_size;    /**< Pointer to the size of the first rectangle. */
+        ptrdiff_t size_skip;        /**< Bytes between consecutive sizes, or zero if packed. */
+        int count;                  /**< The number of rectangles. */
+        lay_real_t overlap_weight;  /**< The overlap penalty weight. */
+        lay_real_t edge_weight;     /**< The edge penalty weight. */
+        lay_real_t center_weight;   /**< The center penalty weight. */
+        lay_real_t orig_pos_weight; /**< The original position penalty weight. */
+        const lay_extent_t* margins;        /**< Per-rectangle margins, or NULL for none. */
+        ptrdiff_t margins_skip;             /**< Bytes between consecutive margins, or zero if packed. */
+        const lay_real_t* overlap_weights;  /**< Per-rectangle overlap weights, or NULL for a weight of one. */
+        ptrdiff_t overlap_weights_skip;     /**< Bytes between consecutive overlap weights, or zero if packed. */
+        const lay_real_t* orig_pos_weights; /**< Per-rectangle original position weights, or NULL for a weight of one. */
+        ptrdiff_t orig_pos_weights_skip;    /**< Bytes between consecutive weights, or zero if packed. */
+        const int* fixed;                   /**< Per-rectangle fixed flags, or NULL to let every rectangle move. */
+        ptrdiff_t fixed_skip;               /**< Bytes between consecutive flags, or zero if packed. */
+        lay_statep settings;        /**< The state whose settings are applied, which is only read and may be shared by many problems, or NULL for the defaults. */
+    } lay_problem;
+    
+    /** Worker threads for optimizing batches of problems, each with its own 
+        lay_state.  The threads wait between batches and the states keep their
+        buffers, so a batch reused for many calls to lay_run_batch() starts no
+        threads and, once its states have grown to the largest problems, 
+        allocates almost nothing.
+    */
+    typedef struct lay_batch* lay_batchp;
+    
+    /** Create a batch with \c num_threads workers, counting the calling 
+        thread.  If zero or negative, there is one per online processor. */
+    lay_batchp lay_create_batch(const int num_threads);
+    
+    /** Stop the threads of a batch and free it. */
+    void lay_destroy_batch(lay_batchp batch);
+    
+    /** Get the number of workers of a batch, counting the calling thread. */
+    int lay_get_batch_threads(const lay_batchp batch);
+    
+    /** Optimize a set of independent problems with the workers of \c batch,
+        overwriting each problem's positions as lay_optimize() does.
+        
+        The problems are sorted largest first and dealt round-robin to one 
+        queue per worker.  Each worker takes the largest problem left in its 
+        own queue and, once that is empty, steals the largest problem left in
+        another worker's queue, so the long problems start early and the 
+        short ones fill in the gaps.  Each worker optimizes all of its 
+        problems with its own state.
+        
+        \param batch The workers, which must not be running another batch.
+        \param problems The problems.  The rectangles of different problems 
+        must not share memory.
+        \param num_problems The number of problems.
+    */
+    void lay_run_batch(lay_batchp batch, const lay_problem* problems, 
+                       const int num_problems);
+    
+    /** Optimize a set of independent problems as lay_run_batch() does, with
+        a batch of no more workers than problems that is created for this 
+        call alone.  Reuse a lay_batch to keep the threads and buffers between 
+        calls.
+        
+        \param problems The problems.  The rectangles of different problems 
+        must not share memory.
+        \param num_problems The number of problems.
+        \param num_threads The number of worker threads.  If zero or negative, 
+        one per online processor is used.
+    */
+    void lay_optimize_batch(const lay_problem* problems, const int num_problems, 
+                            const int num_threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -41,6 +41,28 @@ extern "C" {
     /** Pointer to the internal liblayout state. */
     typedef struct lay_state* lay_statep;
     
+    /** Statistics gathered by the last call to lay_optimize().  Counters are 
+        cheap and always on; times are in nanoseconds of a monotonic clock. 
+        After lay_optimize_budget(), which returns the best point evaluated 
+        rather than the last, the energies are those of the best point.
+    */
+    typedef struct lay_stats {
+        long evals;                     /**< Gradient evaluations, as counted by the optimizer. */
+        int broad_phase;                /**< The broad phase used by the last evaluation, never LAY_BROAD_PHASE_AUTO. */
+        int iterations;                 /**< Conjugate gradient iterations (line searches). */
+        int restarts;                   /**< Times the conjugate directions were reset. */
+        long long candidate_pairs;      /**< Pairs tested by the overlap kernel, over all evaluations. */
+        long long overlapping_pairs;    /**< Candidate pairs that actually overlapped. */
+        long long broad_ns;             /**< Time spent finding candidate pairs in the broad phase. */
+        long long pair_ns;              /**< Time spent evaluating candidate pairs. */
+        long long penalty_ns;           /**< Time spent on the penalty terms. */
+        long long optimizer_ns;         /**< Time spent in the optimizer's own vector arithmetic. */
+        long long copy_ns;              /**< Time spent copying positions in and out of user memory. */
+        lay_real_t energy;              /**< Total energy at the last evaluation. */
+        lay_real_t overlap_energy;      /**< Weighted overlap energy at the last evaluation. */
+        lay_real_t orig_pos_energy;     /**< Weighted original position energy at the last evaluation. */
+    } lay_stats;
+    
     /** \name Initialization and setup functions */
     /*@{*/
     
@@ -71,6 +93,10 @@ extern "C" {
         of the next size.  If zero, then the data is assumed to be tightly packed, 
         and skip will be set to <tt>2 * sizeof(lay_extent_t)</tt>.  Can be negative.
         \param count The number of rectangles.
+        
+        The state's working buffers are kept if they are large enough for 
+        \c count rectangles, so a state reused for a series of problems only
+        allocates when a problem is larger than any before it.
     */
     void lay_register_rects(lay_statep state, 
                             lay_coord_t* rect_pos, const ptrdiff_t pos_skip,
@@ -78,6 +104,58 @@ extern "C" {
                             const int count
                             );
 
+    /** Register per-rectangle margins for the rectangles registered with 
+        lay_register_rects(), which must be called first and clears them.
+        The gap required between rectangles \c i and \c j is the state's 
+        margin (see lay_set_margin()) plus the margins of \c i and \c j.  The
+        margins only affect the overlap term, or with LAY_USE_INTEGER_COORDS 
+        the legalization; the registered sizes and original positions are 
+        unchanged.
+        \param state The internal state structure.
+        \param margins A pointer to the margin of the first rectangle, or NULL
+        to use no per-rectangle margins.
+        \param skip The number of bytes to add to \c margins to get to the 
+        margin of the next rectangle.  If zero, then the data is assumed to be 
+        tightly packed.  Can be negative.
+    */
+    void lay_register_margins(lay_statep state, 
+                              const lay_extent_t* margins, const ptrdiff_t skip);
+    
+    /** Register per-rectangle weights for the rectangles registered with 
+        lay_register_rects(), which must be called first and clears them.
+        The overlap of rectangles \c i and \c j is weighted by the mean of 
+        their overlap weights, times the state's overlap weight.  The distance 
+        of rectangle \c i from its original position is weighted by its 
+        original position weight, times the state's original position weight.
+        Giving important rectangles large weights makes them move less and 
+        the others yield to them.
+        \param state The internal state structure.
+        \param overlap_weights A pointer to the overlap weight of the first 
+        rectangle, or NULL for a weight of one for every rectangle.
+        \param overlap_skip The number of bytes to add to \c overlap_weights to 
+        get to the next weight.  If zero, the data is assumed to be tightly 
+        packed.  Can be negative.
+        \param orig_pos_weights A pointer to the original position weight of 
+        the first rectangle, or NULL for a weight of one for every rectangle.
+        \param orig_pos_skip As \c overlap_skip, for \c orig_pos_weights.
+    */
+    void lay_register_weights(lay_statep state, 
+                              const lay_real_t* overlap_weights, const ptrdiff_t overlap_skip,
+                              const lay_real_t* orig_pos_weights, const ptrdiff_t orig_pos_skip);
+
+    /** Register per-rectangle fixed flags for the rectangles registered with 
+        lay_register_rects(), which must be called first and clears them.
+        A fixed rectangle is not a degree of freedom: its gradient is zero, so
+        the optimizer never moves it, and it only pushes the others away.  
+        \param state The internal state structure.
+        \param fixed A pointer to the flag of the first rectangle, non-zero if
+        the rectangle is fixed, or NULL to let every rectangle move.
+        \param skip The number of bytes to add to \c fixed to get to the flag 
+        of the next rectangle.  If zero, then the data is assumed to be 
+        tightly packed.  Can be negative.
+    */
+    void lay_register_fixed(lay_statep state, const int* fixed, const ptrdiff_t skip);
+
     /*@}*/
     
     /** \name Optimization settings */
@@ -107,13 +185,233 @@ extern "C" {
     /** Set the original position penalty weight. */
     void lay_set_orig_pos_weight(lay_statep state, const lay_real_t weight);
     
+    /** Get the minimum gap between any two rectangles. */
+    lay_extent_t lay_get_margin(const lay_statep state);
+    
+    /** Set the minimum gap between any two rectangles.  The overlap penalty 
+        applies whenever two rectangles are closer than this along both axes.
+        The default is zero.
+    */
+    void lay_set_margin(lay_statep state, const lay_extent_t margin);
+    
+    /** \name Broad phases for finding overlapping pairs */
+    /*@{*/
+    #define LAY_BROAD_PHASE_AUTO    -1  /**< Choose one of the others by a calibrated cost model. */
+    #define LAY_BROAD_PHASE_NONE    0   /**< Test every pair of rectangles. */
+    #define LAY_BROAD_PHASE_HGRID   1   /**< Hierarchical grid, with a level per size class. */
+    #define LAY_BROAD_PHASE_BVH     2   /**< Dynamic bounding volume tree, updated incrementally. */
+    #define LAY_BROAD_PHASE_TILED   3   /**< Test every pair of rectangles, a cache-sized tile at a time. */
+    #define LAY_BROAD_PHASE_SAP     4   /**< Sweep and prune along the axis of greatest spread. */
+    #define LAY_BROAD_PHASE_BITSET  5   /**< Bit matrix of the intersecting pairs, for up to a few thousand rectangles. */
+    /*@}*/
+    
+    /** Get the broad phase used to find overlapping pairs. */
+    int lay_get_broad_phase(const lay_statep state);
+    
+    /** Set the broad phase used to find overlapping pairs, one of the 
+        LAY_BROAD_PHASE_ values.  Testing every pair costs O(N^2) per 
+        evaluation.  The hierarchical grid puts each rectangle in a level 
+        whose cells match its size and only tests it against nearby cells of 
+        its own and coarser levels, so its cost stays near-linear in the 
+        number of rectangles and overlaps even when sizes vary by orders of 
+        magnitude.  The bounding volume tree is kept on the state between 
+        evaluations and calls to lay_optimize(); only rectangles that move 
+        out of their slightly enlarged leaf bounds are reinserted, with tree 
+        rotations keeping it balanced, so moving k rectangles costs 
+        O(k log N) maintenance plus a containment test per rectangle.
+        The tiled kernel tests every pair like LAY_BROAD_PHASE_NONE, but on 
+        dense copies of the rectangles, one tile that fits in the L1 cache 
+        against another, with the gradients summed in per-tile buffers and 
+        written back once per tile.  It is several times faster than 
+        LAY_BROAD_PHASE_NONE and pays off over a broad phase for small 
+        problems and very dense clusters.
+        Sweep and prune sorts the rectangles by their lower edge along the 
+        axis in which their centers are most spread out, with a radix sort 
+        that costs O(N) however far they moved, and tests each against the 
+        rectangles that start before it ends along that axis, a block at a 
+        time for overlap along the other.  It suits rectangles of similar 
+        size that are spread out along at least one axis.
+        The bit matrix tests every pair of grown bounds, 64 at a time, into
+        one bit per pair, and the evaluation visits the set bits a word at a
+        time instead of reading a list of pairs.  It takes N^2 / 8 bytes, 
+        so it suits dense problems of up to about 8000 rectangles; beyond 
+        8192 rectangles sweep and prune is used in its place.
+        
+        LAY_BROAD_PHASE_AUTO predicts the cost of the tiled kernel, the grid,
+        the tree, sweep and prune and the bit matrix from the number of 
+        rectangles, the spread of their sizes and positions and the number of
+        overlapping pairs, and uses the cheapest.  The predictions are calibrated against
+        the measured time of every evaluation, and the choice is reconsidered
+        every few evaluations and at the start of each lay_optimize(), so it 
+        follows the layout as it spreads out.  The choice of the last 
+        evaluation is in lay_stats.  Setting any other 
+        value fixes the broad phase, for instance to compare them.
+        The default is LAY_BROAD_PHASE_AUTO.
+    */
+    void lay_set_broad_phase(lay_statep state, const int broad_phase);
+    
+    /** \name Internal orders of the rectangles */
+    /*@{*/
+    #define LAY_REORDER_NONE        0   /**< Keep the registered order. */
+    #define LAY_REORDER_MORTON      1   /**< Morton (Z-order) curve through the centers. */
+    #define LAY_REORDER_HILBERT     2   /**< Hilbert curve through the centers. */
+    /*@}*/
+    
+    /** Get the internal order of the rectangles. */
+    int lay_get_reorder(const lay_statep state);
+    
+    /** Set the internal order of the rectangles, one of the LAY_REORDER_ values.
+        Unless it is LAY_REORDER_NONE, each call to lay_optimize() sorts the 
+        rectangles along a space-filling curve through their current centers 
+        and optimizes dense copies of their positions, sizes, margins and 
+        weights in that order, so that rectangles that are near each other are
+        near each other in memory.  The optimized positions are copied back in 
+        the registered order.  The sort costs O(N log N) per call.  Ignored 
+        while optimizing in place or while a progress callback is set.  The 
+        default is LAY_REORDER_NONE.
+    */
+    void lay_set_reorder(lay_statep state, const int reorder);
+    
+    /** Get whether lay_optimize() may work directly in the registered positions. */
+    int lay_get_optimize_in_place(const lay_statep state);
+    
+    /** Set whether lay_optimize() may work directly in the registered positions.
+        When enabled, and the positions are tightly packed (a zero or 
+        <tt>2 * sizeof(lay_coord_t)</tt> position skip with real coordinates) 
+        in the optimizer's precision, the optimizer uses the user's array as 
+        its state vector instead of copying the positions in and out.  Intermediate positions then become 
+        visible in user memory during the optimization.  A copy of the original 
+        positions is still made if the original position weight is non-zero.
+        Off by default; ignored for other layouts.
+    */
+    void lay_set_optimize_in_place(lay_statep state, const int in_place);
+    
+    #define LAY_PRECISION_FLOAT     0   /**< Optimize in single precision. */
+    #define LAY_PRECISION_DOUBLE    1   /**< Optimize in double precision. */
+    
+    /** Get the precision of the optimizer, one of the LAY_PRECISION_ values. */
+    int lay_get_precision(const lay_statep state);
+    
+    /** Set the precision in which the optimizer keeps the positions and takes 
+        its steps, one of the LAY_PRECISION_ values.  The energy and gradient 
+        are always computed in lay_real_t, with the energy summed in double.
+        A precision other than that of lay_real_t converts the positions at 
+        each gradient evaluation and disables optimizing in place; double 
+        helps large layouts whose small steps are lost in float positions.  
+        The default is the precision of lay_real_t.  Ignored with integer 
+        coordinates.
+    */
+    void lay_set_precision(lay_statep state, const int precision);
+    
+    /** Get the number of threads used within one evaluation. */
+    int lay_get_num_threads(const lay_statep state);
+    
+    /** Set the number of threads used within one evaluation, counting the 
+        calling thread.  Zero or a negative number means one per online 
+        processor.  lay_optimize() starts the threads the first time they are
+        needed and keeps them, waiting, until the number changes or the state
+        is destroyed.  At present they build the hierarchical grid, with a 
+        parallel counting sort that gives the same grid as a single thread.
+        The default is one, which starts no threads.
+    */
+    void lay_set_num_threads(lay_statep state, const int num_threads);
+    
     /*@}*/
     
     /** Optimize the position of the input rectangles. 
         Overwrites the current positions with optimized positions.
+        If built with LAY_USE_INTEGER_COORDS, the positions are instead 
+        legalized with lay_legalize_fixed(), which removes every overlap 
+        exactly, keeps all coordinates integral and leaves the fixed 
+        rectangles (see lay_register_fixed()) in place.  The margins are kept
+        by legalizing each rectangle grown by half the state's margin, 
+        rounded up, plus its own margin, so an odd margin leaves gaps of at 
+        least one more than the margin.
     */
     void lay_optimize(lay_statep state);
     
+    /** \name Reasons for lay_optimize() to stop */
+    /*@{*/
+    #define LAY_STOP_ITERATIONS     0   /**< Reached the iteration limit. */
+    #define LAY_STOP_CONVERGED      1   /**< The gradient or step became small. */
+    #define LAY_STOP_EVALS          2   /**< Ran out of gradient evaluations. */
+    #define LAY_STOP_TIME           3   /**< Ran out of time. */
+    #define LAY_STOP_PROGRESS       4   /**< Stopped by the progress callback. */
+    /*@}*/
+    
+    /** Optimize the position of the input rectangles within a budget. 
+        As lay_optimize(), but stops between line searches once \c max_ns 
+        nanoseconds have passed on a monotonic clock or \c max_gradient_evals 
+        gradients have been evaluated, whichever comes first.  A limit of zero 
+        means no limit.  The positions with the lowest energy seen are left in 
+        the user arrays.  The energy comes with each gradient evaluation, so 
+        tracking it costs a copy of the positions whenever it improves and at 
+        most one extra evaluation per call, made only while the budget lasts.
+        The energies in the statistics are those of the positions left.  Use 
+        lay_get_stop_reason() to find out why it stopped.
+    */
+    void lay_optimize_budget(lay_statep state, const long long max_ns, 
+                             const long max_gradient_evals);
+    
+    /** Get the reason the last optimization stopped, one of the LAY_STOP_ values. */
+    int lay_get_stop_reason(const lay_statep state);
+    
+    /** Copy the statistics of the last optimization into \c stats. */
+    void lay_get_stats(const lay_statep state, lay_stats* stats);
+    
+    /** Progress callback, called by lay_optimize() before each line search.  
+        \c pos holds the current positions of all \c num_rects rectangles, 
+        tightly packed and zero-based; it points into the optimizer's own 
+        storage, so no copy is made and it must not be modified or kept.  
+        \c stats holds the statistics so far, including the energy and its 
+        components at \c pos.  Return non-zero to stop the optimization, in 
+        which case the stop reason is LAY_STOP_PROGRESS.
+    */
+    typedef int (*lay_progress_func)(const lay_coord_t* pos, const int num_rects,
+                                     const int iteration, const lay_stats* stats,
+                                     void* context);
+    
+    /** Set the progress callback, or NULL for none.  The energy reported is
+        the one computed with the last gradient, so reporting it costs no 
+        extra evaluations.  Not called when built with LAY_USE_INTEGER_COORDS.
+    */
+    void lay_set_progress_func(lay_statep state, lay_progress_func func, void* context);
+
+    /** \name Spatial queries
+        The queries share the bounding volume tree of LAY_BROAD_PHASE_BVH,
+        which they bring up to date with the registered positions as needed.
+        The first query after lay_register_rects() or lay_optimize() rescans
+        every rectangle but only reinserts those that have moved noticeably,
+        and later queries take O(log N + k) time for k results.  Rectangles
+        are closed, so touching counts as meeting.
+    */
+    /*@{*/
+
+    /** Find the rectangles that meet the region from <tt>(x0, y0)</tt> to
+        <tt>(x1, y1)</tt>, which must not be empty.  Up to \c max of their
+        indices are stored in \c out, in no particular order.
+        \return The number of rectangles found, which may exceed \c max.
+    */
+    int lay_query_region(lay_statep state,
+                         const lay_coord_t x0, const lay_coord_t y0,
+                         const lay_coord_t x1, const lay_coord_t y1,
+                         int* out, const int max);
+
+    /** Find the rectangles that contain the point <tt>(x, y)</tt>, as
+        lay_query_region() with an empty region.
+    */
+    int lay_query_point(lay_statep state, const lay_coord_t x, const lay_coord_t y,
+                        int* out, const int max);
+
+    /** Tell the queries that the registered position or size of rectangle
+        \c index has changed outside lay_optimize(), or that of every
+        rectangle if \c index is negative.  A single rectangle is updated in
+        O(log N) time; otherwise the next query rescans them all.
+    */
+    void lay_rects_moved(lay_statep state, const int index);
+
+    /*@}*/
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,461 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_LAYOUT_HPP
+#define LAY_LAYOUT_HPP
+
+/** \file layout/layout.hpp
+* Header-only C++ front end over the liblayout C API.
+*
+* The front end has two independent parts.  lay::state is a thin owning 
+* wrapper around a lay_statep: it registers data with the C library and 
+* forwards to lay_optimize(), which evaluates the energy with its own 
+* kernels, broad phases and runtime byte strides in the types fixed by 
+* layout/types.h.  The templated kernels evaluate the same terms that 
+* lay_optimize() minimizes, the overlap term and the original position term
+* with their margins and weights (the edge and center terms of eval() are 
+* compiled out), on data in any memory layout and of any coordinate and real
+* type.  lay::optimize() minimizes them with macopt in the precision of its
+* real type, so one program can lay out float and double data in any layout 
+* whatever types.h selects.  The kernels test every pair of rectangles and 
+* are meant for small sets; they do not support fixed rectangles.
+*/
+
+#include <cstddef>
+#include <vector>
+#include <layout/layout.h>
+#include <layout/macopt.h>
+
+namespace lay {
+
+    /** \name Memory layouts */
+    /*@{*/
+    
+    /** An array of structures of type \c Record with the x and y coordinates at
+        byte offsets \c XOffset and <tt>XOffset + sizeof(Coord)</tt> and the width 
+        and height at \c WOffset and <tt>WOffset + sizeof(Extent)</tt>, as in 
+        <tt>lay::aos<rect, float, float, offsetof(rect, x), offsetof(rect, width)></tt>.
+    */
+    template <typename Record, typename Coord, typename Extent, 
+              std::size_t XOffset, std::size_t WOffset>
+    struct aos {
+        typedef Coord coord_type;       /**< The coordinate type. */
+        typedef Extent extent_type;     /**< The extent type. */
+        
+        Record* records;                /**< The first record. */
+        
+        explicit aos(Record* r) : records(r) {}
+        
+        Coord& x(const int i) const {
+            return *reinterpret_cast<Coord*>(reinterpret_cast<char*>(records + i) + XOffset);
+        }
+        Coord& y(const int i) const { return (&x(i))[1]; }
+        Extent& w(const int i) const {
+            return *reinterpret_cast<Extent*>(reinterpret_cast<char*>(records + i) + WOffset);
+        }
+        Extent& h(const int i) const { return (&w(i))[1]; }
+    };
+    
+    /** Separate arrays of x coordinates, y coordinates, widths and heights. */
+    template <typename Coord, typename Extent>
+    struct soa {
+        typedef Coord coord_type;       /**< The coordinate type. */
+        typedef Extent extent_type;     /**< The extent type. */
+        
+        Coord* xs;                      /**< The x coordinates. */
+        Coord* ys;                      /**< The y coordinates. */
+        Extent* ws;                     /**< The widths. */
+        Extent* hs;                     /**< The heights. */
+        
+        soa(Coord* x_, Coord* y_, Extent* w_, Extent* h_) : xs(x_), ys(y_), ws(w_), hs(h_) {}
+        
+        Coord& x(const int i) const { return xs[i]; }
+        Coord& y(const int i) const { return ys[i]; }
+        Extent& w(const int i) const { return ws[i]; }
+        Extent& h(const int i) const { return hs[i]; }
+    };
+    
+    /*@}*/
+    
+    /** \name Kernels */
+    /*@{*/
+    
+    /** Neumaier's compensated sum, which carries the rounding error of a long 
+        sum in a second accumulator so that summing millions of pair energies 
+        in float loses almost nothing to a single float accumulator.  It 
+        relies on strict floating-point evaluation, so do not compile it with
+        options such as -ffast-math that allow reassociation.
+    */
+    template <typename Real>
+    struct compensated_sum {
+        Real sum;           /**< The running sum. */
+        Real compensation;  /**< The rounding error lost from \c sum so far. */
+        
+        compensated_sum() : sum(0), compensation(0) {}
+        
+        void add(const Real v) {
+            const Real t = sum + v;
+            if ((sum >= 0 ? sum : -sum) >= (v >= 0 ? v : -v))
+                compensation += (sum - t) + v;
+            else
+                compensation += (v - t) + sum;
+            sum = t;
+        }
+        
+        Real value() const { return sum + compensation; }
+    };
+    
+    /** The penalty settings of a layout, as those of a lay_statep.  Each 
+        per-rectangle array is dense, one value per rectangle, or null. */
+    template <typename Real, typename Extent>
+    struct penalties {
+        Real overlap_weight;            /**< As lay_set_overlap_weight(); one by default. */
+        Real orig_pos_weight;           /**< As lay_set_orig_pos_weight(); zero by default. */
+        Extent margin;                  /**< As lay_set_margin(); zero by default. */
+        const Extent* margins;          /**< As lay_register_margins(). */
+        const Real* overlap_weights;    /**< The overlap weights of lay_register_weights(). */
+        const Real* orig_pos_weights;   /**< The original position weights of lay_register_weights(). */
+        
+        penalties() : overlap_weight(1), orig_pos_weight(0), margin(0), 
+                      margins(0), overlap_weights(0), orig_pos_weights(0) {}
+    };
+    
+    /** The overlap term of two rectangles that must be kept \c margin apart, 
+        as lay_overlap_area_margin(): the area of the overlap of the two 
+        rectangles, each extent grown by \c margin, about their centers to 
+        twice their size, which is four times the true overlap area when 
+        neither contains the other along either axis.  If \c grad is 
+        non-null, the gradient with respect to x1, y1, x2 and y2 is stored in
+        it.
+    */
+    template <typename Real, typename Coord, typename Extent>
+    inline Real overlap_area(const Coord x1, const Coord y1, const Extent w1, const Extent h1,
+                             const Coord x2, const Coord y2, const Extent w2, const Extent h2,
+                             const Extent margin, Real* grad) {
+        const Coord x_len = 2 * (x2 - x1) + Coord(w2 - w1);
+        const Coord y_len = 2 * (y2 - y1) + Coord(h2 - h1);
+        const Coord x_overlap = Coord(w1 + w2 + 2 * margin) - (x_len >= 0 ? x_len : -x_len);
+        const Coord y_overlap = Coord(h1 + h2 + 2 * margin) - (y_len >= 0 ? y_len : -y_len);
+        
+        if (x_overlap <= 0 || y_overlap <= 0) {
+            if (grad) 
+                grad[0] = grad[1] = grad[2] = grad[3] = 0;
+            return 0;
+        }
+        
+        if (grad) {
+            grad[0] = Real(x_len >= 0 ? 2 : -2) * Real(y_overlap);
+            grad[1] = Real(y_len >= 0 ? 2 : -2) * Real(x_overlap);
+            grad[2] = -grad[0];
+            grad[3] = -grad[1];
+        }
+        
+        /* Multiply in the real type so that integer coordinates cannot overflow. */
+        return Real(x_overlap) * Real(y_overlap);
+    }
+    
+    /** The overlap term of lay_optimize() for \c count rectangles: the sum 
+        of overlap_area() over all pairs, with the gap between each pair the 
+        margin of \c p plus their own margins, each weighted by the mean of 
+        the pair's overlap weights and then by the overlap weight of \c p.  
+        If \c grad is non-null it must hold <tt>2 * count</tt> values and 
+        receives the gradient with respect to each rectangle's x and y, 
+        interleaved.
+    */
+    template <typename Real, typename Layout>
+    Real overlap_energy(const Layout& rects, const int count,
+                        const penalties<Real, typename Layout::extent_type>& p, 
+                        Real* grad) {
+        typedef typename Layout::extent_type extent_type;
+        compensated_sum<Real> total;
+        Real g[4];
+        int i, j, k;
+        
+        if (grad)
+            for (i = 0; i < 2 * count; ++i)
+                grad[i] = 0;
+        
+        for (i = 0; i < count; ++i) {
+            const typename Layout::coord_type xi = rects.x(i), yi = rects.y(i);
+            const extent_type wi = rects.w(i), hi = rects.h(i);
+            const extent_type mi = p.margin + (p.margins ? p.margins[i] : 0);
+            Real gx = 0, gy = 0;
+            
+            for (j = i + 1; j < count; ++j) {
+                const extent_type margin = mi + (p.margins ? p.margins[j] : 0);
+                Real a = overlap_area<Real>(xi, yi, wi, hi, 
+                                            rects.x(j), rects.y(j), rects.w(j), rects.h(j),
+                                            margin, grad ? g : static_cast<Real*>(0));
+                if (a == 0)
+                    continue;
+                if (p.overlap_weights) {
+                    /* A pair is weighted by the mean of its rectangles' weights. */
+                    const Real weight = (p.overlap_weights[i] + p.overlap_weights[j]) / 2;
+                    a *= weight;
+                    if (grad)
+                        for (k = 0; k < 4; ++k)
+                            g[k] *= weight;
+                }
+                total.add(a);
+                if (grad) {
+                    gx += g[0];
+                    gy += g[1];
+                    grad[2*j]   += g[2];
+                    grad[2*j+1] += g[3];
+                }
+            }
+            if (grad) {
+                grad[2*i]   += gx;
+                grad[2*i+1] += gy;
+            }
+        }
+        
+        if (grad)
+            for (i = 0; i < 2 * count; ++i)
+                grad[i] *= p.overlap_weight;
+        return total.value() * p.overlap_weight;
+    }
+    
+    /** The original position term of lay_optimize() for \c count 
+        rectangles: the squared distance of each from its original position, 
+        stored interleaved in \c orig, weighted by its original position 
+        weight and then by that of \c p, summed with compensation.  If 
+        \c grad is non-null it must hold <tt>2 * count</tt> values and the 
+        gradient is added to it.
+    */
+    template <typename Real, typename Layout>
+    Real anchor_energy(const Layout& rects, const typename Layout::coord_type* orig, 
+                       const int count, 
+                       const penalties<Real, typename Layout::extent_type>& p, 
+                       Real* grad) {
+        compensated_sum<Real> total;
+        int i;
+        
+        if (p.orig_pos_weight == 0)
+            return 0;
+        
+        for (i = 0; i < count; ++i) {
+            const Real weight = p.orig_pos_weight * 
+                                (p.orig_pos_weights ? p.orig_pos_weights[i] : Real(1));
+            const Real dx = Real(rects.x(i) - orig[2*i]);
+            const Real dy = Real(rects.y(i) - orig[2*i+1]);
+            total.add(weight * (dx * dx + dy * dy));
+            if (grad) {
+                grad[2*i]   += weight * 2 * dx;
+                grad[2*i+1] += weight * 2 * dy;
+            }
+        }
+        return total.value();
+    }
+    
+    /** The energy that lay_optimize() minimizes, the sum of overlap_energy()
+        and anchor_energy(), with the gradient stored in \c grad as by 
+        overlap_energy() if it is non-null. */
+    template <typename Real, typename Layout>
+    Real energy(const Layout& rects, const typename Layout::coord_type* orig, 
+                const int count, 
+                const penalties<Real, typename Layout::extent_type>& p, 
+                Real* grad) {
+        const Real overlap = overlap_energy(rects, count, p, grad);
+        return overlap + anchor_energy(rects, orig, count, p, grad);
+    }
+    
+    /** Return non-zero if any two of \c count rectangles overlap. */
+    template <typename Layout>
+    int any_overlap(const Layout& rects, const int count) {
+        int i, j;
+        for (i = 0; i < count; ++i)
+            for (j = i + 1; j < count; ++j)
+                if (overlap_area<double>(rects.x(i), rects.y(i), rects.w(i), rects.h(i),
+                                         rects.x(j), rects.y(j), rects.w(j), rects.h(j),
+                                         typename Layout::extent_type(0), 
+                                         static_cast<double*>(0)) > 0)
+                    return 1;
+        return 0;
+    }
+    
+    /*@}*/
+    
+    /** \name Optimization */
+    /*@{*/
+    
+    /** The macopt of precision \c Real.  Only float and double are defined. */
+    template <typename Real> struct macopt_traits;
+    
+    /** The float macopt. */
+    template <> struct macopt_traits<float> {
+        typedef macopt_args args_type;  /**< Its arguments. */
+        static void defaults(args_type* a) { macopt_defaults(a); }
+        static void run(float* x, const int n, void (*dfunc)(float*, float*, void*), 
+                        void* arg, args_type* a) { macoptII(x, n, dfunc, arg, a); }
+    };
+    
+    /** The double macopt. */
+    template <> struct macopt_traits<double> {
+        typedef dmacopt_args args_type; /**< Its arguments. */
+        static void defaults(args_type* a) { dmacopt_defaults(a); }
+        static void run(double* x, const int n, void (*dfunc)(double*, double*, void*), 
+                        void* arg, args_type* a) { dmacoptII(x, n, dfunc, arg, a); }
+    };
+    
+    /** Set \c a to the optimizer settings of a new lay_statep. */
+    template <typename Args>
+    void default_args(Args* a) {
+        a->itmax = 400;
+        a->verbose = 0;
+        a->tol = 1e-3;
+        a->end_if_small_step = 1;
+    }
+    
+    /** Only defined for floating-point \c T, to reject coordinates that 
+        macopt cannot move continuously. */
+    template <typename T> struct require_floating;
+    template <> struct require_floating<float> { enum { value = 1 }; };
+    template <> struct require_floating<double> { enum { value = 1 }; };
+    
+    /** The macopt callback of lay::optimize(), which writes the point it is 
+        given into the layout and evaluates energy() there. */
+    template <typename Real, typename Layout>
+    struct optimization {
+        typedef typename Layout::coord_type coord_type;
+        
+        const Layout& rects;        /**< The rectangles being laid out. */
+        int count;                  /**< The number of rectangles. */
+        const penalties<Real, typename Layout::extent_type>& p; /**< The penalties. */
+        std::vector<coord_type> orig;   /**< The original positions, interleaved. */
+        
+        optimization(const Layout& r, const int n, 
+                     const penalties<Real, typename Layout::extent_type>& p_) 
+            : rects(r), count(n), p(p_), orig(2 * n) {}
+        
+        /** Copy the dense point \c x into the layout's positions. */
+        void store(const Real* x) const {
+            int i;
+            for (i = 0; i < count; ++i) {
+                rects.x(i) = coord_type(x[2*i]);
+                rects.y(i) = coord_type(x[2*i+1]);
+            }
+        }
+        
+        /** Evaluate the gradient at the one-based point \c x for macopt. */
+        static void gradient(Real* x, Real* grad, void* arg) {
+            const optimization* o = static_cast<const optimization*>(arg);
+            o->store(x + 1);        /* Convert one-based array */
+            energy(o->rects, &o->orig[0], o->count, o->p, grad + 1);
+        }
+    };
+    
+    /** Minimize energy() for \c count rectangles from their current 
+        positions, which are also the original positions, with macopt in the 
+        precision of \c Real and the settings in \c args, and leave the 
+        result in \c rects.  Only layouts with float or double coordinates 
+        compile.
+        \return The energy at the result.
+    */
+    template <typename Real, typename Layout>
+    Real optimize(const Layout& rects, const int count,
+                  const penalties<Real, typename Layout::extent_type>& p,
+                  typename macopt_traits<Real>::args_type* args) {
+        optimization<Real, Layout> o(rects, count, p);
+        std::vector<Real> x(2 * count);
+        int i;
+        
+        (void) sizeof(require_floating<typename Layout::coord_type>);
+        if (count == 0)
+            return 0;
+        
+        for (i = 0; i < count; ++i) {
+            o.orig[2*i]   = rects.x(i);
+            o.orig[2*i+1] = rects.y(i);
+            x[2*i]   = Real(rects.x(i));
+            x[2*i+1] = Real(rects.y(i));
+        }
+        macopt_traits<Real>::run(&x[0] - 1, 2 * count,      /* One-based array */
+                                 optimization<Real, Layout>::gradient, &o, args);
+        o.store(&x[0]);
+        return energy(rects, &o.orig[0], count, p, static_cast<Real*>(0));
+    }
+    
+    /** As above, with the optimizer settings of a new lay_statep. */
+    template <typename Real, typename Layout>
+    Real optimize(const Layout& rects, const int count,
+                  const penalties<Real, typename Layout::extent_type>& p) {
+        typename macopt_traits<Real>::args_type args;
+        
+        macopt_traits<Real>::defaults(&args);
+        default_args(&args);
+        return optimize(rects, count, p, &args);
+    }
+    
+    /*@}*/
+    
+    /** Only defined when \c A and \c B are the same type, to reject layouts the
+        C library cannot read. 
+    */
+    template <typename A, typename B> struct require_same_type;
+    template <typename A> struct require_same_type<A, A> { enum { value = 1 }; };
+    
+    /** An owning wrapper around a liblayout state. */
+    class state {
+    public:
+        state() : s_(lay_create_state()) {}
+        ~state() { lay_destroy_state(s_); }
+        
+        /** Register an array of structures with the C library.  Only layouts 
+            that use the library's lay_coord_t and lay_extent_t compile.  There
+            is no overload for lay::soa, since the C library reads the x and y
+            of a rectangle, and its width and height, from adjacent memory.
+        */
+        template <typename Record, typename Coord, typename Extent, 
+                  std::size_t XOffset, std::size_t WOffset>
+        void register_rects(const aos<Record, Coord, Extent, XOffset, WOffset>& rects, 
+                            const int count) {
+            (void) sizeof(require_same_type<Coord, lay_coord_t>);
+            (void) sizeof(require_same_type<Extent, lay_extent_t>);
+            lay_register_rects(s_, &rects.x(0), sizeof(Record), &rects.w(0), sizeof(Record), count);
+        }
+        
+        lay_real_t overlap_weight() const { return lay_get_overlap_weight(s_); }
+        void set_overlap_weight(const lay_real_t w) { lay_set_overlap_weight(s_, w); }
+        lay_real_t edge_weight() const { return lay_get_edge_weight(s_); }
+        void set_edge_weight(const lay_real_t w) { lay_set_edge_weight(s_, w); }
+        lay_real_t center_weight() const { return lay_get_center_weight(s_); }
+        void set_center_weight(const lay_real_t w) { lay_set_center_weight(s_, w); }
+        lay_real_t orig_pos_weight() const { return lay_get_orig_pos_weight(s_); }
+        void set_orig_pos_weight(const lay_real_t w) { lay_set_orig_pos_weight(s_, w); }
+        
+        /** Optimize the registered rectangles with lay_optimize(). */
+        void optimize() { lay_optimize(s_); }
+        
+        /** The underlying C state. */
+        lay_statep get() const { return s_; }
+        
+    private:
+        state(const state&);
+        state& operator=(const state&);
+        
+        lay_statep s_;  /**< The C state. */
+    };
+    
+}
+
+#endif
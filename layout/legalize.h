@@ -0,0 +1,86 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_LEGALIZE_H
+#define LAY_LEGALIZE_H
+
+/** \file layout/legalize.h
+* Removal of residual overlaps after optimization.
+*/
+
+#include <stddef.h>
+#include <layout/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /** Move a set of rectangles so that no two of them overlap, disturbing 
+        their positions as little as practical.
+        
+        This is a fast, deterministic post-pass for lay_optimize(), which 
+        leaves small residual overlaps unless the overlap weight is very large.
+        Each overlapping pair is assigned to the axis along which it penetrates
+        least, and the pairs are resolved by constraint-graph compaction along 
+        x and then along y.  Each compaction splits the required displacement 
+        between the two sides of a constraint, so rectangles move about half 
+        of their penetration depth.  The y pass repeats until no overlaps 
+        remain, which is guaranteed since it only adds constraints between 
+        rectangles whose x-intervals intersect.
+        
+        Overlapping pairs are found with a hierarchical grid that enters each
+        rectangle once, at the level whose cells fit it, so each search costs
+        time linear in the number of rectangles and candidate pairs however 
+        widely their sizes vary.  Each compaction costs a sort and time 
+        linear in its constraints.  The y pass searches again after each of 
+        its compactions, which is usually once or twice for a nearly-legal 
+        layout.
+        
+        The parameters are as for lay_register_rects().  The sizes are not 
+        modified.
+    */
+    void lay_legalize(lay_coord_t* rect_pos, const ptrdiff_t pos_skip,
+                      const lay_extent_t* rect_size, const ptrdiff_t size_skip,
+                      const int count);
+    
+    /** As lay_legalize(), but leave the rectangles flagged in \c fixed where 
+        they are.  Pairs of fixed rectangles may still overlap.  A movable 
+        rectangle that overlaps a fixed one is moved past it along y, towards
+        increasing y, which always succeeds however the fixed rectangles lie;
+        only overlaps between movable rectangles are split between the two 
+        sides and resolved along either axis.
+        \param fixed A pointer to the flag of the first rectangle, non-zero if
+        the rectangle is fixed, or NULL to let every rectangle move.
+        \param fixed_skip The number of bytes to add to \c fixed to get to the
+        flag of the next rectangle.  If zero, then the data is assumed to be 
+        tightly packed.  Can be negative.
+    */
+    void lay_legalize_fixed(lay_coord_t* rect_pos, const ptrdiff_t pos_skip,
+                            const lay_extent_t* rect_size, const ptrdiff_t size_skip,
+                            const int* fixed, const ptrdiff_t fixed_skip,
+                            const int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
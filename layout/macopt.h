@@ -32,6 +32,7 @@ extern "C" {
 #endif
     
 #include "macopt/newansi/macopt_float.h"
+#include "macopt/newansi/macopt_double.h"
 #include "macopt/newansi/nrutil.h"
 
 #ifdef __cplusplus
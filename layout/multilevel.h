@@ -0,0 +1,67 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_MULTILEVEL_H
+#define LAY_MULTILEVEL_H
+
+/** \file layout/multilevel.h
+* Coarse-to-fine (multilevel) optimization for very large rectangle sets.
+*/
+
+#include <stddef.h>
+#include <layout/types.h>
+#include <layout/layout.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /** Optimize the rectangles registered with \c state with a 
+        coarse-to-fine schedule.
+        
+        Nearby rectangles are repeatedly clustered into merged super-rectangles
+        of the same total area until the problem is small.  The coarsest problem 
+        is optimized first, each cluster's displacement is then applied to its 
+        members, and every finer level is polished starting from the prolonged
+        positions.  Overlap forces therefore cross the whole layout in a handful
+        of coarse iterations instead of propagating one neighbor per iteration.
+        
+        Every level is optimized with the settings of \c state (penalty 
+        weights, margin, broad phase, precision, threads and optimizer 
+        settings) and the registered per-rectangle margins, weights and fixed
+        flags: each cluster takes the largest margin and the area-weighted 
+        mean weights of its members, and fixed rectangles are only clustered 
+        with each other, into clusters that stay in place.  The coarse levels run at most 50 iterations each, and 
+        the registered rectangles, which start close to their solution, at 
+        most 20.  If no coarse level is built this is lay_optimize().  The 
+        registration of \c state is unchanged on return.
+        
+        \param max_levels The maximum number of coarse levels to build.  If zero
+        or negative, levels are built until the problem stops shrinking.
+    */
+    void lay_optimize_multilevel(lay_statep state, const int max_levels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
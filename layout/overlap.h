@@ -42,6 +42,17 @@ lay_real_t lay_overlap_area(const lay_coord_t* pos1, const lay_extent_t* size1,
                             const lay_coord_t* pos2, const lay_extent_t* size2,
                             lay_real_t* grad);
 
+/** Compute the overlap area between two rectangles that must be kept at 
+    least \c margin apart.  As lay_overlap_area(), but each extent is taken 
+    to be \c margin larger, centered on the rectangle, so that the area is 
+    positive whenever the gap between the rectangles is smaller than 
+    \c margin along both axes.  With a zero margin the result is identical 
+    to lay_overlap_area() at the same cost.
+*/
+lay_real_t lay_overlap_area_margin(const lay_coord_t* pos1, const lay_extent_t* size1, 
+                                   const lay_coord_t* pos2, const lay_extent_t* size2,
+                                   const lay_extent_t margin, lay_real_t* grad);
+
 #if 0
 /** Compute the total overlap between all rectangles in a list.
     If \c grad is not NULL, then it must have enough space for <tt>2 * num_rects</tt>
@@ -64,6 +75,18 @@ int lay_any_overlap_any(const int num_rects,
 
 #endif
 
+/** Set <tt>overlaps[i]</tt> to non-zero if rectangle \c i overlaps any other
+    rectangle in the list, and to zero otherwise, for every \c i.  Returns
+    the number of rectangles that overlap another.  Up to a few thousand 
+    rectangles, every pair is tested at once into a bit matrix, 64 pairs to
+    a word with no branches, and the set bits are counted per rectangle, 
+    which is several times faster than testing each rectangle against all
+    the others in turn.  Longer lists are tested in turn.
+*/
+int lay_any_overlap_each(const int num_rects, 
+                         const lay_coord_t* pos, const lay_extent_t* size,
+                         int* overlaps);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,68 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_PACK_H
+#define LAY_PACK_H
+
+/** \file layout/pack.h
+* Constructive placement of rectangles, for use as a starting layout.
+*/
+
+#include <stddef.h>
+#include <layout/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /** Move a set of rectangles to an overlap-free layout that stays close to 
+        their current positions, as a warm start for lay_optimize().
+        
+        Rectangles are placed one at a time in order of their current y 
+        coordinate onto a skyline, the upper envelope of the rectangles placed 
+        so far, within a vertical strip.  Each rectangle goes to the candidate 
+        position nearest its current position that rests on or above the 
+        skyline, where candidates are its current x and the ends of the skyline 
+        segments.  Every rectangle lies entirely above the skyline under it 
+        when placed, so the result has no overlaps.
+        
+        Sorting costs O(N log N).  The nearest-candidate search stops once the 
+        horizontal distance alone is worse than the best candidate found, so 
+        placement is close to O(log N) per rectangle unless the skyline is 
+        very ragged.
+        
+        The rectangle parameters are as for lay_register_rects().  The sizes 
+        are not modified.
+        \param strip_width The width of the strip, which starts at the smallest
+        current x coordinate.  If zero or negative, the width of the bounding 
+        box of the current layout is used.  The strip is widened to fit the 
+        widest rectangle if needed.
+    */
+    void lay_initial_pack(lay_coord_t* rect_pos, const ptrdiff_t pos_skip,
+                          const lay_extent_t* rect_size, const ptrdiff_t size_skip,
+                          const int count, const lay_coord_t strip_width);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,111 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_SNAPSHOT_H
+#define LAY_SNAPSHOT_H
+
+/** \file layout/snapshot.h
+* Saving and memory-mapped loading of layout problems.
+*
+* A snapshot file is little-endian and starts with a 128-byte header:
+* <table>
+* <tr><th>Offset</th><th>Type</th><th>Contents</th></tr>
+* <tr><td>0</td><td>char[8]</td><td>The magic string <tt>"LAYSNAP"</tt>, zero-terminated.</td></tr>
+* <tr><td>8</td><td>uint32</td><td>The format version, currently 3.</td></tr>
+* <tr><td>12</td><td>uint8[4]</td><td>The size of lay_coord_t, whether it is an integer, 
+*     the size of lay_extent_t and whether it is an integer.</td></tr>
+* <tr><td>16</td><td>uint64</td><td>The number of rectangles.</td></tr>
+* <tr><td>24</td><td>uint64</td><td>The offset of the positions.</td></tr>
+* <tr><td>32</td><td>uint64</td><td>The offset of the sizes.</td></tr>
+* <tr><td>40</td><td>float64[4]</td><td>The overlap, edge, center and original position weights.</td></tr>
+* <tr><td>72</td><td>float64</td><td>The margin.</td></tr>
+* <tr><td>80</td><td>uint64[3]</td><td>The offsets of the per-rectangle margins, overlap 
+*     weights and original position weights, or zero if they were not registered.</td></tr>
+* <tr><td>104</td><td>int32[3]</td><td>The broad phase, internal order and precision.</td></tr>
+* <tr><td>116</td><td>uint8</td><td>The size of lay_real_t.</td></tr>
+* <tr><td>120</td><td>uint64</td><td>The offset of the optimizer settings.</td></tr>
+* </table>
+* The optimizer settings take 128 bytes: the nine floating point settings of 
+* macopt_args as float64, in declaration order, then the seven integer 
+* settings as uint64.  They are followed by a uint64 with the offset of the 
+* per-rectangle fixed flags, as int32, or zero if they were not registered.  
+* The positions and sizes follow as tightly-packed pairs and the per-rectangle
+* arrays as tightly-packed values, each array starting at a multiple of 64 
+* bytes, so they can be mapped and registered directly.  Version 2 files have
+* no fixed flags, and version 1 files hold only the rectangles and the 
+* penalty weights; both can still be loaded.
+*/
+
+#include <stddef.h>
+#include <layout/types.h>
+#include <layout/layout.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /** Pointer to a snapshot loaded by lay_load_state(). */
+    typedef struct lay_snapshot* lay_snapshotp;
+    
+    /** Save the problem registered with a state to a snapshot file: the 
+        rectangles, the per-rectangle margins, weights and fixed flags, the 
+        penalty weights, the margin, the broad phase, the internal order, the 
+        precision and the optimizer settings.
+        \param state The state to save.
+        \param filename The file to write.
+        \return Zero on success, or non-zero if the file could not be written.
+    */
+    int lay_save_state(const lay_statep state, const char* filename);
+    
+    /** Load a snapshot file by mapping it into memory, set the settings of 
+        \c state from it, and register its rectangles, margins, weights and 
+        fixed flags with \c state.
+        
+        No data is parsed or copied: the rectangles and per-rectangle arrays 
+        are used in place from a private mapping of the file, so loading 
+        costs only the pages that are later touched.  Optimizing the state modifies the mapped 
+        positions but never the file.
+        
+        \return The snapshot, which must stay loaded while \c state uses its 
+        rectangles and be released with lay_unload_state(), or NULL if the 
+        file could not be mapped, was not written by a compatible build or 
+        holds settings out of range.  \c state is then left unchanged.
+    */
+    lay_snapshotp lay_load_state(lay_statep state, const char* filename);
+    
+    /** Unmap a snapshot loaded by lay_load_state(). */
+    void lay_unload_state(lay_snapshotp snapshot);
+    
+    /** The number of rectangles in a snapshot. */
+    int lay_snapshot_count(const lay_snapshotp snapshot);
+    
+    /** The tightly-packed positions of the rectangles in a snapshot. */
+    lay_coord_t* lay_snapshot_positions(const lay_snapshotp snapshot);
+    
+    /** The tightly-packed sizes of the rectangles in a snapshot. */
+    lay_extent_t* lay_snapshot_sizes(const lay_snapshotp snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
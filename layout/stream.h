@@ -0,0 +1,115 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_STREAM_H
+#define LAY_STREAM_H
+
+/** \file layout/stream.h
+* Streaming, tile-partitioned layout of unbounded rectangle sets.
+*/
+
+#include <stddef.h>
+#include <layout/types.h>
+#include <layout/layout.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /** A rectangle passed through a layout stream.  Arrays of these can be 
+        registered directly with lay_register_rects() using a skip of 
+        <tt>sizeof(lay_stream_rect)</tt>. 
+    */
+    typedef struct {
+        lay_coord_t pos[2];     /**< The position of the rectangle. */
+        lay_extent_t size[2];   /**< The size of the rectangle. */
+        long id;                /**< An identifier for the caller, passed through unchanged. */
+    } lay_stream_rect;
+    
+    /** A function that receives the finished rectangles of one tile.  The 
+        array is only valid for the duration of the call.  The \c context 
+        parameter allows the user to store arbitrary information.
+    */
+    typedef void (*lay_stream_emit_func)(void* context, const lay_stream_rect* rects, 
+                                         const int count);
+    
+    /** Pointer to the internal state of a layout stream. */
+    typedef struct lay_stream* lay_streamp;
+    
+    /** Create a layout stream.
+        
+        The plane is divided into tiles.  Rectangles are pushed in order of 
+        tile row, by the y coordinate of their position, and a row is laid out 
+        as soon as a rectangle from a later row arrives.  The tiles of a row 
+        are optimized in two passes, first the even columns and then the odd 
+        ones, with the tiles of each pass optimized in parallel by a 
+        lay_batch that the stream keeps for its lifetime.  Each tile is 
+        optimized together with a halo of the finished rectangles around it: 
+        those of the previous row, and in the second pass those of the 
+        neighboring tiles in the same row.  The halo is fixed (see 
+        lay_register_fixed()), so the tile's rectangles move out of its way 
+        and finished rectangles never move again.  Each tile is then 
+        legalized with lay_legalize_fixed(), with its halo still fixed, so no 
+        overlap remains within the tile or between it and its halo.  The halo
+        should reach as far as rectangles are expected to move.
+        
+        Every tile is optimized with the settings of \c settings, copied when
+        the stream is created: the penalty weights, the margin, the broad 
+        phase, the internal order, the precision, the number of threads 
+        within each tile and the optimizer settings.
+        
+        Finished tiles are passed to \c emit in row-major order.  A row can 
+        only be laid out once it is complete, so the stream holds every 
+        rectangle of the current row and of the previous one, which is its 
+        halo, and memory grows with the width of the rows rather than being
+        bounded by a number of tiles.  While a row is laid out, each tile of 
+        one pass is also copied, with its halo, for its optimization.
+        
+        \param settings A state whose settings are used for every tile.
+        \param tile_width The width of a tile.
+        \param tile_height The height of a tile.
+        \param halo How far beyond a tile to look for halo rectangles.
+        \param num_threads As for lay_create_batch().
+        \param emit The function receiving finished tiles.
+        \param context Passed to \c emit.
+    */
+    lay_streamp lay_stream_create(const lay_statep settings, 
+                                  const lay_coord_t tile_width, const lay_coord_t tile_height,
+                                  const lay_coord_t halo, const int num_threads,
+                                  lay_stream_emit_func emit, void* context);
+    
+    /** Add rectangles to a stream.  Rectangles whose row is before the 
+        current row are laid out with the current row.
+    */
+    void lay_stream_push(lay_streamp stream, const lay_stream_rect* rects, const int count);
+    
+    /** Lay out and emit the rectangles still held by a stream. */
+    void lay_stream_finish(lay_streamp stream);
+    
+    /** Destroy a stream.  Rectangles that have not been finished are dropped. */
+    void lay_stream_destroy(lay_streamp stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -34,17 +34,26 @@ extern "C" {
     /** \name Basic data types */
     /*@{*/
     
-    /** Define to use floats as the floating-point type. */
+    /** Define to use floats as the floating-point type.  This is the default 
+        unless LAY_REAL_IS_DOUBLE is defined on the command line. */
+#if !defined(LAY_REAL_IS_DOUBLE)
     #define LAY_REAL_IS_FLOAT
+#endif
     
-    /** Define to use doubles as the floating-point type. */
+    /** Define to use doubles as the floating-point type.  The optimizer then
+        runs the double precision build of macopt on the positions directly. */
     /* #define LAY_REAL_IS_DOUBLE */
     
-    /** Define to generate integer coordinates. */
+    /** Define to generate integer coordinates.  Pass -DLAY_USE_INTEGER_COORDS 
+        on the command line for pixel-snapped layouts; lay_optimize() then uses
+        an exact integer legalization instead of the floating-point optimizer. */
     /*#define LAY_USE_INTEGER_COORDS*/ 
     
-    /** Define to generate floating-point coordinates. */
+    /** Define to generate floating-point coordinates.  This is the default 
+        unless LAY_USE_INTEGER_COORDS is defined. */
+#if !defined(LAY_USE_INTEGER_COORDS)
     #define LAY_USE_REAL_COORDS 
+#endif
     
     
 #if defined(LAY_REAL_IS_FLOAT)
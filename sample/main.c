@@ -13,6 +13,7 @@
 #include <string.h>
 
 #include <layout/layout.h>
+#include <layout/pack.h>
 
 #include "random/random.h"
 
@@ -452,6 +453,13 @@ static void menu(int value) {
             glutPostRedisplay();
             break;
             
+        case 'p':
+            lay_initial_pack(&(rects->items[0].x),     sizeof(rect), 
+                             &(rects->items[0].width), sizeof(rect),
+                             rects->size, screen_width);
+            glutPostRedisplay();
+            break;
+            
         case ' ':
             animate(!animating);
         break;
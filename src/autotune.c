@@ -0,0 +1,222 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+
+#include <layout/layout.h>
+#include "broadphase.h"
+#include "bitset.h"
+
+/** The number of evaluations between reconsidering the choice. */
+#define AUTOTUNE_PERIOD 16
+
+/** The most boxes sampled for the size distribution. */
+#define AUTOTUNE_SAMPLES 256
+
+/** Evaluations of fewer boxes are too short to time reliably. */
+#define AUTOTUNE_MIN_TIMED 64
+
+/** A new choice must be predicted to be this much faster than the current one. */
+#define AUTOTUNE_HYSTERESIS 0.8
+
+/** Broad phases predicted to be within this factor of the best are tried for
+    a period before the choice relies on their predictions. */
+#define AUTOTUNE_EXPLORE 2.0
+
+/** \name Default costs in nanoseconds, measured on an -O2 build 
+    (2.x GHz x86-64).  The calibration corrects them for the machine and the 
+    problem at hand. */
+/*@{*/
+#define COST_TILED_TEST     2.0     /**< Testing one pair of rectangles in the tiled kernel. */
+#define COST_HGRID_LEVEL    100.0   /**< Entering and probing one grid level for a box. */
+#define COST_BVH_LEVEL      25.0    /**< Maintaining and traversing one tree level for a box. */
+#define COST_SAP_BOX        40.0    /**< Sorting and gathering one box for sweep and prune. */
+#define COST_SAP_SWEEP      1.0     /**< Testing one box that overlaps another along the sweep axis. */
+#define COST_BITSET_TEST    0.8     /**< Testing one pair of boxes into the bit matrix. */
+#define COST_CANDIDATE      140.0   /**< Reporting and evaluating one candidate pair. */
+/*@}*/
+
+/** The predicted cost in nanoseconds of an evaluation with broad phase 
+    \c choice, before calibration. */
+static double predict(const lay_autotune* tune, const int choice, const int count) {
+    const double n = count;
+    const double pairs = tune->pairs_per_box * n;
+
+    switch (choice) {
+        case LAY_BROAD_PHASE_TILED:
+            return COST_TILED_TEST * n * (n - 1) / 2;
+        case LAY_BROAD_PHASE_HGRID:
+            /* Each box probes its own level and every coarser one. */
+            return COST_HGRID_LEVEL * n * (tune->levels + 1) + COST_CANDIDATE * pairs;
+        case LAY_BROAD_PHASE_BVH:
+            return COST_BVH_LEVEL * n * log2(n + 2) + COST_CANDIDATE * pairs;
+        case LAY_BROAD_PHASE_SAP:
+            return COST_SAP_BOX * n + COST_SAP_SWEEP * tune->sweep_per_box * n 
+                 + COST_CANDIDATE * pairs;
+        case LAY_BROAD_PHASE_BITSET:
+            if (count > LAY_BITSET_MAX_BOXES)
+                return HUGE_VAL;
+            return COST_BITSET_TEST * n * (n - 1) / 2 + COST_CANDIDATE * pairs;
+        default:
+            assert(0);
+            return 0;
+    }
+}
+
+/** Sample the sizes and density of the boxes. */
+static void sample(lay_autotune* tune, const lay_coord_t* boxes, const int count) {
+    const int stride = (count > AUTOTUNE_SAMPLES ? count / AUTOTUNE_SAMPLES : 1);
+    double w, h, ext, min_ext = 0, max_ext = 0, area = 0, lo[2], hi[2], sum[2] = {0, 0};
+    int i, axis, samples = 0;
+
+    for (i = 0; i < count; i += stride) {
+        const lay_coord_t* box = boxes + 4 * i;
+        w = (double) (box[2] - box[0]);
+        h = (double) (box[3] - box[1]);
+        ext = (w > h ? w : h);
+        if (ext > 0 && (min_ext == 0 || ext < min_ext))
+            min_ext = ext;
+        if (ext > max_ext)
+            max_ext = ext;
+        area += w * h;
+        sum[0] += w;
+        sum[1] += h;
+
+        if (samples == 0 || box[0] < lo[0]) lo[0] = box[0];
+        if (samples == 0 || box[1] < lo[1]) lo[1] = box[1];
+        if (samples == 0 || box[2] > hi[0]) hi[0] = box[2];
+        if (samples == 0 || box[3] > hi[1]) hi[1] = box[3];
+        ++samples;
+    }
+
+    /* The grid has a level per doubling of size. */
+    tune->levels = (min_ext > 0 ? ceil(log2(max_ext / min_ext)) + 1 : 1);
+    if (tune->levels > LAY_HGRID_MAX_LEVELS)
+        tune->levels = LAY_HGRID_MAX_LEVELS;
+
+    /* Sweep and prune tests each box against the boxes that overlap it along
+       the sweep axis and start after it.  Uniformly scattered intervals of 
+       mean length w over a span s overlap about 2 w / s of the others, half 
+       of them starting after. */
+    tune->sweep_per_box = 0;
+    if (samples > 0) {
+        for (axis = 0; axis < 2; ++axis) {
+            w = (hi[axis] > lo[axis] ? (sum[axis] / samples) * count / (hi[axis] - lo[axis]) : count);
+            if (axis == 0 || w < tune->sweep_per_box)
+                tune->sweep_per_box = w;
+        }
+    }
+
+    /* Before any pairs have been counted, guess from how much of their bounds
+       the boxes cover: uniformly scattered boxes covering a fraction c of the
+       bounds overlap about 2c others each. */
+    if (tune->pairs_per_box < 0) {
+        tune->pairs_per_box = 0;
+        if (samples > 0 && hi[0] > lo[0] && hi[1] > lo[1])
+            tune->pairs_per_box = 2 * (area / samples) * count 
+                                / ((hi[0] - lo[0]) * (hi[1] - lo[1]));
+    }
+}
+
+void lay_autotune_init(lay_autotune* tune) {
+    int k;
+
+    assert(tune);
+    for (k = 0; k < LAY_NUM_BROAD_PHASES; ++k) {
+        tune->scale[k] = 1;
+        tune->measured[k] = 0;
+    }
+    tune->pairs_per_box = -1;
+    tune->levels = 1;
+    tune->choice = LAY_BROAD_PHASE_TILED;
+    tune->evals_left = 0;
+}
+
+void lay_autotune_reset(lay_autotune* tune) {
+    assert(tune);
+    tune->evals_left = 0;
+}
+
+int lay_autotune_choose(lay_autotune* tune, const lay_coord_t* boxes, const int count) {
+    double cost[LAY_NUM_BROAD_PHASES], best_cost, current_cost;
+    int k, best;
+
+    assert(tune && (boxes || count == 0) && count >= 0);
+    if (tune->evals_left-- > 0)
+        return tune->choice;
+    tune->evals_left = AUTOTUNE_PERIOD - 1;
+
+    sample(tune, boxes, count);
+
+    /* The plain loop over every pair does the tiled kernel's work more slowly,
+       so it is never a candidate. */
+    for (k = LAY_BROAD_PHASE_NONE + 1; k < LAY_NUM_BROAD_PHASES; ++k)
+        cost[k] = tune->scale[k] * predict(tune, k, count);
+    best = tune->choice;
+    for (k = LAY_BROAD_PHASE_NONE + 1; k < LAY_NUM_BROAD_PHASES; ++k)
+        if (cost[k] < cost[best])
+            best = k;
+    best_cost = cost[best];
+    current_cost = cost[tune->choice];
+
+    /* The defaults can be far off for a given machine and problem, so close 
+       contenders are measured before they are ruled out. */
+    if (count >= AUTOTUNE_MIN_TIMED) {
+        for (k = LAY_BROAD_PHASE_NONE + 1; k < LAY_NUM_BROAD_PHASES; ++k) {
+            if (!tune->measured[k] && cost[k] < AUTOTUNE_EXPLORE * best_cost) {
+                tune->choice = k;
+                return k;
+            }
+        }
+    }
+
+    if (best_cost < AUTOTUNE_HYSTERESIS * current_cost)
+        tune->choice = best;
+    return tune->choice;
+}
+
+void lay_autotune_record(lay_autotune* tune, const int choice, const int count,
+                         const long pairs, const long long ns) {
+    double predicted, ratio;
+
+    assert(tune && choice >= 0 && choice < LAY_NUM_BROAD_PHASES && count >= 0);
+    if (count > 0)
+        tune->pairs_per_box = (double) pairs / count;
+    if (count < AUTOTUNE_MIN_TIMED)
+        return;
+
+    /* Move the calibration a quarter of the way to the measurement, within
+       limits that keep one preempted evaluation from deciding the choice. */
+    predicted = predict(tune, choice, count);
+    if (predicted <= 0)
+        return;
+    ratio = ns / predicted;
+    if (ratio < 1.0 / 16)
+        ratio = 1.0 / 16;
+    if (ratio > 16)
+        ratio = 16;
+    tune->scale[choice] = 0.75 * tune->scale[choice] + 0.25 * ratio;
+    ++tune->measured[choice];
+}
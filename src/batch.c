@@ -0,0 +1,240 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+/** \file src/batch.c
+* Work-stealing optimization of many independent layouts.
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <layout/layout.h>
+#include <layout/batch.h>
+#include "pool.h"
+#include "state.h"
+
+/** The problems waiting for one worker, largest first.  Workers take from the
+    front of their own queue and steal from the front of others, so the 
+    largest remaining problem is always the next one started.
+*/
+typedef struct {
+    pthread_mutex_t lock;   /**< Protects \c head. */
+    int* tasks;             /**< Problem indices, largest problem first. */
+    int head;               /**< The next task to run. */
+    int tail;               /**< One past the last task. */
+} task_queue;
+
+/** A problem waiting to be sorted by size. */
+typedef struct {
+    int count;              /**< The number of rectangles. */
+    int index;              /**< The index of the problem. */
+} size_entry;
+
+/** Worker threads, each with its own state, kept between batches. */
+struct lay_batch {
+    lay_pool* pool;                 /**< The worker threads, or NULL for the calling thread alone. */
+    int num_workers;                /**< The number of workers, counting the calling thread. */
+    lay_statep* states;             /**< One state per worker, reused for every problem it runs. */
+    task_queue* queues;             /**< One queue per worker. */
+    int queue_capacity;             /**< The number of tasks allocated in each queue. */
+    size_entry* sizes;              /**< Scratch space for sorting the problems. */
+    int sizes_capacity;             /**< The number of entries allocated in \c sizes. */
+    const lay_problem* problems;    /**< The problems of the batch being run. */
+    lay_statep defaults;            /**< A state with the default settings, for problems without settings. */
+};
+
+static int compare_size_entries(const void* a, const void* b) {
+    const size_entry* e1 = (const size_entry*) a;
+    const size_entry* e2 = (const size_entry*) b;
+    
+    if (e1->count != e2->count)
+        return e2->count - e1->count;
+    return e1->index - e2->index;
+}
+
+static int pop_task(task_queue* q) {
+    int result = -1;
+    
+    pthread_mutex_lock(&q->lock);
+    if (q->head < q->tail)
+        result = q->tasks[q->head++];
+    pthread_mutex_unlock(&q->lock);
+    
+    return result;
+}
+
+/** The next problem for worker \c id, from its own queue if possible and 
+    otherwise stolen from another.  Returns -1 when every queue is empty. 
+*/
+static int next_task(lay_batchp b, const int id) {
+    int k, task;
+    
+    for (k = 0; k < b->num_workers; ++k) {
+        task = pop_task(b->queues + (id + k) % b->num_workers);
+        if (task >= 0)
+            return task;
+    }
+    return -1;
+}
+
+static void run_problem(const lay_batchp b, lay_statep state, const lay_problem* p) {
+    assert(b && state && p);
+    
+    /* The worker state keeps the settings of its previous problem otherwise. */
+    lay_copy_settings(state, p->settings ? p->settings : b->defaults);
+    lay_set_overlap_weight(state, p->overlap_weight);
+    lay_set_edge_weight(state, p->edge_weight);
+    lay_set_center_weight(state, p->center_weight);
+    lay_set_orig_pos_weight(state, p->orig_pos_weight);
+    
+    /* The state keeps its buffers when they are large enough for the problem. */
+    lay_register_rects(state, p->rect_pos, p->pos_skip, p->rect_size, p->size_skip, p->count);
+    lay_register_margins(state, p->margins, p->margins_skip);
+    lay_register_weights(state, p->overlap_weights, p->overlap_weights_skip, 
+                         p->orig_pos_weights, p->orig_pos_weights_skip);
+    lay_register_fixed(state, p->fixed, p->fixed_skip);
+    lay_optimize(state);
+}
+
+/** Run problems on one worker of the pool until every queue is empty. */
+static void worker(void* arg, const int id, const int num_workers) {
+    lay_batchp b = (lay_batchp) arg;
+    int task;
+    
+    assert(id < b->num_workers);
+    (void) num_workers;
+    while ((task = next_task(b, id)) >= 0)
+        run_problem(b, b->states[id], b->problems + task);
+}
+
+lay_batchp lay_create_batch(const int num_threads) {
+    lay_batchp b = malloc(sizeof(struct lay_batch));
+    int i;
+    
+    assert(b);
+    b->pool = lay_pool_create(num_threads);
+    b->num_workers = lay_pool_size(b->pool);
+    b->states = malloc(sizeof(lay_statep) * b->num_workers);
+    b->queues = malloc(sizeof(task_queue) * b->num_workers);
+    assert(b->states && b->queues);
+    for (i = 0; i < b->num_workers; ++i) {
+        b->states[i] = lay_create_state();
+        pthread_mutex_init(&b->queues[i].lock, NULL);
+        b->queues[i].tasks = NULL;
+        b->queues[i].head = b->queues[i].tail = 0;
+    }
+    b->queue_capacity = 0;
+    b->sizes = NULL;
+    b->sizes_capacity = 0;
+    b->problems = NULL;
+    b->defaults = lay_create_state();
+    
+    return b;
+}
+
+void lay_destroy_batch(lay_batchp b) {
+    int i;
+    
+    assert(b);
+    lay_pool_destroy(b->pool);
+    for (i = 0; i < b->num_workers; ++i) {
+        lay_destroy_state(b->states[i]);
+        pthread_mutex_destroy(&b->queues[i].lock);
+        free(b->queues[i].tasks);
+    }
+    free(b->states);
+    free(b->queues);
+    free(b->sizes);
+    lay_destroy_state(b->defaults);
+    free(b);
+}
+
+int lay_get_batch_threads(const lay_batchp b) {
+    assert(b);
+    return b->num_workers;
+}
+
+void lay_run_batch(lay_batchp b, const lay_problem* problems, const int num_problems) {
+    int i;
+    
+    assert(b && num_problems >= 0);
+    if (num_problems == 0)
+        return;
+    assert(problems);
+    
+    if (num_problems > b->sizes_capacity) {
+        b->sizes_capacity = num_problems;
+        free(b->sizes);
+        b->sizes = malloc(sizeof(size_entry) * num_problems);
+        assert(b->sizes);
+    }
+    for (i = 0; i < num_problems; ++i) {
+        b->sizes[i].count = problems[i].count;
+        b->sizes[i].index = i;
+    }
+    qsort(b->sizes, num_problems, sizeof(size_entry), compare_size_entries);
+    
+    /* Deal the sorted problems round-robin so every queue starts with a 
+       similar share of the work. */
+    if (num_problems / b->num_workers + 1 > b->queue_capacity) {
+        b->queue_capacity = num_problems / b->num_workers + 1;
+        for (i = 0; i < b->num_workers; ++i) {
+            free(b->queues[i].tasks);
+            b->queues[i].tasks = malloc(sizeof(int) * b->queue_capacity);
+            assert(b->queues[i].tasks);
+        }
+    }
+    for (i = 0; i < b->num_workers; ++i)
+        b->queues[i].head = b->queues[i].tail = 0;
+    for (i = 0; i < num_problems; ++i) {
+        task_queue* q = b->queues + i % b->num_workers;
+        q->tasks[q->tail++] = b->sizes[i].index;
+    }
+    
+    b->problems = problems;
+    lay_pool_run(b->pool, worker, b);
+    b->problems = NULL;
+}
+
+void lay_optimize_batch(const lay_problem* problems, const int num_problems, 
+                        const int num_threads) {
+    lay_batchp b;
+    int num_workers = num_threads;
+    
+    assert(num_problems >= 0);
+    if (num_problems == 0)
+        return;
+    
+    /* No more threads are started than there are problems. */
+    if (num_workers <= 0)
+        num_workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_workers <= 0)
+        num_workers = 1;
+    if (num_workers > num_problems)
+        num_workers = num_problems;
+    
+    b = lay_create_batch(num_workers);
+    lay_run_batch(b, problems, num_problems);
+    lay_destroy_batch(b);
+}
@@ -0,0 +1,157 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bitset.h"
+
+/** The number of bits in a word of the matrix. */
+#define WORD_BITS 64
+
+/** Make room for \c count boxes.  The rows grow with the count, so the 
+    matrix is reallocated whenever the count grows. */
+static void reserve(lay_bitset* bits, const int count) {
+    const int padded = bits->row_words * WORD_BITS;
+    int k;
+
+    if (count > bits->capacity) {
+        free(bits->words);
+        bits->words = malloc(sizeof(uint64_t) * count * (size_t) bits->row_words);
+        bits->degree = realloc(bits->degree, sizeof(int) * count);
+        for (k = 0; k < 4; ++k) {
+            bits->edges[k] = realloc(bits->edges[k], sizeof(lay_coord_t) * padded);
+            assert(bits->edges[k]);
+        }
+        assert(bits->words && bits->degree);
+        bits->capacity = count;
+    }
+}
+
+/** The bit of each box of a word within its byte. */
+static const unsigned char byte_bit[WORD_BITS] = {
+    1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128,
+    1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128,
+    1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128,
+    1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+};
+
+/** The bits of row \c i for the boxes of word \c w. */
+static uint64_t test_word(const lay_bitset* bits, const int i, const int w) {
+    const lay_coord_t *x0 = bits->edges[0] + w * WORD_BITS, *y0 = bits->edges[1] + w * WORD_BITS;
+    const lay_coord_t *x1 = bits->edges[2] + w * WORD_BITS, *y1 = bits->edges[3] + w * WORD_BITS;
+    const lay_coord_t bx0 = bits->edges[0][i], by0 = bits->edges[1][i];
+    const lay_coord_t bx1 = bits->edges[2][i], by1 = bits->edges[3][i];
+    unsigned char hit[WORD_BITS];
+    uint64_t word = 0, bytes;
+    int l;
+
+    /* Test the whole word without branches, so that it vectorizes.  Each 
+       hit is stored as its bit within its byte of the word, so the eight 
+       hits of a byte sum to that byte without carries, and multiplying 
+       eight such bytes by the constant sums them into the top byte in any
+       byte order. */
+    for (l = 0; l < WORD_BITS; ++l)
+        hit[l] = -((x0[l] < bx1) & (bx0 < x1[l]) & (y0[l] < by1) & (by0 < y1[l])) & byte_bit[l];
+    for (l = 0; l < WORD_BITS; l += 8) {
+        memcpy(&bytes, hit + l, sizeof(bytes));
+        word |= ((bytes * 0x0101010101010101ull) >> 56) << l;
+    }
+    return word;
+}
+
+void lay_bitset_build(lay_bitset* bits, const lay_coord_t* boxes, const int count) {
+    uint64_t *row, word;
+    int i, j, k, w;
+
+    assert(bits && (boxes || count == 0) && count >= 0);
+    bits->count = count;
+    bits->row_words = (count + WORD_BITS - 1) / WORD_BITS;
+    reserve(bits, count);
+    if (count == 0)
+        return;
+
+    for (k = 0; k < 4; ++k) {
+        for (i = 0; i < count; ++i)
+            bits->edges[k][i] = boxes[4*i + k];
+        for (i = count; i < bits->row_words * WORD_BITS; ++i)
+            bits->edges[k][i] = 0;
+    }
+    memset(bits->degree, 0, sizeof(int) * count);
+
+    /* Only the pairs above the diagonal are tested.  Each hit also counts 
+       towards the degree of the box below it, which keeps the matrix from 
+       being written out of order. */
+    for (i = 0; i < count; ++i) {
+        row = LAY_BITSET_ROW(bits, i);
+        for (w = LAY_BITSET_FIRST_WORD(i); w < bits->row_words; ++w) {
+            word = test_word(bits, i, w);
+            if (w == i / WORD_BITS)
+                word &= ~(uint64_t) 0 << (i % WORD_BITS) << 1;
+            if (w == bits->row_words - 1 && count % WORD_BITS)
+                word &= ((uint64_t) 1 << (count % WORD_BITS)) - 1;    /* Padding */
+            row[w] = word;
+            
+            if (word) {
+                bits->degree[i] += lay_bitset_popcount(word);
+                do {
+                    j = w * WORD_BITS + lay_bitset_lowest(word);
+                    ++bits->degree[j];
+                    word &= word - 1;
+                } while (word);
+            }
+        }
+    }
+}
+
+long lay_bitset_count(const lay_bitset* bits) {
+    long sum = 0;
+    int i;
+    
+    assert(bits);
+    
+    /* Every pair counts towards two degrees. */
+    for (i = 0; i < bits->count; ++i)
+        sum += bits->degree[i];
+    return sum / 2;
+}
+
+int lay_bitset_any(const lay_bitset* bits, const int index) {
+    assert(bits && index >= 0 && index < bits->count);
+    return bits->degree[index] > 0;
+}
+
+void lay_bitset_destroy(lay_bitset* bits) {
+    int k;
+    
+    assert(bits);
+    free(bits->words);
+    free(bits->degree);
+    bits->words = NULL;
+    bits->degree = NULL;
+    for (k = 0; k < 4; ++k) {
+        free(bits->edges[k]);
+        bits->edges[k] = NULL;
+    }
+    bits->capacity = 0;
+}
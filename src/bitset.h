@@ -0,0 +1,100 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_BITSET_H
+#define LAY_BITSET_H
+
+/** \file src/bitset.h
+* Private bit matrix of the pairs of boxes that intersect.
+*/
+
+#include <stdint.h>
+#include <layout/types.h>
+
+/** The most boxes for which a bit matrix is worth building.  The matrix 
+    takes <tt>N^2 / 8</tt> bytes, 8 MiB at this size, and beyond it the 
+    quadratic build costs more than any broad phase. */
+#define LAY_BITSET_MAX_BOXES 8192
+
+/** A matrix with a bit for every pair of boxes, set where the boxes 
+    intersect.  Only the bits above the diagonal are kept, each pair once:
+    bit \c j of row \c i for every <tt>j > i</tt>, in the words of the row
+    from LAY_BITSET_FIRST_WORD(i) on.  The bits of <tt>j <= i</tt> in the 
+    first word are clear, and the words before it are not set at all.  The
+    boxes are as for the broad phases, four coordinates per box.  The 
+    storage is kept between builds.
+*/
+typedef struct {
+    int count;              /**< The number of boxes. */
+    int row_words;          /**< The number of words in a row. */
+    uint64_t* words;        /**< The rows, <tt>count * row_words</tt> words. */
+    int* degree;            /**< The number of other boxes each box intersects. */
+    lay_coord_t* edges[4];  /**< The box coordinates as an array per coordinate, padded to whole words. */
+    int capacity;           /**< The number of boxes allocated. */
+} lay_bitset;
+
+/** The number of bits set in \c word. */
+static int lay_bitset_popcount(uint64_t word) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(word);
+#else
+    word = word - ((word >> 1) & 0x5555555555555555ull);
+    word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+    word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (int) ((word * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+/** The position of the lowest bit set in \c word, which must not be zero. */
+static int lay_bitset_lowest(uint64_t word) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(word);
+#else
+    int bit = 0;
+    while (!(word & 1)) {
+        word >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+/** Build the matrix of \c count boxes. */
+void lay_bitset_build(lay_bitset* bits, const lay_coord_t* boxes, const int count);
+
+/** The words of row \c i of a built matrix. */
+#define LAY_BITSET_ROW(bits, i) ((bits)->words + (long) (i) * (bits)->row_words)
+
+/** The first word of row \c i that is set, the one holding bit <tt>i + 1</tt>. */
+#define LAY_BITSET_FIRST_WORD(i) (((i) + 1) / 64)
+
+/** The number of intersecting pairs in a built matrix. */
+long lay_bitset_count(const lay_bitset* bits);
+
+/** Whether box \c index of a built matrix intersects any other, from the 
+    degrees counted while building. */
+int lay_bitset_any(const lay_bitset* bits, const int index);
+
+/** Free the storage of a matrix. */
+void lay_bitset_destroy(lay_bitset* bits);
+
+#endif
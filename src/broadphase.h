@@ -0,0 +1,326 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_BROADPHASE_H
+#define LAY_BROADPHASE_H
+
+/** \file src/broadphase.h
+* Private broad phase structures that find candidate overlapping pairs for eval().
+
+  Every broad phase works on axis-aligned boxes stored densely as four
+  coordinates per rectangle, <tt>x0, y0, x1, y1</tt>, already grown by any
+  margins.  It reports each pair of boxes that intersect exactly once, and 
+  may report some pairs that do not intersect.
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <layout/types.h>
+#include "pool.h"
+
+/** A growable list of candidate pairs, stored as consecutive index pairs. */
+typedef struct {
+    long count;         /**< The number of pairs in the list. */
+    long capacity;      /**< The number of pairs allocated. */
+    int* items;         /**< The pairs, <tt>2 * count</tt> indices. */
+} lay_pair_list;
+
+/** Add a pair to a list, growing it if needed.  The list keeps its storage
+    when cleared, so it stops allocating once it has grown to size. */
+static void lay_pair_list_add(lay_pair_list* l, const int first, const int second) {
+    if (l->count == l->capacity) {
+        l->capacity = (l->capacity > 0 ? 2 * l->capacity : 1024);
+        l->items = realloc(l->items, sizeof(int) * 2 * l->capacity);
+        assert(l->items);
+    }
+    l->items[2*l->count]   = first;
+    l->items[2*l->count+1] = second;
+    ++l->count;
+}
+
+/** Candidate pairs stored compactly, for the broad phases that find the 
+    partners of one box at a time.  Each box with partners gets a row with
+    its partners sorted, encoded as LEB128 varints: the change in box from 
+    the previous row, the number of partners, the signed distance from the
+    box to its first partner and the gaps between the following partners.
+    Signed values are zigzag encoded.  Nearby boxes usually have nearby 
+    indices, so most values take a byte or two, where a lay_pair_list 
+    takes eight bytes per pair.  The storage is kept when cleared.
+*/
+typedef struct {
+    long count;             /**< The number of pairs. */
+    long size;              /**< The number of bytes of rows. */
+    long capacity;          /**< The number of bytes allocated. */
+    unsigned char* data;    /**< The encoded rows. */
+    const int* ids;         /**< The box of each encoded index, or NULL if they are the same. */
+    int last_index;         /**< The index of the last row, or zero. */
+    int* row;               /**< The partners of the row being added. */
+    int row_count;          /**< The number of partners of the row being added. */
+    int row_capacity;       /**< The number of partners allocated. */
+} lay_packed_pairs;
+
+/** Remove every pair, and set the map from encoded indices to boxes, which 
+    must stay valid while the pairs are read. */
+void lay_packed_pairs_clear(lay_packed_pairs* pairs, const int* ids);
+
+/** Add a partner to the row being added. */
+static void lay_packed_pairs_push(lay_packed_pairs* pairs, const int partner) {
+    if (pairs->row_count == pairs->row_capacity) {
+        pairs->row_capacity = (pairs->row_capacity > 0 ? 2 * pairs->row_capacity : 64);
+        pairs->row = realloc(pairs->row, sizeof(int) * pairs->row_capacity);
+        assert(pairs->row);
+    }
+    pairs->row[pairs->row_count++] = partner;
+}
+
+/** Finish the row of \c index with the partners pushed since the last row, 
+    which must not include it or repeat. */
+void lay_packed_pairs_end_row(lay_packed_pairs* pairs, const int index);
+
+/** Free the storage of a packed list. */
+void lay_packed_pairs_destroy(lay_packed_pairs* pairs);
+
+/** Read a varint from \c *data and advance past it. */
+static unsigned int lay_varint_read(const unsigned char** data) {
+    const unsigned char* p = *data;
+    unsigned int value = *p & 0x7f;
+    int shift = 7;
+
+    while (*p++ & 0x80) {
+        value |= (unsigned int) (*p & 0x7f) << shift;
+        shift += 7;
+    }
+    *data = p;
+    return value;
+}
+
+/** Decode a zigzag encoded signed value. */
+#define LAY_ZIGZAG_DECODE(u) ((int) ((u) >> 1) ^ -(int) ((u) & 1))
+
+/** Whether boxes \c i and \c j intersect. */
+#define LAY_BOXES_INTERSECT(boxes, i, j) \
+    ((boxes)[4*(i)] < (boxes)[4*(j)+2] && (boxes)[4*(j)] < (boxes)[4*(i)+2] && \
+     (boxes)[4*(i)+1] < (boxes)[4*(j)+3] && (boxes)[4*(j)+1] < (boxes)[4*(i)+3])
+
+/** \name Hierarchical grid */
+/*@{*/
+
+/** The most levels in a hierarchical grid.  Each level doubles the cell size. */
+#define LAY_HGRID_MAX_LEVELS 32
+
+/** A box's entry in a hierarchical grid, sorted by hash bucket. */
+typedef struct {
+    long long cx, cy;   /**< The cell holding the box's lower left corner. */
+    int level;          /**< The level of the cell. */
+    int index;          /**< The index of the box. */
+} lay_hgrid_entry;
+
+/** The number of chunks of hash buckets that a parallel grid build sorts 
+    the boxes into before sorting each chunk into its buckets. */
+#define LAY_HGRID_CHUNKS 1024
+
+/** A hierarchical grid.  Each box goes into the level whose cells are at
+    least as large as the box, so that it touches at most four cells there,
+    and is entered once, in the cell holding its lower left corner.  The
+    cells of all levels share one hash table built by counting sort.
+    The storage is kept between builds, so that building a grid of no more
+    boxes with no more workers than before allocates nothing.
+*/
+typedef struct {
+    int num_levels;                         /**< The number of levels in use. */
+    lay_real_t cell_size[LAY_HGRID_MAX_LEVELS];  /**< The cell size of each level. */
+    int level_count[LAY_HGRID_MAX_LEVELS];  /**< The number of boxes in each level. */
+
+    int num_boxes;              /**< The number of boxes. */
+    int num_buckets;            /**< The number of hash buckets, a power of two. */
+    int* bucket_start;          /**< Start of each bucket in \c entries, plus an end marker. */
+    lay_hgrid_entry* entries;   /**< The entries, sorted by bucket. */
+    int* box_bucket;            /**< The bucket of each box. */
+    int* box_level;             /**< The level of each box. */
+    int capacity;               /**< The number of boxes allocated. */
+    
+    /* Scratch space for the build */
+    int num_chunks;             /**< The number of chunks of buckets. */
+    int chunk_shift;            /**< Shifts a bucket to its chunk. */
+    int* chunk_order;           /**< The boxes sorted by chunk. */
+    int* chunk_start;           /**< Start of each chunk in \c chunk_order, plus an end marker. */
+    int* worker_chunks;         /**< Each worker's count, then next slot, of each chunk. */
+    int* worker_levels;         /**< Each worker's count of the boxes in each level. */
+    lay_real_t* worker_extents; /**< Each worker's smallest and largest box extent. */
+    int worker_capacity;        /**< The number of workers allocated. */
+} lay_hgrid;
+
+/** Build a hierarchical grid over \c count boxes, with the workers of 
+    \c pool, which may be NULL.  The grid is the same whatever the number of
+    workers. */
+void lay_hgrid_build(lay_hgrid* grid, const lay_coord_t* boxes, const int count,
+                     lay_pool* pool);
+
+/** Add every candidate pair of the boxes in a built grid to \c pairs, a 
+    row per box. */
+void lay_hgrid_find_pairs(const lay_hgrid* grid, const lay_coord_t* boxes,
+                          lay_packed_pairs* pairs);
+
+/** Free the storage of a grid. */
+void lay_hgrid_destroy(lay_hgrid* grid);
+
+/*@}*/
+
+/** \name Dynamic bounding volume tree */
+/*@{*/
+
+/** A node of a bounding volume tree.  Leaves hold one box each, grown a 
+    little so that small moves do not change the tree. */
+typedef struct {
+    lay_coord_t box[4];     /**< The bounds of the node. */
+    int parent;             /**< The parent node, or -1 for the root.  The next free node when free. */
+    int child1, child2;     /**< The children, or -1 for a leaf. */
+    int height;             /**< Zero for a leaf, or one more than the taller child. */
+    int index;              /**< The box of a leaf, or -1. */
+} lay_bvh_node;
+
+/** A dynamic bounding volume tree over boxes, kept balanced by rotations
+    as leaves are inserted and removed.  The storage is kept between updates.
+*/
+typedef struct {
+    lay_bvh_node* nodes;    /**< The node pool. */
+    int capacity;           /**< The number of nodes allocated. */
+    int root;               /**< The root node, or -1 if empty. */
+    int free_list;          /**< The first free node, or -1. */
+
+    int num_boxes;          /**< The number of boxes in the tree. */
+    int* leaf;              /**< The leaf node of each box. */
+    int leaf_capacity;      /**< The number of boxes allocated in \c leaf. */
+} lay_bvh;
+
+/** Bring a tree up to date with \c count boxes.  Boxes that have left their 
+    grown leaf bounds are removed and reinserted; the others cost a 
+    containment test.  If the number of boxes changed, the tree is rebuilt. 
+    Returns the number of boxes that were reinserted. */
+int lay_bvh_update(lay_bvh* tree, const lay_coord_t* boxes, const int count);
+
+/** Bring box \c index of a tree up to date with \c box, reinserting it if it
+    has left its grown leaf bounds.  Returns whether it was reinserted. */
+int lay_bvh_move(lay_bvh* tree, const int index, const lay_coord_t* box);
+
+/** Insert box \c index, which must not be in the tree. */
+void lay_bvh_insert(lay_bvh* tree, const int index, const lay_coord_t* box);
+
+/** Remove box \c index, which must be in the tree. */
+void lay_bvh_remove(lay_bvh* tree, const int index);
+
+/** Renumber the boxes in a tree without moving them, so that box \c k is the
+    box that was numbered <tt>old_index[k]</tt>. */
+void lay_bvh_relabel(lay_bvh* tree, const int* old_index);
+
+/** Add every candidate pair of the boxes in an up-to-date tree to \c pairs. */
+void lay_bvh_find_pairs(const lay_bvh* tree, const lay_coord_t* boxes, lay_pair_list* pairs);
+
+/** Called by lay_bvh_query() with each box found. */
+typedef void (*lay_bvh_visit_func)(void* context, const int index);
+
+/** Call \c visit with every box of an up-to-date tree whose grown leaf
+    bounds meet the closed region \c region, given as <tt>x0, y0, x1, y1</tt>.
+    Boxes near the region may be visited too. */
+void lay_bvh_query(const lay_bvh* tree, const lay_coord_t* region,
+                   lay_bvh_visit_func visit, void* context);
+
+/** Free the storage of a tree. */
+void lay_bvh_destroy(lay_bvh* tree);
+
+/*@}*/
+
+/** \name Sweep and prune */
+/*@{*/
+
+/** Sweep and prune over the boxes sorted by their lower edge along the axis
+    of greatest spread.  The edges are sorted by an LSD radix sort of integer
+    keys that order like the coordinates, and each box is tested against the
+    following boxes whose lower edge lies below its upper edge, a block at a 
+    time.  The storage is kept between calls.
+*/
+typedef struct {
+    int axis;                   /**< The sweep axis of the last call, 0 for x or 1 for y. */
+    int capacity;               /**< The number of boxes allocated. */
+    unsigned int* keys;         /**< The sorted keys of the lower edges. */
+    int* order;                 /**< The boxes in sorted order. */
+    unsigned int* scratch_keys; /**< Scratch space for the sort. */
+    int* scratch_order;         /**< Scratch space for the sort. */
+    lay_coord_t* sorted;        /**< The edges in sorted order, an array per edge, padded: lower 
+                                     and upper along the sweep axis, then along the other. */
+} lay_sap;
+
+/** Clear \c pairs and add every candidate pair of \c count boxes, a row 
+    per box in sweep order.  The rows give positions in the sweep, mapped to
+    boxes by the sweep's \c order until the next call. */
+void lay_sap_find_pairs(lay_sap* sap, const lay_coord_t* boxes, const int count,
+                        lay_packed_pairs* pairs);
+
+/** Free the storage of a sweep and prune. */
+void lay_sap_destroy(lay_sap* sap);
+
+/*@}*/
+
+/** \name Broad phase selection */
+/*@{*/
+
+/** The number of broad phases the selector chooses between, the
+    LAY_BROAD_PHASE_ values from zero. */
+#define LAY_NUM_BROAD_PHASES 6
+
+/** A cost model for choosing the broad phase of each evaluation.  The 
+    predicted cost of a broad phase comes from the number of boxes, the spread
+    of their sizes and the number of candidate pairs, with default costs per 
+    unit of work scaled by a factor calibrated from the measured time of 
+    every evaluation.  Broad phases whose prediction comes close to the best
+    are tried once for a period, so that their factor is calibrated too.
+*/
+typedef struct {
+    double scale[LAY_NUM_BROAD_PHASES];     /**< Calibrated ratio of measured to predicted cost. */
+    int measured[LAY_NUM_BROAD_PHASES];     /**< The number of evaluations timed with each. */
+    double pairs_per_box;   /**< Candidate pairs per box at the last evaluation. */
+    double levels;          /**< Size classes spanned by the boxes when last sampled. */
+    double sweep_per_box;   /**< Boxes each box is tested against by sweep and prune, when last sampled. */
+    int choice;             /**< The current choice. */
+    int evals_left;         /**< Evaluations until the choice is reconsidered. */
+} lay_autotune;
+
+/** Reset a selector to its default cost model. */
+void lay_autotune_init(lay_autotune* tune);
+
+/** Make the next call to lay_autotune_choose() reconsider its choice. */
+void lay_autotune_reset(lay_autotune* tune);
+
+/** Choose the broad phase for an evaluation of \c count boxes.  The choice 
+    is reconsidered every few evaluations, so the cost of sampling the boxes 
+    is spread out. */
+int lay_autotune_choose(lay_autotune* tune, const lay_coord_t* boxes, const int count);
+
+/** Calibrate the cost model with the time \c ns taken to find and evaluate
+    the pairs of \c count boxes with broad phase \c choice, which found 
+    \c pairs candidate pairs, or overlapping pairs when testing every pair. */
+void lay_autotune_record(lay_autotune* tune, const int choice, const int count,
+                         const long pairs, const long long ns);
+
+/*@}*/
+
+#endif
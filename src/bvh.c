@@ -0,0 +1,415 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "broadphase.h"
+
+/** Leaf bounds are grown by the box's larger extent divided by this, so that
+    a box can drift that far before its leaf has to be reinserted. */
+#define FATTEN_DIVISOR 8
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+/** Set \c out to the union of boxes \c a and \c b. */
+static void box_union(lay_coord_t* out, const lay_coord_t* a, const lay_coord_t* b) {
+    out[0] = MIN(a[0], b[0]);
+    out[1] = MIN(a[1], b[1]);
+    out[2] = MAX(a[2], b[2]);
+    out[3] = MAX(a[3], b[3]);
+}
+
+/** The perimeter of a box, the cost measure for choosing where to insert. */
+static lay_real_t perimeter(const lay_coord_t* box) {
+    return (lay_real_t) 2 * ((box[2] - box[0]) + (box[3] - box[1]));
+}
+
+/** The perimeter of the union of two boxes. */
+static lay_real_t union_perimeter(const lay_coord_t* a, const lay_coord_t* b) {
+    lay_coord_t box[4];
+    box_union(box, a, b);
+    return perimeter(box);
+}
+
+/** Whether box \c outer contains box \c inner. */
+static int box_contains(const lay_coord_t* outer, const lay_coord_t* inner) {
+    return outer[0] <= inner[0] && outer[1] <= inner[1] &&
+           inner[2] <= outer[2] && inner[3] <= outer[3];
+}
+
+/** Take a node from the free list, growing the pool if it is empty. */
+static int allocate_node(lay_bvh* tree) {
+    int i, node;
+
+    if (tree->free_list < 0) {
+        const int old_capacity = tree->capacity;
+        tree->capacity = (old_capacity > 0 ? 2 * old_capacity : 64);
+        tree->nodes = realloc(tree->nodes, sizeof(lay_bvh_node) * tree->capacity);
+        assert(tree->nodes);
+        for (i = old_capacity; i < tree->capacity; ++i)
+            tree->nodes[i].parent = (i + 1 < tree->capacity ? i + 1 : -1);
+        tree->free_list = old_capacity;
+    }
+
+    node = tree->free_list;
+    tree->free_list = tree->nodes[node].parent;
+    tree->nodes[node].parent = -1;
+    tree->nodes[node].child1 = -1;
+    tree->nodes[node].child2 = -1;
+    tree->nodes[node].height = 0;
+    tree->nodes[node].index = -1;
+    return node;
+}
+
+static void free_node(lay_bvh* tree, const int node) {
+    tree->nodes[node].parent = tree->free_list;
+    tree->nodes[node].height = -1;
+    tree->free_list = node;
+}
+
+/** Replace child \c old_child of \c parent, or the root if \c parent is -1. */
+static void replace_child(lay_bvh* tree, const int parent, const int old_child, const int new_child) {
+    if (parent < 0)
+        tree->root = new_child;
+    else if (tree->nodes[parent].child1 == old_child)
+        tree->nodes[parent].child1 = new_child;
+    else
+        tree->nodes[parent].child2 = new_child;
+}
+
+/** Recompute the bounds and height of an internal node from its children. */
+static void refit(lay_bvh* tree, const int node) {
+    lay_bvh_node* n = tree->nodes + node;
+    const lay_bvh_node* c1 = tree->nodes + n->child1;
+    const lay_bvh_node* c2 = tree->nodes + n->child2;
+    box_union(n->box, c1->box, c2->box);
+    n->height = 1 + MAX(c1->height, c2->height);
+}
+
+/** If the subtree at \c a is unbalanced, rotate its taller child up in its
+    place.  Returns the node now at the top of the subtree. */
+static int balance(lay_bvh* tree, const int a) {
+    lay_bvh_node* A = tree->nodes + a;
+    int b, c, up, other, grand1, grand2, keep, move;
+
+    if (A->child1 < 0 || A->height < 2)
+        return a;
+
+    b = A->child1;
+    c = A->child2;
+    if (tree->nodes[c].height - tree->nodes[b].height > 1) {
+        up = c;
+        other = b;
+    } else if (tree->nodes[b].height - tree->nodes[c].height > 1) {
+        up = b;
+        other = c;
+    } else {
+        return a;
+    }
+
+    /* The taller child takes a's place, and a adopts the shorter of the
+       taller child's children in place of the taller child itself. */
+    grand1 = tree->nodes[up].child1;
+    grand2 = tree->nodes[up].child2;
+    if (tree->nodes[grand1].height > tree->nodes[grand2].height) {
+        keep = grand1;
+        move = grand2;
+    } else {
+        keep = grand2;
+        move = grand1;
+    }
+
+    tree->nodes[up].parent = A->parent;
+    replace_child(tree, A->parent, a, up);
+    tree->nodes[up].child1 = a;
+    tree->nodes[up].child2 = keep;
+    A->parent = up;
+
+    A->child1 = other;
+    A->child2 = move;
+    tree->nodes[move].parent = a;
+
+    refit(tree, a);
+    refit(tree, up);
+    return up;
+}
+
+/** Refit and rebalance every node from \c node up to the root. */
+static void fix_upwards(lay_bvh* tree, int node) {
+    while (node >= 0) {
+        node = balance(tree, node);
+        refit(tree, node);
+        node = tree->nodes[node].parent;
+    }
+}
+
+/** Insert a leaf node into the tree, next to the node that increases the
+    total perimeter of the tree the least. */
+static void insert_leaf(lay_bvh* tree, const int leaf) {
+    const lay_coord_t* box = tree->nodes[leaf].box;
+    lay_real_t cost, inherit, cost1, cost2;
+    int node, sibling, old_parent, parent, c1, c2;
+
+    if (tree->root < 0) {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = -1;
+        return;
+    }
+
+    /* Descend to the cheapest sibling. */
+    node = tree->root;
+    while (tree->nodes[node].child1 >= 0) {
+        c1 = tree->nodes[node].child1;
+        c2 = tree->nodes[node].child2;
+
+        cost = 2 * union_perimeter(tree->nodes[node].box, box);
+        inherit = cost - 2 * perimeter(tree->nodes[node].box);
+
+        cost1 = union_perimeter(tree->nodes[c1].box, box) + inherit;
+        if (tree->nodes[c1].child1 >= 0)
+            cost1 -= perimeter(tree->nodes[c1].box);
+        cost2 = union_perimeter(tree->nodes[c2].box, box) + inherit;
+        if (tree->nodes[c2].child1 >= 0)
+            cost2 -= perimeter(tree->nodes[c2].box);
+
+        if (cost < cost1 && cost < cost2)
+            break;
+        node = (cost1 < cost2 ? c1 : c2);
+    }
+    sibling = node;
+
+    /* Pair the leaf with its sibling under a new parent. */
+    old_parent = tree->nodes[sibling].parent;
+    parent = allocate_node(tree);
+    tree->nodes[parent].parent = old_parent;
+    tree->nodes[parent].child1 = sibling;
+    tree->nodes[parent].child2 = leaf;
+    replace_child(tree, old_parent, sibling, parent);
+    tree->nodes[sibling].parent = parent;
+    tree->nodes[leaf].parent = parent;
+
+    fix_upwards(tree, parent);
+}
+
+/** Unlink a leaf node from the tree, replacing its parent by its sibling. */
+static void remove_leaf(lay_bvh* tree, const int leaf) {
+    int parent, grand_parent, sibling;
+
+    if (leaf == tree->root) {
+        tree->root = -1;
+        return;
+    }
+
+    parent = tree->nodes[leaf].parent;
+    grand_parent = tree->nodes[parent].parent;
+    sibling = (tree->nodes[parent].child1 == leaf ? tree->nodes[parent].child2
+                                                  : tree->nodes[parent].child1);
+
+    replace_child(tree, grand_parent, parent, sibling);
+    tree->nodes[sibling].parent = grand_parent;
+    free_node(tree, parent);
+
+    fix_upwards(tree, grand_parent);
+}
+
+/** Set a leaf's bounds to box grown by a fraction of its size. */
+static void set_leaf_box(lay_bvh_node* n, const lay_coord_t* box) {
+    const lay_coord_t w = box[2] - box[0], h = box[3] - box[1];
+    const lay_coord_t grow = MAX(w, h) / FATTEN_DIVISOR;
+    n->box[0] = box[0] - grow;
+    n->box[1] = box[1] - grow;
+    n->box[2] = box[2] + grow;
+    n->box[3] = box[3] + grow;
+}
+
+void lay_bvh_insert(lay_bvh* tree, const int index, const lay_coord_t* box) {
+    int leaf;
+
+    assert(tree && index >= 0 && index < tree->leaf_capacity && box);
+    leaf = allocate_node(tree);
+    tree->nodes[leaf].index = index;
+    set_leaf_box(tree->nodes + leaf, box);
+    tree->leaf[index] = leaf;
+    insert_leaf(tree, leaf);
+}
+
+void lay_bvh_remove(lay_bvh* tree, const int index) {
+    int leaf;
+
+    assert(tree && index >= 0 && index < tree->leaf_capacity);
+    leaf = tree->leaf[index];
+    assert(leaf >= 0 && tree->nodes[leaf].index == index);
+    remove_leaf(tree, leaf);
+    free_node(tree, leaf);
+    tree->leaf[index] = -1;
+}
+
+int lay_bvh_update(lay_bvh* tree, const lay_coord_t* boxes, const int count) {
+    int i, moved = 0;
+
+    assert(tree && (boxes || count == 0) && count >= 0);
+
+    if (!tree->nodes || count != tree->num_boxes) {
+        /* Start over with every node free. */
+        if (count > tree->leaf_capacity) {
+            tree->leaf_capacity = count;
+            tree->leaf = realloc(tree->leaf, sizeof(int) * count);
+            assert(tree->leaf);
+        }
+        tree->root = -1;
+        tree->free_list = -1;
+        for (i = tree->capacity - 1; i >= 0; --i)
+            free_node(tree, i);
+        tree->num_boxes = count;
+
+        for (i = 0; i < count; ++i)
+            lay_bvh_insert(tree, i, boxes + 4 * i);
+        return count;
+    }
+
+    for (i = 0; i < count; ++i)
+        moved += lay_bvh_move(tree, i, boxes + 4 * i);
+    return moved;
+}
+
+int lay_bvh_move(lay_bvh* tree, const int index, const lay_coord_t* box) {
+    assert(tree && index >= 0 && index < tree->num_boxes && box);
+    if (box_contains(tree->nodes[tree->leaf[index]].box, box))
+        return 0;
+    lay_bvh_remove(tree, index);
+    lay_bvh_insert(tree, index, box);
+    return 1;
+}
+
+void lay_bvh_relabel(lay_bvh* tree, const int* old_index) {
+    int* leaf;
+    int k;
+
+    assert(tree && (old_index || tree->num_boxes == 0));
+    if (!tree->nodes || tree->num_boxes == 0)
+        return;
+
+    leaf = malloc(sizeof(int) * tree->num_boxes);
+    assert(leaf);
+    for (k = 0; k < tree->num_boxes; ++k) {
+        leaf[k] = tree->leaf[old_index[k]];
+        tree->nodes[leaf[k]].index = k;
+    }
+    memcpy(tree->leaf, leaf, sizeof(int) * tree->num_boxes);
+    free(leaf);
+}
+
+/** Whether two nodes' bounds intersect. */
+static int nodes_intersect(const lay_bvh_node* a, const lay_bvh_node* b) {
+    return a->box[0] < b->box[2] && b->box[0] < a->box[2] &&
+           a->box[1] < b->box[3] && b->box[1] < a->box[3];
+}
+
+/** Add the candidate pairs with one box under node \c a and the other under
+    node \c b, descending into the larger node first. */
+static void find_cross_pairs(const lay_bvh* tree, const int a, const int b,
+                             const lay_coord_t* boxes, lay_pair_list* pairs) {
+    const lay_bvh_node* A = tree->nodes + a;
+    const lay_bvh_node* B = tree->nodes + b;
+
+    if (!nodes_intersect(A, B))
+        return;
+
+    if (A->child1 < 0 && B->child1 < 0) {
+        /* Leaf bounds are grown, so test the boxes themselves. */
+        if (LAY_BOXES_INTERSECT(boxes, A->index, B->index)) {
+            if (A->index < B->index)
+                lay_pair_list_add(pairs, A->index, B->index);
+            else
+                lay_pair_list_add(pairs, B->index, A->index);
+        }
+    } else if (B->child1 < 0 || (A->child1 >= 0 && perimeter(A->box) >= perimeter(B->box))) {
+        find_cross_pairs(tree, A->child1, b, boxes, pairs);
+        find_cross_pairs(tree, A->child2, b, boxes, pairs);
+    } else {
+        find_cross_pairs(tree, a, B->child1, boxes, pairs);
+        find_cross_pairs(tree, a, B->child2, boxes, pairs);
+    }
+}
+
+/** Add the candidate pairs with both boxes under \c node. */
+static void find_self_pairs(const lay_bvh* tree, const int node,
+                            const lay_coord_t* boxes, lay_pair_list* pairs) {
+    const lay_bvh_node* n = tree->nodes + node;
+
+    if (n->child1 < 0)
+        return;
+    find_self_pairs(tree, n->child1, boxes, pairs);
+    find_self_pairs(tree, n->child2, boxes, pairs);
+    find_cross_pairs(tree, n->child1, n->child2, boxes, pairs);
+}
+
+void lay_bvh_find_pairs(const lay_bvh* tree, const lay_coord_t* boxes, lay_pair_list* pairs) {
+    assert(tree && pairs);
+
+    /* Traverse the tree against itself, which visits each pair of 
+       intersecting subtrees once instead of querying once per box.  The 
+       recursion is no deeper than twice the height of the balanced tree. */
+    if (tree->root >= 0)
+        find_self_pairs(tree, tree->root, boxes, pairs);
+}
+
+/** Visit every box under \c node whose leaf bounds meet \c region. */
+static void query_node(const lay_bvh* tree, const int node, const lay_coord_t* region,
+                       lay_bvh_visit_func visit, void* context) {
+    const lay_bvh_node* n = tree->nodes + node;
+
+    /* The region is closed, so touching counts. */
+    if (n->box[0] > region[2] || region[0] > n->box[2] ||
+        n->box[1] > region[3] || region[1] > n->box[3])
+        return;
+
+    if (n->child1 < 0) {
+        visit(context, n->index);
+    } else {
+        query_node(tree, n->child1, region, visit, context);
+        query_node(tree, n->child2, region, visit, context);
+    }
+}
+
+void lay_bvh_query(const lay_bvh* tree, const lay_coord_t* region,
+                   lay_bvh_visit_func visit, void* context) {
+    assert(tree && region && visit);
+    if (tree->root >= 0)
+        query_node(tree, tree->root, region, visit, context);
+}
+
+void lay_bvh_destroy(lay_bvh* tree) {
+    assert(tree);
+    free(tree->nodes);
+    free(tree->leaf);
+    tree->nodes = NULL;
+    tree->leaf = NULL;
+    tree->capacity = 0;
+    tree->leaf_capacity = 0;
+    tree->num_boxes = 0;
+    tree->root = -1;
+    tree->free_list = -1;
+}
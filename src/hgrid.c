@@ -0,0 +1,339 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+
+#include "broadphase.h"
+
+/** The cell containing a coordinate. */
+static long long cell_coord(const lay_coord_t x, const lay_real_t cell_size) {
+    return (long long) floor((double) x / cell_size);
+}
+
+/** The hash bucket of a cell. */
+static int cell_bucket(const lay_hgrid* grid, const int level,
+                       const long long cx, const long long cy) {
+    unsigned long long h = (unsigned long long) cx * 0x9E3779B97F4A7C15ULL
+                         ^ (unsigned long long) cy * 0xC2B2AE3D27D4EB4FULL
+                         ^ (unsigned long long) level * 0x165667B19E3779F9ULL;
+    h ^= h >> 29;
+    return (int) (h & (unsigned long long) (grid->num_buckets - 1));
+}
+
+/** The larger extent of a box. */
+static lay_real_t box_extent(const lay_coord_t* box) {
+    return (lay_real_t) (box[2] - box[0] > box[3] - box[1] ? box[2] - box[0] : box[3] - box[1]);
+}
+
+/** The first of the boxes that worker \c w of \c n handles. */
+#define WORKER_BEGIN(count, w, n) ((int) ((long long) (count) * (w) / (n)))
+
+/** Make room for \c count boxes and \c num_workers workers. */
+static void reserve(lay_hgrid* grid, const int count, const int num_workers) {
+    int buckets = 1, shift = 0;
+
+    /* Keep the load factor at or below one half. */
+    while (buckets < 2 * count)
+        buckets *= 2;
+    if (buckets != grid->num_buckets) {
+        grid->num_buckets = buckets;
+        grid->bucket_start = realloc(grid->bucket_start, sizeof(int) * (buckets + 1));
+        assert(grid->bucket_start);
+    }
+    while ((buckets >> shift) > LAY_HGRID_CHUNKS)
+        ++shift;
+    grid->chunk_shift = shift;
+    grid->num_chunks = buckets >> shift;
+    if (!grid->chunk_start) {
+        grid->chunk_start = malloc(sizeof(int) * (LAY_HGRID_CHUNKS + 1));
+        assert(grid->chunk_start);
+    }
+
+    if (count > grid->capacity) {
+        grid->capacity = count;
+        grid->entries = realloc(grid->entries, sizeof(lay_hgrid_entry) * count);
+        grid->box_bucket = realloc(grid->box_bucket, sizeof(int) * count);
+        grid->box_level = realloc(grid->box_level, sizeof(int) * count);
+        grid->chunk_order = realloc(grid->chunk_order, sizeof(int) * count);
+        assert(grid->entries && grid->box_bucket && grid->box_level && grid->chunk_order);
+    }
+    
+    if (num_workers > grid->worker_capacity) {
+        grid->worker_capacity = num_workers;
+        grid->worker_chunks = realloc(grid->worker_chunks, 
+                                      sizeof(int) * LAY_HGRID_CHUNKS * num_workers);
+        grid->worker_levels = realloc(grid->worker_levels, 
+                                      sizeof(int) * LAY_HGRID_MAX_LEVELS * num_workers);
+        grid->worker_extents = realloc(grid->worker_extents, sizeof(lay_real_t) * 2 * num_workers);
+        assert(grid->worker_chunks && grid->worker_levels && grid->worker_extents);
+    }
+}
+
+/** The grid and boxes of a build, shared by its workers. */
+typedef struct {
+    lay_hgrid* grid;            /**< The grid being built. */
+    const lay_coord_t* boxes;   /**< The boxes. */
+} build_args;
+
+/** Find the smallest non-zero and the largest extent of a worker's boxes. */
+static void measure_extents(void* arg, const int worker, const int num_workers) {
+    const build_args* a = (const build_args*) arg;
+    lay_hgrid* grid = a->grid;
+    const int end = WORKER_BEGIN(grid->num_boxes, worker + 1, num_workers);
+    lay_real_t ext, min_ext = 0, max_ext = 0;
+    int i;
+
+    for (i = WORKER_BEGIN(grid->num_boxes, worker, num_workers); i < end; ++i) {
+        ext = box_extent(a->boxes + 4 * i);
+        if (ext > 0 && (min_ext == 0 || ext < min_ext))
+            min_ext = ext;
+        if (ext > max_ext)
+            max_ext = ext;
+    }
+    grid->worker_extents[2*worker] = min_ext;
+    grid->worker_extents[2*worker+1] = max_ext;
+}
+
+/** Assign a worker's boxes to their levels and buckets, and count them per 
+    level and per chunk. */
+static void assign_boxes(void* arg, const int worker, const int num_workers) {
+    const build_args* a = (const build_args*) arg;
+    lay_hgrid* grid = a->grid;
+    const int end = WORKER_BEGIN(grid->num_boxes, worker + 1, num_workers);
+    int* chunks = grid->worker_chunks + LAY_HGRID_CHUNKS * worker;
+    int* levels = grid->worker_levels + LAY_HGRID_MAX_LEVELS * worker;
+    lay_real_t ext;
+    int i, l;
+
+    for (i = 0; i < grid->num_chunks; ++i)
+        chunks[i] = 0;
+    for (l = 0; l < LAY_HGRID_MAX_LEVELS; ++l)
+        levels[l] = 0;
+
+    for (i = WORKER_BEGIN(grid->num_boxes, worker, num_workers); i < end; ++i) {
+        const lay_coord_t* box = a->boxes + 4 * i;
+        ext = box_extent(box);
+        for (l = 0; l < LAY_HGRID_MAX_LEVELS - 1 && ext > grid->cell_size[l]; ++l)
+            ;
+        ++levels[l];
+
+        grid->box_level[i] = l;
+        grid->box_bucket[i] = cell_bucket(grid, l, cell_coord(box[0], grid->cell_size[l]),
+                                          cell_coord(box[1], grid->cell_size[l]));
+        ++chunks[grid->box_bucket[i] >> grid->chunk_shift];
+    }
+}
+
+/** Sort a worker's boxes by chunk, from the slots set aside for it. */
+static void scatter_chunks(void* arg, const int worker, const int num_workers) {
+    const build_args* a = (const build_args*) arg;
+    lay_hgrid* grid = a->grid;
+    const int end = WORKER_BEGIN(grid->num_boxes, worker + 1, num_workers);
+    int* next = grid->worker_chunks + LAY_HGRID_CHUNKS * worker;
+    int i;
+
+    for (i = WORKER_BEGIN(grid->num_boxes, worker, num_workers); i < end; ++i)
+        grid->chunk_order[next[grid->box_bucket[i] >> grid->chunk_shift]++] = i;
+}
+
+/** Counting sort the boxes of every <tt>num_workers</tt>-th chunk into their
+    buckets.  The buckets of a chunk are consecutive, so the workers write 
+    disjoint parts of the bucket starts and entries. */
+static void sort_chunks(void* arg, const int worker, const int num_workers) {
+    const build_args* a = (const build_args*) arg;
+    lay_hgrid* grid = a->grid;
+    const int buckets_per_chunk = 1 << grid->chunk_shift;
+    int* bucket_start = grid->bucket_start;
+    int c, k, b, b0, b1, i, count, next;
+
+    for (c = worker; c < grid->num_chunks; c += num_workers) {
+        b0 = c * buckets_per_chunk;
+        b1 = b0 + buckets_per_chunk;
+
+        for (b = b0; b < b1; ++b)
+            bucket_start[b] = 0;
+        for (k = grid->chunk_start[c]; k < grid->chunk_start[c + 1]; ++k)
+            ++bucket_start[grid->box_bucket[grid->chunk_order[k]]];
+        for (b = b0, next = grid->chunk_start[c]; b < b1; ++b) {
+            count = bucket_start[b];
+            bucket_start[b] = next;
+            next += count;
+        }
+
+        for (k = grid->chunk_start[c]; k < grid->chunk_start[c + 1]; ++k) {
+            const lay_coord_t* box;
+            lay_hgrid_entry* e;
+            lay_real_t cell_size;
+
+            i = grid->chunk_order[k];
+            box = a->boxes + 4 * i;
+            cell_size = grid->cell_size[grid->box_level[i]];
+            e = grid->entries + bucket_start[grid->box_bucket[i]]++;
+            e->cx = cell_coord(box[0], cell_size);
+            e->cy = cell_coord(box[1], cell_size);
+            e->level = grid->box_level[i];
+            e->index = i;
+        }
+
+        /* The scatter advanced each start to the next bucket's start. */
+        for (b = b1 - 1; b > b0; --b)
+            bucket_start[b] = bucket_start[b - 1];
+        bucket_start[b0] = grid->chunk_start[c];
+    }
+}
+
+void lay_hgrid_build(lay_hgrid* grid, const lay_coord_t* boxes, const int count,
+                     lay_pool* pool) {
+    const int num_workers = lay_pool_size(pool);
+    lay_real_t min_ext, max_ext, smallest;
+    build_args args;
+    int w, l, c, next, n;
+
+    assert(grid && (boxes || count == 0) && count >= 0);
+    reserve(grid, count, num_workers);
+    grid->num_boxes = count;
+    args.grid = grid;
+    args.boxes = boxes;
+
+    /* The finest cells fit the smallest box, unless that would need too many
+       levels to reach the largest box. */
+    lay_pool_run(pool, measure_extents, &args);
+    min_ext = 0;
+    max_ext = 0;
+    for (w = 0; w < num_workers; ++w) {
+        if (grid->worker_extents[2*w] > 0 && (min_ext == 0 || grid->worker_extents[2*w] < min_ext))
+            min_ext = grid->worker_extents[2*w];
+        if (grid->worker_extents[2*w+1] > max_ext)
+            max_ext = grid->worker_extents[2*w+1];
+    }
+    smallest = (lay_real_t) ldexp(max_ext, -(LAY_HGRID_MAX_LEVELS - 1));
+    if (min_ext < smallest)
+        min_ext = smallest;
+    if (min_ext == 0)
+        min_ext = 1;
+    for (l = 0; l < LAY_HGRID_MAX_LEVELS; ++l)
+        grid->cell_size[l] = (lay_real_t) ldexp(min_ext, l);
+
+    /* Assign levels and buckets, and count the boxes in each chunk. */
+    lay_pool_run(pool, assign_boxes, &args);
+    grid->num_levels = 1;
+    for (l = 0; l < LAY_HGRID_MAX_LEVELS; ++l) {
+        grid->level_count[l] = 0;
+        for (w = 0; w < num_workers; ++w)
+            grid->level_count[l] += grid->worker_levels[LAY_HGRID_MAX_LEVELS * w + l];
+        if (grid->level_count[l] > 0)
+            grid->num_levels = l + 1;
+    }
+
+    /* Each worker's boxes of a chunk follow the previous worker's, so that 
+       boxes stay in index order within their buckets, as in a serial sort. */
+    for (c = 0, next = 0; c < grid->num_chunks; ++c) {
+        grid->chunk_start[c] = next;
+        for (w = 0; w < num_workers; ++w) {
+            n = grid->worker_chunks[LAY_HGRID_CHUNKS * w + c];
+            grid->worker_chunks[LAY_HGRID_CHUNKS * w + c] = next;
+            next += n;
+        }
+    }
+    grid->chunk_start[grid->num_chunks] = count;
+    grid->bucket_start[grid->num_buckets] = count;
+
+    /* Sort the boxes by chunk, then each chunk by bucket. */
+    lay_pool_run(pool, scatter_chunks, &args);
+    lay_pool_run(pool, sort_chunks, &args);
+}
+
+void lay_hgrid_find_pairs(const lay_hgrid* grid, const lay_coord_t* boxes,
+                          lay_packed_pairs* pairs) {
+    long long cx, cy, cx0, cx1, cy0, cy1;
+    int i, l, k, b, own_level;
+
+    assert(grid && pairs);
+    lay_packed_pairs_clear(pairs, NULL);
+
+    for (i = 0; i < grid->num_boxes; ++i) {
+        const lay_coord_t* box = boxes + 4 * i;
+        own_level = grid->box_level[i];
+
+        /* Boxes only look for partners in their own and coarser levels, so
+           each pair across levels is found once, by its smaller box. */
+        for (l = own_level; l < grid->num_levels; ++l) {
+            if (grid->level_count[l] == 0)
+                continue;
+
+            /* A box entered in cell c of this level lies within cells c and
+               c + 1, so only a few cells around this box can hold partners. */
+            cx0 = cell_coord(box[0], grid->cell_size[l]) - 1;
+            cy0 = cell_coord(box[1], grid->cell_size[l]) - 1;
+            cx1 = cell_coord(box[2], grid->cell_size[l]);
+            cy1 = cell_coord(box[3], grid->cell_size[l]);
+
+            for (cy = cy0; cy <= cy1; ++cy) {
+                for (cx = cx0; cx <= cx1; ++cx) {
+                    b = cell_bucket(grid, l, cx, cy);
+                    for (k = grid->bucket_start[b]; k < grid->bucket_start[b + 1]; ++k) {
+                        const lay_hgrid_entry* e = grid->entries + k;
+
+                        if (e->cx != cx || e->cy != cy || e->level != l)
+                            continue;
+
+                        /* Within a level both boxes find each other. */
+                        if (l == own_level && e->index <= i)
+                            continue;
+
+                        if (LAY_BOXES_INTERSECT(boxes, i, e->index))
+                            lay_packed_pairs_push(pairs, e->index);
+                    }
+                }
+            }
+        }
+        lay_packed_pairs_end_row(pairs, i);
+    }
+}
+
+void lay_hgrid_destroy(lay_hgrid* grid) {
+    assert(grid);
+    free(grid->bucket_start);
+    free(grid->entries);
+    free(grid->box_bucket);
+    free(grid->box_level);
+    free(grid->chunk_order);
+    free(grid->chunk_start);
+    free(grid->worker_chunks);
+    free(grid->worker_levels);
+    free(grid->worker_extents);
+    grid->bucket_start = NULL;
+    grid->entries = NULL;
+    grid->box_bucket = NULL;
+    grid->box_level = NULL;
+    grid->chunk_order = NULL;
+    grid->chunk_start = NULL;
+    grid->worker_chunks = NULL;
+    grid->worker_levels = NULL;
+    grid->worker_extents = NULL;
+    grid->num_buckets = 0;
+    grid->capacity = 0;
+    grid->worker_capacity = 0;
+    grid->num_boxes = 0;
+}
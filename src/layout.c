@@ -20,18 +20,26 @@
     or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
 */
 
+/* For clock_gettime */
+#define _POSIX_C_SOURCE 199309L
+
 #include <layout/layout.h>
 #include <layout/overlap.h>
 #include <layout/macopt.h>
+#include <layout/legalize.h>
+#include "broadphase.h"
+#include "sfc.h"
+#include "tiled.h"
+#include "bitset.h"
+#include "strided.h"
+#include "state.h"
 
 #include <float.h>
 #include <math.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
-
-/** Increment a pointer \c count times, skipping \c skip bytes each time. */
-#define LAY_INCR_POINTER(pointer, count, skip) (((char*) (pointer)) + (count) * (skip))
+#include <time.h>
 
 /** Get a pointer to the \c count'th position. */
 #define LAY_POS_POINTER(state, count) ((lay_coord_t*) LAY_INCR_POINTER(state->pos, count, state->pos_skip))
@@ -45,6 +53,52 @@
 /** Get a pointer to the next size. */
 #define LAY_NEXT_SIZE(state, pointer) ((lay_extent_t*) (((char*) (pointer)) + state->size_skip))
 
+/** Get the \c count'th value of a registered per-rectangle array of \c type. */
+#define LAY_PER_RECT(type, array, count, skip) (*(const type*) LAY_INCR_POINTER(array, count, skip))
+
+/** Get the \c count'th margin, which must be registered. */
+#define LAY_MARGIN(state, count) (*(const lay_extent_t*) LAY_INCR_POINTER(state->margins, count, state->margins_skip))
+
+/** Copy the settings that the float and double optimizer arguments share 
+    from \c a into \c d. */
+#define COPY_OPT_SETTINGS(d, a)                     \
+    do {                                            \
+        (d)->tol = (a)->tol;                        \
+        (d)->grad_tol_tiny = (a)->grad_tol_tiny;    \
+        (d)->step_tol_tiny = (a)->step_tol_tiny;    \
+        (d)->end_if_small_step = (a)->end_if_small_step; \
+        (d)->itmax = (a)->itmax;                    \
+        (d)->rich = (a)->rich;                      \
+        (d)->verbose = (a)->verbose;                \
+        (d)->stepmax = (a)->stepmax;                \
+        (d)->linmin_maxits = (a)->linmin_maxits;    \
+        (d)->linmin_g1 = (a)->linmin_g1;            \
+        (d)->linmin_g2 = (a)->linmin_g2;            \
+        (d)->linmin_g3 = (a)->linmin_g3;            \
+        (d)->lastx = (a)->lastx;                    \
+        (d)->lastx_default = (a)->lastx_default;    \
+        (d)->max_evals = (a)->max_evals;            \
+        (d)->max_ns = (a)->max_ns;                  \
+    } while (0)
+
+#if defined(LAY_REAL_IS_FLOAT)
+/** The precision of lay_real_t, in which eval() and its kernels run. */
+#define LAY_REAL_PRECISION LAY_PRECISION_FLOAT
+
+/** The type of macopt's positions when it runs in the other precision. */
+typedef double other_real_t;
+#else
+#define LAY_REAL_PRECISION LAY_PRECISION_DOUBLE
+typedef float other_real_t;
+#endif
+
+/** A compensated sum of energy terms, using Neumaier's variant of Kahan 
+    summation to carry the low-order bits that each addition loses. */
+typedef struct {
+    double sum;         /**< The running sum. */
+    double carry;       /**< The rounding error lost from \c sum so far. */
+} energy_sum;
+
 /** Layout state */
 struct lay_state {
     /* Rectangle list */
@@ -56,19 +110,83 @@ struct lay_state {
     lay_extent_t* size;             /**< Pointer to size data. */
     ptrdiff_t size_skip;            /**< Number of bytes to skip to get to the next size. */
     
+    const lay_extent_t* margins;    /**< Pointer to per-rectangle margins, or NULL. */
+    ptrdiff_t margins_skip;         /**< Number of bytes to skip to get to the next margin. */
+    
+    const lay_real_t* overlap_weights;  /**< Pointer to per-rectangle overlap weights, or NULL. */
+    ptrdiff_t overlap_weights_skip;     /**< Number of bytes to skip to get to the next overlap weight. */
+    const lay_real_t* orig_pos_weights; /**< Pointer to per-rectangle original position weights, or NULL. */
+    ptrdiff_t orig_pos_weights_skip;    /**< Number of bytes to skip to get to the next original position weight. */
+    
+    const int* fixed;               /**< Pointer to per-rectangle fixed flags, or NULL. */
+    ptrdiff_t fixed_skip;           /**< Number of bytes to skip to get to the next fixed flag. */
+    
     /* Optimization settings */
     lay_real_t overlap_weight;      /**< The overlap penalty weight. */
     lay_real_t edge_weight;         /**< The edge penalty weight. */
     lay_real_t center_weight;       /**< The center penalty weight. */
     lay_real_t orig_pos_weight;     /**< The original position penalty weight. */
+    lay_extent_t margin;            /**< The minimum gap between any two rectangles. */
     
     /* Temporary storage */
-    float* dof;                     /**< The degrees of freedom, modified by the optimizer. (macopt uses float) */
+    int temps_capacity;             /**< The number of rectangles the num_rect-based temps are allocated for. */
+    lay_coord_t* dof;               /**< The degrees of freedom, modified by the optimizer, or read by eval() while it works on \c solver. */
+    other_real_t* solver;           /**< The optimizer's own copy of the degrees of freedom, if its precision is not that of lay_real_t. */
+    lay_real_t* solver_grad;        /**< The gradient of eval() at \c dof, for conversion into \c solver's precision. */
+    const lay_coord_t* anchor;      /**< Dense original positions while optimizing in place, otherwise NULL. */
+    lay_coord_t* boxes;             /**< Dense boxes, grown by the margins, for the broad phase. */
+    
+    /* Broad phase */
+    int broad_phase;                /**< The broad phase, one of LAY_BROAD_PHASE_*. */
+    lay_autotune tune;              /**< The cost model behind LAY_BROAD_PHASE_AUTO. */
+    lay_pair_list pairs;            /**< Candidate pairs from the tree. */
+    lay_packed_pairs packed;        /**< Candidate pairs from the grid and sweep and prune, packed by row. */
+    lay_hgrid hgrid;                /**< The hierarchical grid. */
+    lay_bvh bvh;                    /**< The bounding volume tree, kept up to date between evaluations. */
+    lay_tiled tiled;                /**< Dense data for the tiled all-pairs kernel. */
+    lay_sap sap;                    /**< The sweep and prune storage. */
+    lay_bitset bitset;              /**< The bit matrix of intersecting boxes. */
+    int index_stale;                /**< Whether the tree must be brought up to date before a query. */
+    int* order_index;               /**< The internal index of each registered rectangle, while the tree is up to date. */
+    int num_threads;                /**< The number of threads for an evaluation, or zero for one per processor. */
+    lay_pool* pool;                 /**< The worker threads, started by lay_optimize() if needed, or NULL. */
+    
+    /* Internal order */
+    int reorder;                    /**< The curve giving the internal order, one of LAY_REORDER_*. */
+    int* order;                     /**< The registered index of each rectangle in internal order, or NULL. */
+    lay_coord_t* order_pos;         /**< Original positions in internal order. */
+    lay_extent_t* order_size;       /**< Sizes in internal order. */
+    lay_extent_t* order_margins;    /**< Margins in internal order. */
+    lay_real_t* order_overlap_weights;  /**< Overlap weights in internal order. */
+    lay_real_t* order_orig_pos_weights; /**< Original position weights in internal order. */
+    int* order_fixed;               /**< Fixed flags in internal order. */
+    lay_rect_arrays registered;         /**< The user's arrays, while the internal copies stand in for them. */
+    int in_place;                   /**< Whether the optimizer may work directly in user memory. */
 
     /* Optimizer arguments */
-    macopt_args opt_args;           /**< Optimizer arguments. */
+    int precision;                  /**< The precision of the optimizer, one of LAY_PRECISION_*. */
+    macopt_args opt_args;           /**< Optimizer arguments, which also hold the settings for double precision. */
+    dmacopt_args dopt_args;         /**< Arguments of the double precision optimizer. */
+    int stop_reason;                /**< Why the last optimization stopped, one of LAY_STOP_*. */
+    
+    /* Instrumentation */
+    lay_stats stats;                /**< Statistics for the last optimization. */
+    double energy;                  /**< The energy at the last evaluation, before rounding to lay_real_t. */
+    int best_saved;                 /**< Whether save_best() has run in this optimization. */
+    lay_real_t best_energy;         /**< The total energy at macopt's best point. */
+    lay_real_t best_overlap_energy; /**< The overlap energy at macopt's best point. */
+    lay_real_t best_orig_pos_energy; /**< The original position energy at macopt's best point. */
+    lay_progress_func progress;     /**< Progress callback, or NULL. */
+    void* progress_context;         /**< User data for the progress callback. */
 };
 
+/** Monotonic clock in nanoseconds, for the statistics. */
+static long long clock_ns() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long) t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
 /** Check whether num_rect-based temps have been allocated. */
 static int has_num_rect_temps(const lay_statep state) {
     return state->dof != NULL;
@@ -78,9 +196,9 @@ static int has_num_rect_temps(const lay_statep state) {
 static void create_num_rect_temps(lay_statep state) {
     assert(state && state->num_rects >= 0);
     
-    assert(!state->dof);
-    if (state->num_rects > 0) {
-        state->dof = malloc(state->num_rects * 2 * sizeof(float));
+    assert(!state->dof && state->temps_capacity >= state->num_rects);
+    if (state->temps_capacity > 0) {
+        state->dof = malloc(state->temps_capacity * 2 * sizeof(lay_coord_t));
     }
     
     /* Sanity check */
@@ -93,6 +211,14 @@ static void ensure_num_rect_temps(lay_statep state) {
         create_num_rect_temps(state);
 }
 
+/** Forget the internal order, which belongs to the registered rectangles. */
+static void release_order(lay_statep state) {
+    free(state->order);
+    free(state->order_index);
+    state->order = NULL;
+    state->order_index = NULL;
+}
+
 /** Free any temporary space that is allocated based on the number of rectangles. */
 static void destroy_num_rect_temps(lay_statep state) {
     assert(state);
@@ -101,32 +227,55 @@ static void destroy_num_rect_temps(lay_statep state) {
         free(state->dof);
         state->dof = NULL;
     }
+    free(state->solver);
+    free(state->solver_grad);
+    state->solver = NULL;
+    state->solver_grad = NULL;
+    if (state->boxes) {
+        free(state->boxes);
+        state->boxes = NULL;
+    }
+    
+    release_order(state);
+    free(state->order_pos);
+    free(state->order_size);
+    free(state->order_margins);
+    free(state->order_overlap_weights);
+    free(state->order_orig_pos_weights);
+    free(state->order_fixed);
+    state->order_pos = NULL;
+    state->order_size = NULL;
+    state->order_margins = NULL;
+    state->order_overlap_weights = NULL;
+    state->order_orig_pos_weights = NULL;
+    state->order_fixed = NULL;
+    state->temps_capacity = 0;
 }
 
-/** Copy user-land positions into a dense array of optimizer floating-point values. */
-static void copy_user_pos_to_array(const lay_statep state, float* array) {
+/** Copy user-land positions into a dense array of optimizer values. */
+static void copy_user_pos_to_array(const lay_statep state, lay_coord_t* array) {
     lay_coord_t* p;
     int i;
     
     assert(array && state && state->pos);
     p = state->pos;
     for (i = 0; i < state->num_rects; ++i) {
-        array[2*i]   = (float)p[0];
-        array[2*i+1] = (float)p[1];
+        array[2*i]   = p[0];
+        array[2*i+1] = p[1];
         p = LAY_NEXT_POS(state, p);
     }
 }
 
-/** Copy a dense array of optimizer floating-point values into user-land positions. */
-static void copy_array_to_user_pos(const float* array, lay_statep state) {
+/** Copy a dense array of optimizer values into user-land positions. */
+static void copy_array_to_user_pos(const lay_coord_t* array, lay_statep state) {
     lay_coord_t* p;
     int i;
     
     assert(array && state && state->pos);
     p = state->pos;
     for (i = 0; i < state->num_rects; ++i) {
-        p[0] = (lay_coord_t)array[2*i];
-        p[1] = (lay_coord_t)array[2*i+1];
+        p[0] = array[2*i];
+        p[1] = array[2*i+1];
         p = LAY_NEXT_POS(state, p);
     }
 }
@@ -159,6 +308,22 @@ static void copy_array_to_user_size(const lay_extent_t* array, lay_statep state)
     }
 }
 
+/** Save the registered per-rectangle arrays. */
+static void save_arrays(const lay_statep state, lay_rect_arrays* a) {
+    a->pos = state->pos;
+    a->pos_skip = state->pos_skip;
+    a->size = state->size;
+    a->size_skip = state->size_skip;
+    a->margins = state->margins;
+    a->margins_skip = state->margins_skip;
+    a->overlap_weights = state->overlap_weights;
+    a->overlap_weights_skip = state->overlap_weights_skip;
+    a->orig_pos_weights = state->orig_pos_weights;
+    a->orig_pos_weights_skip = state->orig_pos_weights_skip;
+    a->fixed = state->fixed;
+    a->fixed_skip = state->fixed_skip;
+}
+
 
 lay_statep lay_create_state() {
     lay_statep state = malloc(sizeof(struct lay_state));
@@ -168,17 +333,55 @@ lay_statep lay_create_state() {
     state->edge_weight = 0;
     state->center_weight = 0;
     state->orig_pos_weight = 0;
+    state->margin = 0;
     
+    state->temps_capacity = 0;
     state->dof = NULL;
+    state->solver = NULL;
+    state->solver_grad = NULL;
+    state->anchor = NULL;
+    state->boxes = NULL;
+    
+    state->broad_phase = LAY_BROAD_PHASE_AUTO;
+    memset(&state->pairs, 0, sizeof(state->pairs));
+    memset(&state->packed, 0, sizeof(state->packed));
+    memset(&state->hgrid, 0, sizeof(state->hgrid));
+    memset(&state->bvh, 0, sizeof(state->bvh));
+    memset(&state->tiled, 0, sizeof(state->tiled));
+    memset(&state->sap, 0, sizeof(state->sap));
+    memset(&state->bitset, 0, sizeof(state->bitset));
+    state->index_stale = 1;
+    state->order_index = NULL;
+    state->num_threads = 1;
+    state->pool = NULL;
+    
+    state->reorder = LAY_REORDER_NONE;
+    state->order = NULL;
+    state->order_pos = NULL;
+    state->order_size = NULL;
+    state->order_margins = NULL;
+    state->order_overlap_weights = NULL;
+    state->order_orig_pos_weights = NULL;
+    state->order_fixed = NULL;
+    state->in_place = 0;
+    state->stop_reason = LAY_STOP_CONVERGED;
+    memset(&state->stats, 0, sizeof(state->stats));
+    state->best_saved = 0;
+    state->progress = NULL;
+    state->progress_context = NULL;
 
     lay_register_rects(state, NULL, 0, NULL, 0, 0);
     
     /* Setup optimizer arguments */
+    state->precision = LAY_REAL_PRECISION;
+    dmacopt_defaults(&state->dopt_args);
     macopt_defaults(&state->opt_args); 
     state->opt_args.itmax = 400;               /* Maximum interations */
     state->opt_args.verbose = 0;               /* Reporting level */
     state->opt_args.tol = 1e-3;                /* Finishing tolerance */
     state->opt_args.end_if_small_step = 1 ;    /* Finish if step gets small, otherwise grad mag gets small */
+    state->opt_args.keep_workspace = 1;        /* Reuse the work vectors in later optimizations */
+    state->dopt_args.keep_workspace = 1;
     
     /* Sanity check */
     assert(lay_verify_state(state));
@@ -200,6 +403,16 @@ void lay_destroy_state(lay_statep state) {
     assert(state);
     
     destroy_num_rect_temps(state);
+    macopt_release(&state->opt_args);
+    dmacopt_release(&state->dopt_args);
+    free(state->pairs.items);
+    lay_packed_pairs_destroy(&state->packed);
+    lay_hgrid_destroy(&state->hgrid);
+    lay_bvh_destroy(&state->bvh);
+    lay_tiled_destroy(&state->tiled);
+    lay_sap_destroy(&state->sap);
+    lay_bitset_destroy(&state->bitset);
+    lay_pool_destroy(state->pool);
     
     free(state);
 }
@@ -216,8 +429,24 @@ void lay_register_rects(lay_statep state,
     state->size_skip = (size_skip != 0 ? size_skip : 2 * sizeof(lay_extent_t));
     state->num_rects = count;
     
-    /* Force reallocation of num_rect-based temps next time they are needed. */
-    destroy_num_rect_temps(state);
+    /* Any margins and weights belonged to the previous rectangles. */
+    state->margins = NULL;
+    state->margins_skip = sizeof(lay_extent_t);
+    lay_register_weights(state, NULL, 0, NULL, 0);
+    lay_register_fixed(state, NULL, 0);
+    
+    /* The cost model learned on the previous rectangles may not fit these. */
+    lay_autotune_init(&state->tune);
+    
+    /* Keep the num_rect-based temps if they are large enough, so that a state
+       reused for many problems stops allocating; otherwise force their 
+       reallocation, at the new size, next time they are needed. */
+    release_order(state);
+    if (count > state->temps_capacity) {
+        destroy_num_rect_temps(state);
+        state->temps_capacity = count;
+    }
+    state->index_stale = 1;
 }
 
 lay_real_t lay_get_overlap_weight(const lay_statep state) {
@@ -260,53 +489,282 @@ void lay_set_orig_pos_weight(lay_statep state, const lay_real_t weight) {
     state->orig_pos_weight = weight;
 }
 
+#if !defined(LAY_USE_INTEGER_COORDS)
+
+/** Fill in the boxes of the rectangles at \c cur_pos for the broad phase.  
+    Each box is grown by half the state's margin plus the rectangle's own 
+    margin, so that two boxes intersect whenever their rectangles are closer 
+    than the gap required between them. */
+static void compute_boxes(const lay_statep state, const lay_coord_t* cur_pos) {
+    const lay_extent_t *size;
+    lay_extent_t grow;
+    lay_coord_t* box;
+    int i;
+    
+    if (!state->boxes) {
+        state->boxes = malloc(sizeof(lay_coord_t) * 4 * state->temps_capacity);
+        assert(state->boxes);
+    }
+    
+    for (i = 0; i < state->num_rects; ++i) {
+        size = LAY_SIZE_POINTER(state, i);
+        grow = (state->margin - state->margin / 2) + (state->margins ? LAY_MARGIN(state, i) : 0);
+        box = state->boxes + 4 * i;
+        box[0] = cur_pos[2*i] - grow;
+        box[1] = cur_pos[2*i+1] - grow;
+        box[2] = cur_pos[2*i] + size[0] + grow;
+        box[3] = cur_pos[2*i+1] + size[1] + grow;
+    }
+}
+
+/** Fill in the dense data of the rectangles at \c cur_pos for the tiled
+    all-pairs kernel. */
+static void compute_tiled(const lay_statep state, const lay_coord_t* cur_pos) {
+    lay_tiled* tiled = &state->tiled;
+    const lay_extent_t* size;
+    lay_extent_t grow;
+    int i;
+    
+    lay_tiled_reserve(tiled, state->num_rects);
+    for (i = 0; i < state->num_rects; ++i) {
+        size = LAY_SIZE_POINTER(state, i);
+        grow = state->margin + 2 * (state->margins ? LAY_MARGIN(state, i) : 0);
+        tiled->center[0][i] = (lay_real_t) (2 * cur_pos[2*i] + size[0]);
+        tiled->center[1][i] = (lay_real_t) (2 * cur_pos[2*i+1] + size[1]);
+        tiled->extent[0][i] = (lay_real_t) (size[0] + grow);
+        tiled->extent[1][i] = (lay_real_t) (size[1] + grow);
+        tiled->weight[i] = (state->overlap_weights 
+                            ? LAY_PER_RECT(lay_real_t, state->overlap_weights, i, 
+                                           state->overlap_weights_skip) / 2
+                            : (lay_real_t) 0.5);
+    }
+}
+
+/** Find the candidate pairs of the state's boxes with \c broad_phase, which 
+    must be one that lists the pairs: the grid, the tree or sweep and prune.
+    The tree's pairs go in the state's pair list, the others packed. */
+static void find_pairs(const lay_statep state, const int broad_phase) {
+    state->pairs.count = 0;
+    lay_packed_pairs_clear(&state->packed, NULL);
+    
+    switch (broad_phase) {
+        case LAY_BROAD_PHASE_HGRID:
+            lay_hgrid_build(&state->hgrid, state->boxes, state->num_rects, state->pool);
+            lay_hgrid_find_pairs(&state->hgrid, state->boxes, &state->packed);
+            break;
+        case LAY_BROAD_PHASE_BVH:
+            /* Only rectangles that left their leaf bounds change the tree. */
+            lay_bvh_update(&state->bvh, state->boxes, state->num_rects);
+            lay_bvh_find_pairs(&state->bvh, state->boxes, &state->pairs);
+            break;
+        case LAY_BROAD_PHASE_SAP:
+            lay_sap_find_pairs(&state->sap, state->boxes, state->num_rects, &state->packed);
+            break;
+        default:
+            assert(0);
+    }
+}
+
+/** Add \c value to a compensated sum. */
+static void energy_sum_add(energy_sum* s, const double value) {
+    const double t = s->sum + value;
+    
+    if (fabs(s->sum) >= fabs(value))
+        s->carry += (s->sum - t) + value;
+    else
+        s->carry += (value - t) + s->sum;
+    s->sum = t;
+}
+
+/** Add the weighted overlap of rectangles \c i and \c j to \c energy and, if 
+    it is not NULL, to \c global_grad.  Return non-zero if they overlap. */
+static int eval_pair(const lay_statep state, const lay_coord_t* cur_pos, 
+                     const int i, const int j, 
+                     double* energy, lay_real_t* global_grad) {
+    lay_extent_t margin;
+    lay_real_t area, weight, local_grad[4];
+    int k;
+    
+    /* Rectangles with the same center are pushed apart by index, so the 
+       gradient must not depend on the order the broad phase found them in. */
+    if (i > j)
+        return eval_pair(state, cur_pos, j, i, energy, global_grad);
+    
+    margin = state->margin;
+    if (state->margins)
+        margin += LAY_MARGIN(state, i) + LAY_MARGIN(state, j);
+    
+    area = lay_overlap_area_margin(cur_pos + 2 * i, LAY_SIZE_POINTER(state, i),
+                                   cur_pos + 2 * j, LAY_SIZE_POINTER(state, j), 
+                                   margin, local_grad);
+    if (area == 0)
+        return 0;
+    
+    if (state->overlap_weights) {
+        /* A pair is weighted by the mean of its rectangles' weights. */
+        weight = (LAY_PER_RECT(lay_real_t, state->overlap_weights, i, state->overlap_weights_skip) +
+                  LAY_PER_RECT(lay_real_t, state->overlap_weights, j, state->overlap_weights_skip)) / 2;
+        area *= weight;
+        for (k = 0; k < 4; ++k)
+            local_grad[k] *= weight;
+    }
+    
+    *energy += area;
+    if (global_grad) {
+        global_grad[2*i  ] += local_grad[0];
+        global_grad[2*i+1] += local_grad[1];
+        global_grad[2*j  ] += local_grad[2];
+        global_grad[2*j+1] += local_grad[3];
+    }
+    return 1;
+}
+
+/** Evaluate every pair of rectangles whose boxes intersect in the state's 
+    built bit matrix, as eval_pair(), adding each row's sum to \c energy.  
+    Return the number that overlap. */
+static long eval_bitset(const lay_statep state, const lay_coord_t* cur_pos, 
+                        energy_sum* energy, lay_real_t* global_grad) {
+    const lay_bitset* bits = &state->bitset;
+    const uint64_t* row;
+    uint64_t word;
+    double row_energy;
+    long overlapping = 0;
+    int i, w;
+    
+    for (i = 0; i < bits->count; ++i) {
+        /* Rows without pairs are skipped whole. */
+        if (bits->degree[i] == 0)
+            continue;
+        row = LAY_BITSET_ROW(bits, i);
+        row_energy = 0;
+        for (w = LAY_BITSET_FIRST_WORD(i); w < bits->row_words; ++w) {
+            for (word = row[w]; word; word &= word - 1)
+                overlapping += eval_pair(state, cur_pos, i, 64 * w + lay_bitset_lowest(word),
+                                         &row_energy, global_grad);
+        }
+        energy_sum_add(energy, row_energy);
+    }
+    return overlapping;
+}
+
+/** Evaluate every pair in the state's packed pairs, as eval_pair(), decoding 
+    the rows as they are read and adding each row's sum to \c energy.  
+    Return the number that overlap. */
+static long eval_packed(const lay_statep state, const lay_coord_t* cur_pos, 
+                        energy_sum* energy, lay_real_t* global_grad) {
+    const lay_packed_pairs* pairs = &state->packed;
+    const unsigned char *data = pairs->data, *end = pairs->data + pairs->size;
+    const int* ids = pairs->ids;
+    unsigned int u;
+    double row_energy;
+    long overlapping = 0;
+    int index = 0, partner, n, i;
+    
+    while (data < end) {
+        u = lay_varint_read(&data);
+        index += LAY_ZIGZAG_DECODE(u);
+        n = (int) lay_varint_read(&data);
+        u = lay_varint_read(&data);
+        partner = index + LAY_ZIGZAG_DECODE(u);
+        i = (ids ? ids[index] : index);
+        row_energy = 0;
+        for (;;) {
+            overlapping += eval_pair(state, cur_pos, i, (ids ? ids[partner] : partner), 
+                                     &row_energy, global_grad);
+            if (--n == 0)
+                break;
+            partner += (int) lay_varint_read(&data);
+        }
+        energy_sum_add(energy, row_energy);
+    }
+    return overlapping;
+}
+
 /** Evaluate the energy and optionally the gradient of the rectangle configuration 
     \c input.  If \c global_grad is not NULL, then it must contain enough space 
     for the number of degrees of freedom per rectangle for *every* rectangle, 
-    including fixed rectangles.
+    including fixed rectangles, whose gradient is zero.
     Note that the positions contained in state are *not* used, rather those 
     stored densely in \c cur_pos.
 */
 static lay_real_t eval(const lay_statep state, 
                        const lay_coord_t* cur_pos, 
                        lay_real_t* global_grad) {
-    const lay_coord_t *p;
-    lay_coord_t *q;
-    lay_extent_t *size1, *size2;
-    lay_real_t layout_energy, dist[4];
-    lay_real_t local_grad[4];
-    int i, j, grad_num_dof;
+    const lay_coord_t *p, *q;
+    lay_real_t layout_energy, weight, dist[4];
+    energy_sum overlap_sum, orig_pos_sum;       /* Sums over many terms are compensated. */
+    double overlap_energy, orig_pos_energy, row_energy;
+    long long candidate_pairs, overlapping_pairs, start_ns, broad_ns, pair_ns;
+    long k;
+    int i, j, grad_num_dof, broad_phase;
     
     assert(lay_verify_state(state));
+    start_ns = clock_ns();
    
     /* The number of degrees of freedom in the passed-in gradient. */
     grad_num_dof = (global_grad != NULL ? 2 * state->num_rects : 0);
     
-    layout_energy = 0;
+    overlap_sum.sum = overlap_sum.carry = 0;
+    overlapping_pairs = 0;
     for (i = 0; i < grad_num_dof; ++i)
         global_grad[i] = 0;
 
-    for (i = 0; i < state->num_rects; ++i) {
-        size1 = LAY_SIZE_POINTER(state, i);
-        
-        for (j = i+1; j < state->num_rects; ++j) {
-            size2 = LAY_SIZE_POINTER(state, j);
-            
-            layout_energy += lay_overlap_area(cur_pos + 2 * i, size1,
-                                              cur_pos + 2 * j, size2, 
-                                              local_grad);
-            if (global_grad) {
-                global_grad[2*i  ] += local_grad[0];
-                global_grad[2*i+1] += local_grad[1];
-                global_grad[2*j  ] += local_grad[2];
-                global_grad[2*j+1] += local_grad[3];
-            }
+    /* The boxes are cheap next to any pair search, and the cost model 
+       samples them. */
+    broad_phase = state->broad_phase;
+    if (broad_phase != LAY_BROAD_PHASE_NONE && broad_phase != LAY_BROAD_PHASE_TILED)
+        compute_boxes(state, cur_pos);
+    if (broad_phase == LAY_BROAD_PHASE_AUTO)
+        broad_phase = lay_autotune_choose(&state->tune, state->boxes, state->num_rects);
+    if (broad_phase == LAY_BROAD_PHASE_BITSET && state->num_rects > LAY_BITSET_MAX_BOXES)
+        broad_phase = LAY_BROAD_PHASE_SAP;     /* The matrix would not fit. */
+
+    if (broad_phase == LAY_BROAD_PHASE_NONE) {
+        broad_ns = start_ns;
+        candidate_pairs = (long long) state->num_rects * (state->num_rects - 1) / 2;
+        for (i = 0; i < state->num_rects; ++i) {
+            row_energy = 0;
+            for (j = i+1; j < state->num_rects; ++j)
+                overlapping_pairs += eval_pair(state, cur_pos, i, j, &row_energy, global_grad);
+            energy_sum_add(&overlap_sum, row_energy);
         }
+    } else if (broad_phase == LAY_BROAD_PHASE_TILED) {
+        compute_tiled(state, cur_pos);
+        broad_ns = clock_ns();
+        candidate_pairs = (long long) state->num_rects * (state->num_rects - 1) / 2;
+        row_energy = 0;
+        overlapping_pairs = lay_tiled_overlap(&state->tiled, &row_energy, global_grad);
+        energy_sum_add(&overlap_sum, row_energy);
+    } else if (broad_phase == LAY_BROAD_PHASE_BITSET) {
+        lay_bitset_build(&state->bitset, state->boxes, state->num_rects);
+        broad_ns = clock_ns();
+        candidate_pairs = lay_bitset_count(&state->bitset);
+        overlapping_pairs = eval_bitset(state, cur_pos, &overlap_sum, global_grad);
+    } else {
+        find_pairs(state, broad_phase);
+        broad_ns = clock_ns();
+        candidate_pairs = state->pairs.count + state->packed.count;
+        for (k = 0; k < state->pairs.count; ++k) {
+            row_energy = 0;
+            overlapping_pairs += eval_pair(state, cur_pos, state->pairs.items[2*k], 
+                                           state->pairs.items[2*k+1], 
+                                           &row_energy, global_grad);
+            energy_sum_add(&overlap_sum, row_energy);
+        }
+        overlapping_pairs += eval_packed(state, cur_pos, &overlap_sum, global_grad);
     }
     
-    layout_energy *= state->overlap_weight;
+    overlap_energy = (overlap_sum.sum + overlap_sum.carry) * state->overlap_weight;
     for (i = 0; i < grad_num_dof; ++i)
         global_grad[i] *= state->overlap_weight;
+    pair_ns = clock_ns();
+    
+    if (state->broad_phase == LAY_BROAD_PHASE_AUTO)
+        lay_autotune_record(&state->tune, broad_phase, state->num_rects,
+                            (long) (broad_phase == LAY_BROAD_PHASE_NONE || 
+                                    broad_phase == LAY_BROAD_PHASE_TILED ? overlapping_pairs 
+                                                                         : candidate_pairs),
+                            pair_ns - start_ns);
         
 #if 0
     /* Add penalty terms to keep rectangles on-screen. */
@@ -354,53 +812,799 @@ static lay_real_t eval(const lay_statep state,
 #endif
     
     /* Add terms to keep rectangles near their original positions. */
+    orig_pos_sum.sum = orig_pos_sum.carry = 0;
     if (state->orig_pos_weight != 0) {
         for (i = 0; i < state->num_rects; ++i) {
+            weight = state->orig_pos_weight;
+            if (state->orig_pos_weights)
+                weight *= LAY_PER_RECT(lay_real_t, state->orig_pos_weights, i, 
+                                       state->orig_pos_weights_skip);
+            
             p = cur_pos + 2 * i;
-            q = LAY_POS_POINTER(state, i);
+            q = (state->anchor ? state->anchor + 2 * i : LAY_POS_POINTER(state, i));
             
             dist[0] = p[0] - q[0];
             dist[1] = p[1] - q[1];
             dist[2] = dist[0] * dist[0] + dist[1] * dist[1];
             
-            layout_energy += state->orig_pos_weight * dist[2];
+            energy_sum_add(&orig_pos_sum, weight * dist[2]);
             
             if (global_grad) {
-                global_grad[2*i  ] += state->orig_pos_weight * 2 * dist[0];
-                global_grad[2*i+1] += state->orig_pos_weight * 2 * dist[1];
+                global_grad[2*i  ] += weight * 2 * dist[0];
+                global_grad[2*i+1] += weight * 2 * dist[1];
             }
         }
     }
+    orig_pos_energy = orig_pos_sum.sum + orig_pos_sum.carry;
+    
+    /* Fixed rectangles are not degrees of freedom, so the optimizer's search
+       directions never move them. */
+    if (global_grad && state->fixed) {
+        for (i = 0; i < state->num_rects; ++i) {
+            if (LAY_PER_RECT(int, state->fixed, i, state->fixed_skip))
+                global_grad[2*i] = global_grad[2*i+1] = 0;
+        }
+    }
+    
+    state->energy = overlap_energy + orig_pos_energy;
+    layout_energy = (lay_real_t) state->energy;
+    
+    /* Record the statistics; the clock is read at most four times per call. */
+    if (global_grad)
+        ++state->stats.evals;
+    state->stats.broad_phase = broad_phase;
+    state->stats.candidate_pairs += candidate_pairs;
+    state->stats.overlapping_pairs += overlapping_pairs;
+    state->stats.overlap_energy = overlap_energy;
+    state->stats.orig_pos_energy = orig_pos_energy;
+    state->stats.energy = layout_energy;
+    state->stats.broad_ns += broad_ns - start_ns;
+    state->stats.pair_ns += pair_ns - broad_ns;
+    state->stats.penalty_ns += clock_ns() - pair_ns;
     
     return layout_energy;
 }
 
-static float energy(lay_coord_t* x, void* args) {
+static lay_real_t energy(lay_coord_t* x, void* args) {
     return eval((lay_statep) args, x + 1, NULL);    /* Convert one-based array */
 }
 
-static void vgrad_energy(lay_coord_t* x, lay_coord_t* grad, void* args) {
+/** Convert the \c n positions of the optimizer at \c x, in the other 
+    precision, into the state's dof for eval().  Fixed rectangles keep their
+    positions in the dof, which the conversion could round. */
+static void solver_to_dof(lay_statep state, const other_real_t* x, const int n) {
+    int i;
+    
+    for (i = 0; i < n; ++i) {
+        if (!state->fixed || !LAY_PER_RECT(int, state->fixed, i / 2, state->fixed_skip))
+            state->dof[i] = (lay_coord_t) x[i];
+    }
+}
+
+/** Evaluate the gradient at \c x, in the other precision, by way of the 
+    state's dof, whose gradient is converted into \c grad. */
+static void other_vgrad_energy(const other_real_t* x, other_real_t* grad, void* args) {
+    lay_statep state = (lay_statep) args;
+    const int n = 2 * state->num_rects;
+    int i;
+    
+    solver_to_dof(state, x, n);
+    eval(state, state->dof, state->solver_grad);
+    for (i = 0; i < n; ++i)
+        grad[i] = (other_real_t) state->solver_grad[i];
+}
+
+/** The gradient for float macopt. */
+static void vgrad_energy(float* x, float* grad, void* args) {
+#if defined(LAY_REAL_IS_FLOAT)
+    eval((lay_statep) args, x + 1, grad + 1);       /* Convert one-based array */
+#else
+    other_vgrad_energy(x + 1, grad + 1, args);
+#endif
+}
+
+/** The gradient for double macopt. */
+static void dvgrad_energy(double* x, double* grad, void* args) {
+#if defined(LAY_REAL_IS_DOUBLE)
     eval((lay_statep) args, x + 1, grad + 1);       /* Convert one-based array */
+#else
+    other_vgrad_energy(x + 1, grad + 1, args);
+#endif
+}
+
+/** The energy at the point of the last gradient evaluation, which eval() 
+    computed along with the gradient, so that macopt can track its best 
+    point without evaluating the energy again. */
+static float last_energy(void* args) {
+    return (float) ((lay_statep) args)->energy;
+}
+
+/** As last_energy(), for double macopt. */
+static double dlast_energy(void* args) {
+    return ((lay_statep) args)->energy;
+}
+
+/** Keep the energy components of the last evaluation, which macopt has just
+    made its best point, so that the statistics can report those of the 
+    point it returns. */
+static void save_best(void* args) {
+    lay_statep state = (lay_statep) args;
+    state->best_saved = 1;
+    state->best_energy = state->stats.energy;
+    state->best_overlap_energy = state->stats.overlap_energy;
+    state->best_orig_pos_energy = state->stats.orig_pos_energy;
+}
+
+/** Forward macopt's progress report, which passes the zero-based dof array, 
+    to the user's callback.  The energy components in the statistics are those
+    of the current point, since macopt evaluates the gradient there just 
+    before, so macopt's objective \c f is already in them. */
+static int progress(const float* x, int n, int iteration, float f, void* args) {
+    lay_statep state = (lay_statep) args;
+    (void) f;
+#if defined(LAY_REAL_IS_FLOAT)
+    return state->progress(x, n / 2, iteration, &state->stats, 
+                           state->progress_context);
+#else
+    solver_to_dof(state, x, n);
+    return state->progress(state->dof, n / 2, iteration, &state->stats, 
+                           state->progress_context);
+#endif
+}
+
+/** As progress(), for double macopt. */
+static int dprogress(const double* x, int n, int iteration, double f, void* args) {
+    lay_statep state = (lay_statep) args;
+    (void) f;
+#if defined(LAY_REAL_IS_DOUBLE)
+    return state->progress(x, n / 2, iteration, &state->stats, 
+                           state->progress_context);
+#else
+    solver_to_dof(state, x, n);
+    return state->progress(state->dof, n / 2, iteration, &state->stats, 
+                           state->progress_context);
+#endif
+}
+
+/** Copy the settings of the float optimizer arguments, which hold them for 
+    both precisions, into the double ones. */
+static void copy_opt_settings(const macopt_args* a, dmacopt_args* d) {
+    COPY_OPT_SETTINGS(d, a);
+    d->valuefunc = (a->valuefunc ? dlast_energy : NULL);
+    d->valuefuncarg = a->valuefuncarg;
+    d->bestfunc = a->bestfunc;
+    d->progressfunc = (a->progressfunc ? dprogress : NULL);
+    d->progressfuncarg = a->progressfuncarg;
+}
+
+/** Copy the results of a double optimization, and the settings it adapts,
+    back into the float optimizer arguments. */
+static void copy_opt_results(const dmacopt_args* d, macopt_args* a) {
+    a->its = d->its;
+    a->evals = d->evals;
+    a->restarts = d->restarts;
+    a->eval_ns = d->eval_ns;
+    a->total_ns = d->total_ns;
+    a->stop_reason = d->stop_reason;
+    a->rich = d->rich;
+    a->lastx = (float) d->lastx;
+}
+
+/** Minimize the energy from the dense positions at \c x, leaving the result
+    there, with macopt in the state's precision.  If that is not the 
+    precision of lay_real_t, \c x must be the state's dof: macopt then works 
+    on its own copy in its precision, and eval() on the dof. */
+static void run_optimizer(lay_statep state, lay_coord_t* x) {
+    const int n = 2 * state->num_rects;
+    other_real_t* y;
+    int i;
+    
+    if (state->precision == LAY_REAL_PRECISION) {
+#if defined(LAY_REAL_IS_FLOAT)
+        macoptII(x - 1, n, vgrad_energy, state, &state->opt_args);
+#else
+        copy_opt_settings(&state->opt_args, &state->dopt_args);
+        dmacoptII(x - 1, n, dvgrad_energy, state, &state->dopt_args);
+        copy_opt_results(&state->dopt_args, &state->opt_args);
+#endif
+        return;
+    }
+    
+    assert(x == state->dof);
+    if (!state->solver) {
+        state->solver = malloc(sizeof(other_real_t) * 2 * state->temps_capacity);
+        state->solver_grad = malloc(sizeof(lay_real_t) * 2 * state->temps_capacity);
+        assert(state->solver && state->solver_grad);
+    }
+    y = state->solver;
+    for (i = 0; i < n; ++i)
+        y[i] = (other_real_t) x[i];
+#if defined(LAY_REAL_IS_FLOAT)
+    copy_opt_settings(&state->opt_args, &state->dopt_args);
+    dmacoptII(y - 1, n, dvgrad_energy, state, &state->dopt_args);
+    copy_opt_results(&state->dopt_args, &state->opt_args);
+#else
+    macoptII(y - 1, n, vgrad_energy, state, &state->opt_args);
+#endif
+    solver_to_dof(state, y, n);
+}
+
+/** Whether the optimizer can work directly in the user's position array, 
+    which must be tightly packed and in the optimizer's precision. */
+static int can_optimize_in_place(const lay_statep state) {
+    return state->in_place && state->precision == LAY_REAL_PRECISION &&
+           state->pos_skip == (ptrdiff_t) (2 * sizeof(lay_coord_t));
+}
+
+/** Make \c a the per-rectangle arrays read by eval(). */
+static void restore_arrays(lay_statep state, const lay_rect_arrays* a) {
+    state->pos = a->pos;
+    state->pos_skip = a->pos_skip;
+    state->size = a->size;
+    state->size_skip = a->size_skip;
+    state->margins = a->margins;
+    state->margins_skip = a->margins_skip;
+    state->overlap_weights = a->overlap_weights;
+    state->overlap_weights_skip = a->overlap_weights_skip;
+    state->orig_pos_weights = a->orig_pos_weights;
+    state->orig_pos_weights_skip = a->orig_pos_weights_skip;
+    state->fixed = a->fixed;
+    state->fixed_skip = a->fixed_skip;
+}
+
+/** Whether lay_optimize() works on the rectangles in curve order. */
+static int can_reorder(const lay_statep state) {
+    /* The progress callback promises the optimizer's positions in the 
+       registered order, without a copy. */
+    return state->reorder != LAY_REORDER_NONE && !state->progress && state->num_rects > 1;
+}
+
+/** Sort the rectangles along the state's curve and copy their positions 
+    into \c x, and their other data into dense arrays that eval() reads in 
+    place of the registered ones until end_reorder(). */
+static void begin_reorder(lay_statep state, lay_coord_t* x) {
+    const int n = state->num_rects;
+    lay_rect_arrays internal;
+    int *order, *old_index, *inverse, k, u;
+    
+    order = malloc(sizeof(int) * n);
+    assert(order);
+    lay_curve_order(state->pos, state->pos_skip, state->size, state->size_skip, 
+                    n, state->reorder, order);
+    
+    /* Keep the tree, renumbering its boxes from the old internal order. */
+    if (state->bvh.num_boxes == n) {
+        old_index = malloc(sizeof(int) * n);
+        assert(old_index);
+        if (state->order) {
+            inverse = malloc(sizeof(int) * n);
+            assert(inverse);
+            for (k = 0; k < n; ++k)
+                inverse[state->order[k]] = k;
+            for (k = 0; k < n; ++k)
+                old_index[k] = inverse[order[k]];
+            free(inverse);
+        } else {
+            for (k = 0; k < n; ++k)
+                old_index[k] = order[k];
+        }
+        lay_bvh_relabel(&state->bvh, old_index);
+        free(old_index);
+    }
+    free(state->order);
+    state->order = order;
+    
+    if (!state->order_size) {
+        state->order_pos = malloc(sizeof(lay_coord_t) * 2 * state->temps_capacity);
+        state->order_size = malloc(sizeof(lay_extent_t) * 2 * state->temps_capacity);
+        assert(state->order_pos && state->order_size);
+    }
+    if (state->margins && !state->order_margins)
+        state->order_margins = malloc(sizeof(lay_extent_t) * state->temps_capacity);
+    if (state->overlap_weights && !state->order_overlap_weights)
+        state->order_overlap_weights = malloc(sizeof(lay_real_t) * state->temps_capacity);
+    if (state->orig_pos_weights && !state->order_orig_pos_weights)
+        state->order_orig_pos_weights = malloc(sizeof(lay_real_t) * state->temps_capacity);
+    if (state->fixed && !state->order_fixed)
+        state->order_fixed = malloc(sizeof(int) * state->temps_capacity);
+    
+    for (k = 0; k < n; ++k) {
+        u = order[k];
+        x[2*k]   = state->order_pos[2*k]   = LAY_POS_POINTER(state, u)[0];
+        x[2*k+1] = state->order_pos[2*k+1] = LAY_POS_POINTER(state, u)[1];
+        state->order_size[2*k]   = LAY_SIZE_POINTER(state, u)[0];
+        state->order_size[2*k+1] = LAY_SIZE_POINTER(state, u)[1];
+        if (state->margins)
+            state->order_margins[k] = LAY_MARGIN(state, u);
+        if (state->overlap_weights)
+            state->order_overlap_weights[k] = 
+                LAY_PER_RECT(lay_real_t, state->overlap_weights, u, state->overlap_weights_skip);
+        if (state->orig_pos_weights)
+            state->order_orig_pos_weights[k] = 
+                LAY_PER_RECT(lay_real_t, state->orig_pos_weights, u, state->orig_pos_weights_skip);
+        if (state->fixed)
+            state->order_fixed[k] = LAY_PER_RECT(int, state->fixed, u, state->fixed_skip);
+    }
+    
+    save_arrays(state, &state->registered);
+    internal.pos = state->order_pos;
+    internal.pos_skip = 2 * sizeof(lay_coord_t);
+    internal.size = state->order_size;
+    internal.size_skip = 2 * sizeof(lay_extent_t);
+    internal.margins = (state->margins ? state->order_margins : NULL);
+    internal.margins_skip = sizeof(lay_extent_t);
+    internal.overlap_weights = (state->overlap_weights ? state->order_overlap_weights : NULL);
+    internal.overlap_weights_skip = sizeof(lay_real_t);
+    internal.orig_pos_weights = (state->orig_pos_weights ? state->order_orig_pos_weights : NULL);
+    internal.orig_pos_weights_skip = sizeof(lay_real_t);
+    internal.fixed = (state->fixed ? state->order_fixed : NULL);
+    internal.fixed_skip = sizeof(int);
+    restore_arrays(state, &internal);
+}
+
+/** Copy the optimized positions in \c x back to the registered positions 
+    and make eval() read the registered arrays again. */
+static void end_reorder(lay_statep state, const lay_coord_t* x) {
+    lay_coord_t* p;
+    int k;
+    
+    restore_arrays(state, &state->registered);
+    for (k = 0; k < state->num_rects; ++k) {
+        p = LAY_POS_POINTER(state, state->order[k]);
+        p[0] = x[2*k];
+        p[1] = x[2*k+1];
+    }
+}
+
+/** Convert a macopt stop reason into one of LAY_STOP_*. */
+static int stop_reason(const int macopt_reason) {
+    switch (macopt_reason) {
+        case MACOPT_STOP_SMALL_GRAD:
+        case MACOPT_STOP_SMALL_STEP:    return LAY_STOP_CONVERGED;
+        case MACOPT_STOP_EVALS:         return LAY_STOP_EVALS;
+        case MACOPT_STOP_TIME:          return LAY_STOP_TIME;
+        case MACOPT_STOP_PROGRESS:      return LAY_STOP_PROGRESS;
+        default:                        return LAY_STOP_ITERATIONS;
+    }
+}
+
+#else
+
+/** Legalize the registered rectangles, keeping the gaps their margins 
+    require.  Each rectangle is grown as its box is for the broad phase, by 
+    half the state's margin, rounded up, plus its own margin, so that two 
+    grown rectangles are apart exactly when the gap between the rectangles 
+    is at least the sum of the margins. */
+static void legalize(lay_statep state) {
+    const int n = state->num_rects;
+    lay_coord_t *pos, *p;
+    lay_extent_t *size, *s, grow;
+    int i;
+    
+    if (state->margin == 0 && !state->margins) {
+        lay_legalize_fixed(state->pos, state->pos_skip, state->size, state->size_skip, 
+                           state->fixed, state->fixed_skip, n);
+        return;
+    }
+    
+    pos = malloc(sizeof(lay_coord_t) * 2 * n);
+    size = malloc(sizeof(lay_extent_t) * 2 * n);
+    assert((pos && size) || n == 0);
+    for (i = 0; i < n; ++i) {
+        p = LAY_POS_POINTER(state, i);
+        s = LAY_SIZE_POINTER(state, i);
+        grow = (state->margin - state->margin / 2) + (state->margins ? LAY_MARGIN(state, i) : 0);
+        pos[2*i]    = p[0] - grow;
+        pos[2*i+1]  = p[1] - grow;
+        size[2*i]   = s[0] + 2 * grow;
+        size[2*i+1] = s[1] + 2 * grow;
+    }
+    
+    lay_legalize_fixed(pos, 0, size, 0, state->fixed, state->fixed_skip, n);
+    
+    for (i = 0; i < n; ++i) {
+        p = LAY_POS_POINTER(state, i);
+        grow = (state->margin - state->margin / 2) + (state->margins ? LAY_MARGIN(state, i) : 0);
+        p[0] = pos[2*i] + grow;
+        p[1] = pos[2*i+1] + grow;
+    }
+    free(pos);
+    free(size);
 }
 
+#endif
+
 void lay_optimize(lay_statep state) {
+#if !defined(LAY_USE_INTEGER_COORDS)
+    long long start_ns, copy_ns;
+    int set_func = 0, reordered = 0;
+    lay_coord_t* x;
+#endif
+    
     assert(lay_verify_state(state));
 
-    ensure_num_rect_temps(state);
+#if defined(LAY_USE_INTEGER_COORDS)
+    /* Integer coordinates are pixel positions, and rounding the result of a 
+       float solve would reintroduce overlaps of up to a pixel.  Remove the 
+       overlaps exactly with integer legalization instead; no float conversion 
+       takes place and the penalty weights are not used. */
+    legalize(state);
+    state->stop_reason = LAY_STOP_CONVERGED;
+#else
+    memset(&state->stats, 0, sizeof(state->stats));
+    lay_autotune_reset(&state->tune);
+    if (state->num_threads != 1 && !state->pool)
+        state->pool = lay_pool_create(state->num_threads);
+    start_ns = clock_ns();
     
-    /* Copy the original positions into the minimizer's current state vector. */
-    copy_user_pos_to_array(state, state->dof);
+    if (can_optimize_in_place(state)) {
+        /* The user's positions are the minimizer's state vector.  The original 
+           positions are only needed again as an anchor for their penalty term. */
+        x = state->pos;
+        if (state->orig_pos_weight != 0) {
+            ensure_num_rect_temps(state);
+            copy_user_pos_to_array(state, state->dof);
+            state->anchor = state->dof;
+        }
+    } else if (can_reorder(state)) {
+        ensure_num_rect_temps(state);
+        x = state->dof;
+        reordered = 1;
+        begin_reorder(state, x);
+    } else {
+        ensure_num_rect_temps(state);
+        x = state->dof;
+        
+        /* Copy the original positions into the minimizer's current state vector. */
+        copy_user_pos_to_array(state, x);
+    }
+    if (!reordered && state->order) {
+        /* The registered order is the internal order again. */
+        release_order(state);
+    }
+    copy_ns = clock_ns();
+    state->stats.copy_ns = copy_ns - start_ns;
     
     /* Check that the gradient_function is the gradient of the function. 
        Note the adjustment for the moronic one-based arrays Numerical Recipes requires.
     */
 #if 0
-    maccheckgrad(state->dof - 1, 2 * state->num_rects, 1e-3, energy, state, vgrad_energy, state, 0);
+    maccheckgrad(x - 1, 2 * state->num_rects, 1e-3, energy, state, vgrad_energy, state, 0);
 #endif
     
-    macoptII(state->dof - 1, 2 * state->num_rects, vgrad_energy, state, &state->opt_args);
+    /* Report progress, with the energy as macopt's objective so that it is
+       passed to the callback. */
+    if (state->progress) {
+        state->opt_args.progressfunc = progress;
+        state->opt_args.progressfuncarg = state;
+        set_func = (state->opt_args.valuefunc == NULL);
+        if (set_func) {
+            state->opt_args.valuefunc = last_energy;
+            state->opt_args.valuefuncarg = state;
+        }
+    }
+    
+    /* macopt returns its best point when it tracks the energy, and with it 
+       the energy components saved there, rather than the last evaluation's. */
+    state->best_saved = 0;
+    state->opt_args.bestfunc = (state->opt_args.valuefunc ? save_best : NULL);
+    run_optimizer(state, x);
+    state->opt_args.bestfunc = NULL;
+    if (state->best_saved) {
+        state->stats.energy = state->best_energy;
+        state->stats.overlap_energy = state->best_overlap_energy;
+        state->stats.orig_pos_energy = state->best_orig_pos_energy;
+    }
+    
+    if (state->progress) {
+        state->opt_args.progressfunc = NULL;
+        state->opt_args.progressfuncarg = NULL;
+        if (set_func) {
+            state->opt_args.valuefunc = NULL;
+            state->opt_args.valuefuncarg = NULL;
+        }
+    }
+    state->stop_reason = stop_reason(state->opt_args.stop_reason);
+    state->stats.evals = state->opt_args.evals;
+    state->stats.iterations = state->opt_args.its;
+    state->stats.restarts = state->opt_args.restarts;
+    
+    start_ns = clock_ns();
+    state->stats.optimizer_ns = start_ns - copy_ns - state->stats.broad_ns
+                              - state->stats.pair_ns - state->stats.penalty_ns;
+    
+    if (reordered)
+        end_reorder(state, x);
+    else if (x == state->dof)
+        copy_array_to_user_pos(x, state);
+    state->anchor = NULL;
+    state->stats.copy_ns += clock_ns() - start_ns;
+#endif
     
-    copy_array_to_user_pos(state->dof, state);
+    /* The tree holds the positions of the last evaluation, if any. */
+    state->index_stale = 1;
 }
 
+void lay_optimize_budget(lay_statep state, const long long max_ns, 
+                         const long max_gradient_evals) {
+    assert(lay_verify_state(state) && max_ns >= 0 && max_gradient_evals >= 0);
+
+#if !defined(LAY_USE_INTEGER_COORDS)
+    /* The energy lets macopt keep the best point evaluated, since a run cut
+       short can stop in the middle of an uphill excursion. */
+    state->opt_args.max_ns = max_ns;
+    state->opt_args.max_evals = max_gradient_evals;
+    state->opt_args.valuefunc = last_energy;
+    state->opt_args.valuefuncarg = state;
+#endif
+    
+    lay_optimize(state);
+    
+#if !defined(LAY_USE_INTEGER_COORDS)
+    state->opt_args.max_ns = 0;
+    state->opt_args.max_evals = 0;
+    state->opt_args.valuefunc = NULL;
+    state->opt_args.valuefuncarg = NULL;
+#endif
+}
+
+int lay_get_stop_reason(const lay_statep state) {
+    assert(state);
+    return state->stop_reason;
+}
 
+void lay_get_stats(const lay_statep state, lay_stats* stats) {
+    assert(state && stats);
+    *stats = state->stats;
+}
+
+lay_extent_t lay_get_margin(const lay_statep state) {
+    assert(state);
+    return state->margin;
+}
+
+void lay_set_margin(lay_statep state, const lay_extent_t margin) {
+    assert(state && margin >= 0);
+    state->margin = margin;
+}
+
+void lay_register_margins(lay_statep state, 
+                          const lay_extent_t* margins, const ptrdiff_t skip) {
+    assert(state);
+    state->margins = margins;
+    state->margins_skip = (skip != 0 ? skip : (ptrdiff_t) sizeof(lay_extent_t));
+}
+
+void lay_register_weights(lay_statep state, 
+                          const lay_real_t* overlap_weights, const ptrdiff_t overlap_skip,
+                          const lay_real_t* orig_pos_weights, const ptrdiff_t orig_pos_skip) {
+    assert(state);
+    state->overlap_weights = overlap_weights;
+    state->overlap_weights_skip = (overlap_skip != 0 ? overlap_skip : (ptrdiff_t) sizeof(lay_real_t));
+    state->orig_pos_weights = orig_pos_weights;
+    state->orig_pos_weights_skip = (orig_pos_skip != 0 ? orig_pos_skip : (ptrdiff_t) sizeof(lay_real_t));
+}
+
+void lay_register_fixed(lay_statep state, const int* fixed, const ptrdiff_t skip) {
+    assert(state);
+    state->fixed = fixed;
+    state->fixed_skip = (skip != 0 ? skip : (ptrdiff_t) sizeof(int));
+}
+
+int lay_get_broad_phase(const lay_statep state) {
+    assert(state);
+    return state->broad_phase;
+}
+
+void lay_set_broad_phase(lay_statep state, const int broad_phase) {
+    assert(state && broad_phase >= LAY_BROAD_PHASE_AUTO && broad_phase <= LAY_BROAD_PHASE_BITSET);
+    state->broad_phase = broad_phase;
+}
+
+int lay_get_reorder(const lay_statep state) {
+    assert(state);
+    return state->reorder;
+}
+
+void lay_set_reorder(lay_statep state, const int reorder) {
+    assert(state && reorder >= LAY_REORDER_NONE && reorder <= LAY_REORDER_HILBERT);
+    state->reorder = reorder;
+}
+
+void lay_set_optimize_in_place(lay_statep state, const int in_place) {
+    assert(state);
+    state->in_place = in_place;
+}
+
+int lay_get_optimize_in_place(const lay_statep state) {
+    assert(state);
+    return state->in_place;
+}
+
+void lay_set_precision(lay_statep state, const int precision) {
+    assert(state && 
+           (precision == LAY_PRECISION_FLOAT || precision == LAY_PRECISION_DOUBLE));
+    state->precision = precision;
+}
+
+int lay_get_precision(const lay_statep state) {
+    assert(state);
+    return state->precision;
+}
+
+int lay_get_num_threads(const lay_statep state) {
+    assert(state);
+    return state->num_threads;
+}
+
+void lay_set_num_threads(lay_statep state, const int num_threads) {
+    assert(state);
+    if (num_threads != state->num_threads) {
+        /* The threads are started again, in the new number, when needed. */
+        lay_pool_destroy(state->pool);
+        state->pool = NULL;
+        state->num_threads = num_threads;
+    }
+}
+
+void lay_set_progress_func(lay_statep state, lay_progress_func func, void* context) {
+    assert(state);
+    state->progress = func;
+    state->progress_context = context;
+}
+
+int lay_state_get_arrays(const lay_statep state, lay_rect_arrays* arrays) {
+    assert(state && arrays);
+    save_arrays(state, arrays);
+    return state->num_rects;
+}
+
+macopt_args* lay_state_opt_args(lay_statep state) {
+    assert(state);
+    return &state->opt_args;
+}
+
+#if !defined(LAY_USE_INTEGER_COORDS)
+lay_real_t lay_state_eval(lay_statep state, const lay_coord_t* cur_pos, 
+                          lay_real_t* grad) {
+    assert(lay_verify_state(state) && cur_pos);
+    
+    /* The registered order is the order of cur_pos and grad. */
+    release_order(state);
+    ensure_num_rect_temps(state);
+    if (state->num_threads != 1 && !state->pool)
+        state->pool = lay_pool_create(state->num_threads);
+    return eval(state, cur_pos, grad);
+}
+#endif
+
+void lay_copy_settings(lay_statep to, const lay_statep from) {
+    assert(to && from);
+    to->overlap_weight = from->overlap_weight;
+    to->edge_weight = from->edge_weight;
+    to->center_weight = from->center_weight;
+    to->orig_pos_weight = from->orig_pos_weight;
+    to->margin = from->margin;
+    to->broad_phase = from->broad_phase;
+    to->reorder = from->reorder;
+    to->precision = from->precision;
+    lay_set_num_threads(to, from->num_threads);
+    COPY_OPT_SETTINGS(&to->opt_args, &from->opt_args);
+}
+
+/** Fill in the box of registered rectangle \c u for the tree at \c box, 
+    grown as by compute_boxes() so that the broad phase can share the tree. */
+static void index_box(const lay_statep state, const int u, lay_coord_t* box) {
+    const lay_coord_t* pos = LAY_POS_POINTER(state, u);
+    const lay_extent_t* size = LAY_SIZE_POINTER(state, u);
+    const lay_extent_t grow = (state->margin - state->margin / 2) 
+                            + (state->margins ? LAY_MARGIN(state, u) : 0);
+    
+    box[0] = pos[0] - grow;
+    box[1] = pos[1] - grow;
+    box[2] = pos[0] + size[0] + grow;
+    box[3] = pos[1] + size[1] + grow;
+}
+
+/** Bring the tree up to date with the registered positions.  Only the boxes 
+    that have left their grown bounds since the tree was last used are 
+    reinserted, so this is cheap after a few evaluations' worth of motion. */
+static void update_index(lay_statep state) {
+    const int n = state->num_rects;
+    int k;
+    
+    if (!state->index_stale)
+        return;
+    
+    if (!state->boxes) {
+        state->boxes = malloc(sizeof(lay_coord_t) * 4 * state->temps_capacity);
+        assert(state->boxes || state->temps_capacity == 0);
+    }
+    if (state->order && !state->order_index) {
+        state->order_index = malloc(sizeof(int) * n);
+        assert(state->order_index);
+    }
+    
+    /* The tree is in internal order, which the broad phase also uses. */
+    for (k = 0; k < n; ++k) {
+        const int u = (state->order ? state->order[k] : k);
+        index_box(state, u, state->boxes + 4 * k);
+        if (state->order)
+            state->order_index[u] = k;
+    }
+    lay_bvh_update(&state->bvh, state->boxes, n);
+    state->index_stale = 0;
+}
+
+/** The results of a region query, filled in by query_visit(). */
+typedef struct {
+    lay_statep state;           /**< The state being queried. */
+    lay_coord_t region[4];      /**< The region, as <tt>x0, y0, x1, y1</tt>. */
+    int* out;                   /**< Where to store the indices found. */
+    int max;                    /**< The number of indices \c out can hold. */
+    int found;                  /**< The number of rectangles found so far. */
+} query_results;
+
+/** Record the rectangle at internal index \c index if it meets the region. */
+static void query_visit(void* context, const int index) {
+    query_results* results = (query_results*) context;
+    const lay_statep state = results->state;
+    const int u = (state->order ? state->order[index] : index);
+    const lay_coord_t* pos = LAY_POS_POINTER(state, u);
+    const lay_extent_t* size = LAY_SIZE_POINTER(state, u);
+    
+    /* The tree's bounds are grown, so check the rectangle itself. */
+    if (pos[0] > results->region[2] || results->region[0] > pos[0] + size[0] ||
+        pos[1] > results->region[3] || results->region[1] > pos[1] + size[1])
+        return;
+    
+    if (results->found < results->max)
+        results->out[results->found] = u;
+    ++results->found;
+}
+
+int lay_query_region(lay_statep state, 
+                     const lay_coord_t x0, const lay_coord_t y0, 
+                     const lay_coord_t x1, const lay_coord_t y1,
+                     int* out, const int max) {
+    query_results results;
+    
+    assert(lay_verify_state(state));
+    assert(x0 <= x1 && y0 <= y1);
+    assert(max >= 0 && (out || max == 0));
+    
+    update_index(state);
+    
+    results.state = state;
+    results.region[0] = x0;
+    results.region[1] = y0;
+    results.region[2] = x1;
+    results.region[3] = y1;
+    results.out = out;
+    results.max = max;
+    results.found = 0;
+    lay_bvh_query(&state->bvh, results.region, query_visit, &results);
+    return results.found;
+}
+
+int lay_query_point(lay_statep state, const lay_coord_t x, const lay_coord_t y,
+                    int* out, const int max) {
+    return lay_query_region(state, x, y, x, y, out, max);
+}
+
+void lay_rects_moved(lay_statep state, const int index) {
+    lay_coord_t* box;
+    int k;
+    
+    assert(state && index < state->num_rects);
+    
+    if (index < 0) {
+        state->index_stale = 1;
+    } else if (!state->index_stale) {
+        /* Only this rectangle's leaf can need reinserting. */
+        k = (state->order ? state->order_index[index] : index);
+        box = state->boxes + 4 * k;
+        index_box(state, index, box);
+        lay_bvh_move(&state->bvh, k, box);
+    }
+}
@@ -0,0 +1,392 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+/** \file src/legalize.c
+* Removal of residual overlaps by constraint-graph compaction.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <layout/legalize.h>
+#include "strided.h"
+#include "broadphase.h"
+
+/** A pair of rectangles.  As a separation constraint, \c first must end up 
+    entirely before \c second along the constrained axis. 
+*/
+typedef struct {
+    int first;      /**< The index of the first rectangle. */
+    int second;     /**< The index of the second rectangle. */
+} rect_pair;
+
+/** A growable list of rectangle pairs. */
+typedef struct {
+    int count;          /**< The number of pairs in the list. */
+    int capacity;       /**< The number of pairs allocated. */
+    rect_pair* items;   /**< The pairs. */
+} pair_list;
+
+/** A sort key for a rectangle. */
+typedef struct {
+    lay_coord_t key;    /**< The sort key. */
+    int index;          /**< The index of the rectangle. */
+} sort_entry;
+
+static int compare_sort_entries(const void* a, const void* b) {
+    const sort_entry* e1 = (const sort_entry*) a;
+    const sort_entry* e2 = (const sort_entry*) b;
+    
+    if (e1->key != e2->key)
+        return (e1->key < e2->key ? -1 : 1);
+    return e1->index - e2->index;
+}
+
+/** The storage for finding overlapping pairs, kept between searches. */
+typedef struct {
+    lay_coord_t* boxes;         /**< The rectangles as boxes, four coordinates each. */
+    lay_hgrid grid;             /**< The hierarchical grid over the boxes. */
+    lay_packed_pairs packed;    /**< The candidate pairs from the grid. */
+} overlap_search;
+
+static void pair_list_add(pair_list* l, const int first, const int second) {
+    assert(l);
+    if (l->count == l->capacity) {
+        l->capacity = (l->capacity > 0 ? 2 * l->capacity : 64);
+        l->items = realloc(l->items, sizeof(rect_pair) * l->capacity);
+        assert(l->items);
+    }
+    l->items[l->count].first = first;
+    l->items[l->count].second = second;
+    ++l->count;
+}
+
+/** The penetration depth of two rectangles along one axis.  Positive if and 
+    only if their intervals along that axis intersect. 
+*/
+static lay_coord_t penetration(const lay_coord_t* pos, const lay_extent_t* size,
+                               const int i, const int j, const int axis) {
+    const lay_coord_t end_i = pos[2*i+axis] + size[2*i+axis];
+    const lay_coord_t end_j = pos[2*j+axis] + size[2*j+axis];
+    const lay_coord_t lo = (pos[2*i+axis] > pos[2*j+axis] ? pos[2*i+axis] : pos[2*j+axis]);
+    const lay_coord_t hi = (end_i < end_j ? end_i : end_j);
+    return hi - lo;
+}
+
+/** Find all pairs of rectangles that overlap with positive area.  The 
+    candidates come from a hierarchical grid, which enters each rectangle 
+    once, in a level whose cells are at least as large as it is, so that the
+    search takes time linear in the number of rectangles and candidate pairs
+    however widely their sizes vary.
+*/
+static void find_overlaps(const lay_coord_t* pos, const lay_extent_t* size, 
+                          const int count, overlap_search* search, pair_list* pairs) {
+    const unsigned char *data, *end;
+    lay_coord_t* boxes = search->boxes;
+    int i, index = 0, partner, n;
+    unsigned int u;
+    
+    for (i = 0; i < count; ++i) {
+        boxes[4*i]   = pos[2*i];
+        boxes[4*i+1] = pos[2*i+1];
+        boxes[4*i+2] = pos[2*i] + size[2*i];
+        boxes[4*i+3] = pos[2*i+1] + size[2*i+1];
+    }
+    lay_hgrid_build(&search->grid, boxes, count, NULL);
+    lay_packed_pairs_clear(&search->packed, NULL);
+    lay_hgrid_find_pairs(&search->grid, boxes, &search->packed);
+    
+    /* The boxes intersect exactly when both penetration depths are positive. */
+    pairs->count = 0;
+    data = search->packed.data;
+    end = search->packed.data + search->packed.size;
+    while (data < end) {
+        u = lay_varint_read(&data);
+        index += LAY_ZIGZAG_DECODE(u);
+        n = (int) lay_varint_read(&data);
+        u = lay_varint_read(&data);
+        partner = index + LAY_ZIGZAG_DECODE(u);
+        for (;;) {
+            if (LAY_BOXES_INTERSECT(boxes, index, partner))
+                pair_list_add(pairs, index, partner);
+            if (--n == 0)
+                break;
+            partner += (int) lay_varint_read(&data);
+        }
+    }
+}
+
+/** Sort the rectangles by their centers along \c axis, filling in the order
+    and the rank of each rectangle in that order.  If \c fixed is not NULL, 
+    the fixed rectangles come first, so that every constraint between a fixed
+    and a movable rectangle puts the movable one after the fixed one.
+*/
+static void sort_by_center(const lay_coord_t* pos, const lay_extent_t* size, 
+                           const int* fixed, const int count, const int axis, 
+                           sort_entry* scratch, int* order, int* rank) {
+    int i, n = 0, pass;
+    
+    for (i = 0; i < count; ++i) {
+        scratch[i].key = 2 * pos[2*i+axis] + size[2*i+axis];
+        scratch[i].index = i;
+    }
+    qsort(scratch, count, sizeof(sort_entry), compare_sort_entries);
+    
+    for (pass = (fixed ? 0 : 1); pass < 2; ++pass) {
+        for (i = 0; i < count; ++i) {
+            if (fixed && (fixed[scratch[i].index] != 0) != (pass == 0))
+                continue;
+            order[n] = scratch[i].index;
+            rank[order[n]] = n;
+            ++n;
+        }
+    }
+}
+
+/** Satisfy all separation constraints along \c axis while staying close to 
+    the \c base coordinates, writing the result into \c pos.
+    
+    The constraints form a DAG in the order given by \c order, so the 
+    tightest solution that only moves rectangles forward is a longest-path 
+    pass, and likewise for only moving backward.  Both are feasible, so their
+    average is too, and it splits each displacement between the two sides. 
+    A final forward pass from the average makes the constraints hold exactly
+    despite rounding.  Rectangles flagged in \c fixed, which may be NULL, stay 
+    at \c base and must come before every rectangle they constrain.
+*/
+static void solve_axis(lay_coord_t* pos, const lay_extent_t* size, 
+                       const int* fixed, const int count,
+                       const int axis, const lay_coord_t* base,
+                       const int* order, const int* rank, const pair_list* constraints) {
+    int *pred_start, *pred, *succ_start, *succ;
+    lay_coord_t *fwd, *bwd;
+    int c, t, e;
+    
+    pred_start = calloc(count + 1, sizeof(int));
+    succ_start = calloc(count + 1, sizeof(int));
+    pred = malloc(sizeof(int) * (constraints->count + 1));
+    succ = malloc(sizeof(int) * (constraints->count + 1));
+    fwd = malloc(sizeof(lay_coord_t) * count);
+    bwd = malloc(sizeof(lay_coord_t) * count);
+    assert(pred_start && succ_start && pred && succ && fwd && bwd);
+    
+    /* Compressed adjacency lists, with every edge pointing forward in the order. */
+    for (c = 0; c < constraints->count; ++c) {
+        const int i = constraints->items[c].first, j = constraints->items[c].second;
+        const int u = (rank[i] < rank[j] ? i : j), v = (rank[i] < rank[j] ? j : i);
+        ++pred_start[v + 1];
+        ++succ_start[u + 1];
+    }
+    for (t = 0; t < count; ++t) {
+        pred_start[t + 1] += pred_start[t];
+        succ_start[t + 1] += succ_start[t];
+    }
+    for (c = 0; c < constraints->count; ++c) {
+        const int i = constraints->items[c].first, j = constraints->items[c].second;
+        const int u = (rank[i] < rank[j] ? i : j), v = (rank[i] < rank[j] ? j : i);
+        pred[pred_start[v]++] = u;
+        succ[succ_start[u]++] = v;
+    }
+    for (t = count; t > 0; --t) {
+        pred_start[t] = pred_start[t - 1];
+        succ_start[t] = succ_start[t - 1];
+    }
+    pred_start[0] = succ_start[0] = 0;
+    
+    /* Push forward only. */
+    for (t = 0; t < count; ++t) {
+        const int v = order[t];
+        fwd[v] = base[v];
+        if (fixed && fixed[v])
+            continue;
+        for (e = pred_start[v]; e < pred_start[v + 1]; ++e) {
+            const int u = pred[e];
+            if (fwd[u] + size[2*u+axis] > fwd[v])
+                fwd[v] = fwd[u] + size[2*u+axis];
+        }
+    }
+    
+    /* Push backward only. */
+    for (t = count - 1; t >= 0; --t) {
+        const int u = order[t];
+        bwd[u] = base[u];
+        if (fixed && fixed[u])
+            continue;
+        for (e = succ_start[u]; e < succ_start[u + 1]; ++e) {
+            const int v = succ[e];
+            if (bwd[v] - size[2*u+axis] < bwd[u])
+                bwd[u] = bwd[v] - size[2*u+axis];
+        }
+    }
+    
+    for (t = 0; t < count; ++t)
+        fwd[t] = (fwd[t] + bwd[t]) / 2;
+    
+    for (t = 0; t < count; ++t) {
+        const int v = order[t];
+        lay_coord_t p = fwd[v];
+        if (fixed && fixed[v]) {
+            pos[2*v+axis] = base[v];
+            continue;
+        }
+        for (e = pred_start[v]; e < pred_start[v + 1]; ++e) {
+            const int u = pred[e];
+            if (pos[2*u+axis] + size[2*u+axis] > p)
+                p = pos[2*u+axis] + size[2*u+axis];
+        }
+        pos[2*v+axis] = p;
+    }
+    
+    free(pred_start);
+    free(succ_start);
+    free(pred);
+    free(succ);
+    free(fwd);
+    free(bwd);
+}
+
+/** Keep only the pairs of \c pairs with a movable rectangle, and, unless 
+    \c with_fixed is set, only those of two movable rectangles. */
+static void drop_fixed_pairs(pair_list* pairs, const int* fixed, const int with_fixed) {
+    int c, n = 0;
+    
+    for (c = 0; c < pairs->count; ++c) {
+        const int i = pairs->items[c].first, j = pairs->items[c].second;
+        if (fixed[i] && fixed[j])
+            continue;
+        if (!with_fixed && (fixed[i] || fixed[j]))
+            continue;
+        pairs->items[n++] = pairs->items[c];
+    }
+    pairs->count = n;
+}
+
+void lay_legalize(lay_coord_t* rect_pos, const ptrdiff_t pos_skip,
+                  const lay_extent_t* rect_size, const ptrdiff_t size_skip,
+                  const int count) {
+    lay_legalize_fixed(rect_pos, pos_skip, rect_size, size_skip, NULL, 0, count);
+}
+
+void lay_legalize_fixed(lay_coord_t* rect_pos, const ptrdiff_t pos_skip,
+                        const lay_extent_t* rect_size, const ptrdiff_t size_skip,
+                        const int* fixed, const ptrdiff_t fixed_skip,
+                        const int count) {
+    const ptrdiff_t pskip = LAY_PACKED_SKIP(pos_skip, lay_coord_t);
+    const ptrdiff_t sskip = LAY_PACKED_SKIP(size_skip, lay_extent_t);
+    const ptrdiff_t fskip = (fixed_skip != 0 ? fixed_skip : (ptrdiff_t) sizeof(int));
+    pair_list pairs = { 0, 0, NULL }, x_cons = { 0, 0, NULL }, y_cons = { 0, 0, NULL };
+    overlap_search search;
+    lay_coord_t *pos, *base;
+    lay_extent_t* size;
+    sort_entry* scratch;
+    int *order, *rank, *fix = NULL;
+    int i, c;
+    
+    assert(count >= 0);
+    if (count < 2)
+        return;
+    assert(rect_pos && rect_size);
+    
+    pos = malloc(sizeof(lay_coord_t) * 2 * count);
+    size = malloc(sizeof(lay_extent_t) * 2 * count);
+    base = malloc(sizeof(lay_coord_t) * count);
+    scratch = malloc(sizeof(sort_entry) * count);
+    order = malloc(sizeof(int) * count);
+    rank = malloc(sizeof(int) * count);
+    memset(&search, 0, sizeof(search));
+    search.boxes = malloc(sizeof(lay_coord_t) * 4 * count);
+    assert(pos && size && base && scratch && order && rank && search.boxes);
+    
+    for (i = 0; i < count; ++i) {
+        const lay_coord_t* p = LAY_STRIDED(const lay_coord_t, rect_pos, pskip, i);
+        const lay_extent_t* s = LAY_STRIDED(const lay_extent_t, rect_size, sskip, i);
+        pos[2*i]   = p[0];
+        pos[2*i+1] = p[1];
+        size[2*i]   = s[0];
+        size[2*i+1] = s[1];
+    }
+    if (fixed) {
+        fix = malloc(sizeof(int) * count);
+        assert(fix);
+        for (i = 0; i < count; ++i)
+            fix[i] = *LAY_STRIDED(const int, fixed, fskip, i);
+    }
+    
+    /* Separate along x the pairs of movable rectangles that penetrate least 
+       along x. */
+    find_overlaps(pos, size, count, &search, &pairs);
+    if (fix)
+        drop_fixed_pairs(&pairs, fix, 0);
+    for (c = 0; c < pairs.count; ++c) {
+        const int i = pairs.items[c].first, j = pairs.items[c].second;
+        if (penetration(pos, size, i, j, 0) <= penetration(pos, size, i, j, 1))
+            pair_list_add(&x_cons, i, j);
+    }
+    
+    if (x_cons.count > 0) {
+        sort_by_center(pos, size, NULL, count, 0, scratch, order, rank);
+        for (i = 0; i < count; ++i)
+            base[i] = pos[2*i];
+        solve_axis(pos, size, fix, count, 0, base, order, rank, &x_cons);
+    }
+    
+    /* Separate everything else along y.  Moving along y cannot change which 
+       x-intervals intersect, so this terminates once every remaining 
+       overlapping pair has a constraint.  The fixed rectangles come first in
+       the order, so the constraints on them can always be met. */
+    sort_by_center(pos, size, fix, count, 1, scratch, order, rank);
+    for (i = 0; i < count; ++i)
+        base[i] = pos[2*i+1];
+    
+    for (;;) {
+        find_overlaps(pos, size, count, &search, &pairs);
+        if (fix)
+            drop_fixed_pairs(&pairs, fix, 1);
+        if (pairs.count == 0)
+            break;
+        
+        for (c = 0; c < pairs.count; ++c)
+            pair_list_add(&y_cons, pairs.items[c].first, pairs.items[c].second);
+        solve_axis(pos, size, fix, count, 1, base, order, rank, &y_cons);
+    }
+    
+    for (i = 0; i < count; ++i) {
+        lay_coord_t* p = LAY_STRIDED(lay_coord_t, rect_pos, pskip, i);
+        p[0] = pos[2*i];
+        p[1] = pos[2*i+1];
+    }
+    
+    free(pairs.items);
+    free(search.boxes);
+    lay_hgrid_destroy(&search.grid);
+    lay_packed_pairs_destroy(&search.packed);
+    free(x_cons.items);
+    free(y_cons.items);
+    free(pos);
+    free(size);
+    free(base);
+    free(scratch);
+    free(order);
+    free(rank);
+    free(fix);
+}
@@ -0,0 +1,373 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+/** \file src/multilevel.c
+* Coarse-to-fine (multilevel) optimization.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include <layout/multilevel.h>
+#include "strided.h"
+#include "state.h"
+
+/** Stop coarsening once a level has fewer rectangles than this. */
+#define MIN_COARSE_RECTS 64
+
+/** Stop coarsening when a level keeps more than this fraction of the rectangles
+    of the level below it. 
+*/
+#define MAX_COARSE_FRACTION 0.8
+
+/** The largest number of rectangles that are merged into one coarse rectangle. */
+#define MAX_CLUSTER_SIZE 8
+
+/** The most iterations spent on a coarse level.  The coarse levels only move 
+    the clusters roughly into place; the full solve is left to the finest. */
+#define MAX_COARSE_ITERATIONS 50
+
+/** The most iterations spent on the registered rectangles once the coarse 
+    levels have placed them. */
+#define MAX_FINE_ITERATIONS 20
+
+/** A coarse level of the hierarchy.  All arrays are tightly packed. */
+typedef struct {
+    int count;              /**< The number of rectangles in this level. */
+    lay_coord_t* pos;       /**< Positions, two per rectangle. */
+    lay_extent_t* size;     /**< Sizes, two per rectangle. */
+    lay_coord_t* orig_pos;  /**< Positions before this level was optimized. */
+    lay_extent_t* margins;  /**< The largest margin in each cluster, or NULL if none were registered. */
+    lay_real_t* overlap_weights;    /**< Area-weighted mean overlap weights, or NULL if none were registered. */
+    lay_real_t* orig_pos_weights;   /**< Area-weighted mean original position weights, or NULL if none were registered. */
+    int* fixed;             /**< Whether each cluster holds fixed rectangles, or NULL if no flags were registered. */
+    int* parent;            /**< The rectangle in the next coarser level that contains each rectangle, or NULL. */
+} level;
+
+/** A rectangle waiting to be assigned to a cluster. */
+typedef struct {
+    long long key;          /**< The grid cell containing the rectangle's center. */
+    int fixed;              /**< Whether the rectangle is fixed. */
+    int index;              /**< The index of the rectangle in its level. */
+} cell_entry;
+
+static int compare_cell_entries(const void* a, const void* b) {
+    const cell_entry* e1 = (const cell_entry*) a;
+    const cell_entry* e2 = (const cell_entry*) b;
+    
+    if (e1->key != e2->key)
+        return (e1->key < e2->key ? -1 : 1);
+    if (e1->fixed != e2->fixed)
+        return e1->fixed - e2->fixed;
+    return e1->index - e2->index;
+}
+
+static void destroy_level(level* l) {
+    assert(l);
+    free(l->pos);
+    free(l->size);
+    free(l->orig_pos);
+    free(l->margins);
+    free(l->overlap_weights);
+    free(l->orig_pos_weights);
+    free(l->fixed);
+    free(l->parent);
+}
+
+/** The arrays of a level, as they are registered for its optimization. */
+static void level_arrays(const level* l, lay_rect_arrays* a) {
+    memset(a, 0, sizeof(*a));
+    a->pos = l->pos;
+    a->pos_skip = 2 * sizeof(lay_coord_t);
+    a->size = l->size;
+    a->size_skip = 2 * sizeof(lay_extent_t);
+    a->margins = l->margins;
+    a->margins_skip = sizeof(lay_extent_t);
+    a->overlap_weights = l->overlap_weights;
+    a->overlap_weights_skip = sizeof(lay_real_t);
+    a->orig_pos_weights = l->orig_pos_weights;
+    a->orig_pos_weights_skip = sizeof(lay_real_t);
+    a->fixed = l->fixed;
+    a->fixed_skip = sizeof(int);
+}
+
+/** Cluster the rectangles of a level by the grid cell of their centers and 
+    merge each cluster into one rectangle of the same total area, with the 
+    largest margin and the area-weighted mean weights of its members.  Fixed
+    rectangles are only clustered with each other, into fixed clusters.  Fills 
+    in \c parent for the fine level and returns the coarse level in \c coarse.
+*/
+static void coarsen(const lay_rect_arrays* fine, const int count, 
+                    int* parent, level* coarse) {
+    const lay_coord_t* pos = fine->pos;
+    const lay_extent_t* size = fine->size;
+    const ptrdiff_t pos_skip = fine->pos_skip, size_skip = fine->size_skip;
+    cell_entry* entries;
+    lay_real_t total_area = 0, cell_size;
+    int i, j, start, num_clusters;
+    
+    assert(fine && pos && size && parent && coarse && count > 0);
+    
+    for (i = 0; i < count; ++i) {
+        const lay_extent_t* s = LAY_STRIDED(const lay_extent_t, size, size_skip, i);
+        total_area += (lay_real_t) s[0] * s[1];
+    }
+    
+    /* A cell twice as wide as a typical rectangle holds about four of them 
+       once the layout is overlap-free. */
+    cell_size = 2 * sqrt(total_area / count);
+    if (!(cell_size > 0))
+        cell_size = 1;
+    
+    entries = malloc(sizeof(cell_entry) * count);
+    assert(entries);
+    
+    for (i = 0; i < count; ++i) {
+        const lay_coord_t* p = LAY_STRIDED(const lay_coord_t, pos, pos_skip, i);
+        const lay_extent_t* s = LAY_STRIDED(const lay_extent_t, size, size_skip, i);
+        const long long cx = (long long) floor((p[0] + 0.5 * s[0]) / cell_size);
+        const long long cy = (long long) floor((p[1] + 0.5 * s[1]) / cell_size);
+        
+        entries[i].key = cy * 0x100000000LL + (cx & 0xffffffffLL);
+        entries[i].fixed = (fine->fixed && *LAY_STRIDED(const int, fine->fixed, fine->fixed_skip, i) ? 1 : 0);
+        entries[i].index = i;
+    }
+    
+    qsort(entries, count, sizeof(cell_entry), compare_cell_entries);
+    
+    /* Runs of equal keys become clusters, split if they grow too large. */
+    num_clusters = 0;
+    for (start = 0; start < count; start = j) {
+        for (j = start; j < count && j - start < MAX_CLUSTER_SIZE && 
+                        entries[j].key == entries[start].key &&
+                        entries[j].fixed == entries[start].fixed; ++j)
+            parent[entries[j].index] = num_clusters;
+        ++num_clusters;
+    }
+    
+    coarse->count = num_clusters;
+    coarse->pos = malloc(sizeof(lay_coord_t) * 2 * num_clusters);
+    coarse->size = malloc(sizeof(lay_extent_t) * 2 * num_clusters);
+    coarse->orig_pos = malloc(sizeof(lay_coord_t) * 2 * num_clusters);
+    coarse->margins = (fine->margins ? malloc(sizeof(lay_extent_t) * num_clusters) : NULL);
+    coarse->overlap_weights = (fine->overlap_weights ? malloc(sizeof(lay_real_t) * num_clusters) : NULL);
+    coarse->orig_pos_weights = (fine->orig_pos_weights ? malloc(sizeof(lay_real_t) * num_clusters) : NULL);
+    coarse->fixed = (fine->fixed ? malloc(sizeof(int) * num_clusters) : NULL);
+    coarse->parent = NULL;
+    assert(coarse->pos && coarse->size && coarse->orig_pos);
+    assert(!fine->margins || coarse->margins);
+    assert(!fine->overlap_weights || coarse->overlap_weights);
+    assert(!fine->orig_pos_weights || coarse->orig_pos_weights);
+    assert(!fine->fixed || coarse->fixed);
+    
+    for (start = 0; start < count; start = j) {
+        const int c = parent[entries[start].index];
+        lay_real_t area = 0, weight_sum = 0, cx = 0, cy = 0, min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+        lay_real_t width, height, overlap_weight = 0, orig_pos_weight = 0;
+        lay_extent_t margin = 0;
+        
+        for (j = start; j < count && parent[entries[j].index] == c; ++j) {
+            const int u = entries[j].index;
+            const lay_coord_t* p = LAY_STRIDED(const lay_coord_t, pos, pos_skip, u);
+            const lay_extent_t* s = LAY_STRIDED(const lay_extent_t, size, size_skip, u);
+            const lay_real_t a = (lay_real_t) s[0] * s[1];
+            
+            /* Empty rectangles still count towards the mean weights. */
+            const lay_real_t w = (a > 0 ? a : 1);
+            
+            if (fine->margins) {
+                const lay_extent_t m = *LAY_STRIDED(const lay_extent_t, fine->margins, fine->margins_skip, u);
+                if (j == start || m > margin)
+                    margin = m;
+            }
+            if (fine->overlap_weights)
+                overlap_weight += w * *LAY_STRIDED(const lay_real_t, fine->overlap_weights, 
+                                                   fine->overlap_weights_skip, u);
+            if (fine->orig_pos_weights)
+                orig_pos_weight += w * *LAY_STRIDED(const lay_real_t, fine->orig_pos_weights, 
+                                                    fine->orig_pos_weights_skip, u);
+            weight_sum += w;
+            area += a;
+            cx += a * (p[0] + 0.5 * s[0]);
+            cy += a * (p[1] + 0.5 * s[1]);
+            
+            if (j == start || p[0] < min_x)        min_x = p[0];
+            if (j == start || p[1] < min_y)        min_y = p[1];
+            if (j == start || p[0] + s[0] > max_x) max_x = p[0] + s[0];
+            if (j == start || p[1] + s[1] > max_y) max_y = p[1] + s[1];
+        }
+        
+        if (area > 0) {
+            cx /= area;
+            cy /= area;
+        } else {
+            cx = 0.5 * (min_x + max_x);
+            cy = 0.5 * (min_y + max_y);
+        }
+        
+        /* Keep the total area of the cluster and the aspect ratio of its bounds. */
+        if (max_x > min_x && max_y > min_y) {
+            width = sqrt(area * (max_x - min_x) / (max_y - min_y));
+            height = (width > 0 ? area / width : 0);
+        } else {
+            width = height = sqrt(area);
+        }
+        
+        coarse->size[2*c]   = (lay_extent_t) width;
+        coarse->size[2*c+1] = (lay_extent_t) height;
+        coarse->pos[2*c]    = (lay_coord_t) (cx - 0.5 * width);
+        coarse->pos[2*c+1]  = (lay_coord_t) (cy - 0.5 * height);
+        
+        if (coarse->margins)
+            coarse->margins[c] = margin;
+        if (coarse->overlap_weights)
+            coarse->overlap_weights[c] = overlap_weight / weight_sum;
+        if (coarse->orig_pos_weights)
+            coarse->orig_pos_weights[c] = orig_pos_weight / weight_sum;
+        if (coarse->fixed)
+            coarse->fixed[c] = entries[start].fixed;
+    }
+    
+    free(entries);
+}
+
+/** Optimize one coarse level with \c state, which holds the caller's settings. */
+static void optimize_level(lay_statep state, level* l) {
+    assert(state && l);
+    
+    lay_register_rects(state, l->pos, 0, l->size, 0, l->count);
+    lay_register_margins(state, l->margins, 0);
+    lay_register_weights(state, l->overlap_weights, 0, l->orig_pos_weights, 0);
+    lay_register_fixed(state, l->fixed, 0);
+    lay_optimize(state);
+}
+
+/** Move every rectangle of a finer level by the displacement of its coarse rectangle. */
+static void prolong(const level* coarse, const int* parent, 
+                    lay_coord_t* pos, const ptrdiff_t pos_skip, const int count) {
+    int i;
+    
+    assert(coarse && parent && pos);
+    
+    for (i = 0; i < count; ++i) {
+        lay_coord_t* p = LAY_STRIDED(lay_coord_t, pos, pos_skip, i);
+        const int c = parent[i];
+        
+        assert(c >= 0 && c < coarse->count);
+        p[0] += coarse->pos[2*c]   - coarse->orig_pos[2*c];
+        p[1] += coarse->pos[2*c+1] - coarse->orig_pos[2*c+1];
+    }
+}
+
+void lay_optimize_multilevel(lay_statep state, const int max_levels) {
+    level* levels = NULL;
+    int* fine_parent = NULL;
+    int count, num_levels = 0, k;
+    lay_rect_arrays registered;
+    lay_statep level_state;
+    macopt_args* args;
+    int itmax;
+    
+    assert(state);
+    count = lay_state_get_arrays(state, &registered);
+    
+    /* Build the hierarchy.  levels[k] is one coarser than levels[k-1], and 
+       levels[0] is one coarser than the registered rectangles. */
+    while ((max_levels <= 0 || num_levels < max_levels)) {
+        const int fine_count = (num_levels == 0 ? count : levels[num_levels-1].count);
+        int* parent;
+        level coarse;
+        
+        if (fine_count < MIN_COARSE_RECTS)
+            break;
+        
+        parent = malloc(sizeof(int) * fine_count);
+        assert(parent);
+        
+        if (num_levels == 0) {
+            coarsen(&registered, count, parent, &coarse);
+        } else {
+            lay_rect_arrays fine;
+            level_arrays(levels + num_levels - 1, &fine);
+            coarsen(&fine, fine_count, parent, &coarse);
+        }
+        
+        if (coarse.count > MAX_COARSE_FRACTION * fine_count) {
+            destroy_level(&coarse);
+            free(parent);
+            break;
+        }
+        
+        levels = realloc(levels, sizeof(level) * (num_levels + 1));
+        assert(levels);
+        levels[num_levels] = coarse;
+        
+        if (num_levels == 0)
+            fine_parent = parent;
+        else
+            levels[num_levels-1].parent = parent;
+        ++num_levels;
+    }
+    
+    if (num_levels == 0) {
+        lay_optimize(state);
+        return;
+    }
+    
+    /* Solve from the coarsest level down with the caller's settings, and a 
+       capped number of iterations, carrying each level's displacement to the 
+       level below it. */
+    level_state = lay_create_state();
+    lay_copy_settings(level_state, state);
+    args = lay_state_opt_args(level_state);
+    if (args->itmax > MAX_COARSE_ITERATIONS)
+        args->itmax = MAX_COARSE_ITERATIONS;
+    
+    for (k = num_levels - 1; k >= 0; --k) {
+        level* l = levels + k;
+        
+        memcpy(l->orig_pos, l->pos, sizeof(lay_coord_t) * 2 * l->count);
+        optimize_level(level_state, l);
+        
+        if (k > 0)
+            prolong(l, levels[k-1].parent, levels[k-1].pos, 0, levels[k-1].count);
+        else
+            prolong(l, fine_parent, registered.pos, registered.pos_skip, count);
+    }
+    
+    lay_destroy_state(level_state);
+    for (k = 0; k < num_levels; ++k)
+        destroy_level(levels + k);
+    free(levels);
+    free(fine_parent);
+    
+    /* The registered rectangles only need polishing, with the caller's 
+       iteration limit restored afterwards. */
+    args = lay_state_opt_args(state);
+    itmax = args->itmax;
+    if (args->itmax > MAX_FINE_ITERATIONS)
+        args->itmax = MAX_FINE_ITERATIONS;
+    lay_optimize(state);
+    args->itmax = itmax;
+}
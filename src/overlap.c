@@ -21,23 +21,27 @@
 */
 
 #include <layout/overlap.h>
+#include "bitset.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <math.h>
 
-lay_real_t lay_overlap_area(const lay_coord_t* pos1, const lay_extent_t* size1, 
-                            const lay_coord_t* pos2, const lay_extent_t* size2,
-                            lay_real_t* grad) {
+lay_real_t lay_overlap_area_margin(const lay_coord_t* pos1, const lay_extent_t* size1, 
+                                   const lay_coord_t* pos2, const lay_extent_t* size2,
+                                   const lay_extent_t margin, lay_real_t* grad) {
     int i;
     lay_coord_t x_len, y_len, x_overlap, y_overlap, x_overlap_grad_x, y_overlap_grad_y;
 
     assert(pos1 && size1 && pos2 && size2);
 
+    /* Growing both rectangles by half the margin on every side leaves their 
+       centers in place and adds the margin to the sum of the extents. */
     x_len = 2 * (pos2[0] - pos1[0]) + (size2[0] - size1[0]);
     y_len = 2 * (pos2[1] - pos1[1]) + (size2[1] - size1[1]);
-    x_overlap = (size1[0] + size2[0]) - LAY_COORD_ABS(x_len);
-    y_overlap = (size1[1] + size2[1]) - LAY_COORD_ABS(y_len);
+    x_overlap = (size1[0] + size2[0] + 2 * margin) - LAY_COORD_ABS(x_len);
+    y_overlap = (size1[1] + size2[1] + 2 * margin) - LAY_COORD_ABS(y_len);
     
     if (x_overlap <= 0 || y_overlap <= 0) {
         if (grad) 
@@ -50,13 +54,19 @@ lay_real_t lay_overlap_area(const lay_coord_t* pos1, const lay_extent_t* size1,
         x_overlap_grad_x = (x_len >= 0 ? 2 : -2);
         y_overlap_grad_y = (y_len >= 0 ? 2 : -2);
         
-        grad[0] = x_overlap_grad_x * y_overlap;     /* Grad w.r.t. r1->x */
-        grad[1] = y_overlap_grad_y * x_overlap;     /* Grad w.r.t. r1->y */
+        grad[0] = (lay_real_t) x_overlap_grad_x * y_overlap;    /* Grad w.r.t. r1->x */
+        grad[1] = (lay_real_t) y_overlap_grad_y * x_overlap;    /* Grad w.r.t. r1->y */
         grad[2] = -grad[0];                         /* Grad w.r.t. r2->x */
         grad[3] = -grad[1];                         /* Grad w.r.t. r2->y */
     }
     
-    return x_overlap * y_overlap;
+    return (lay_real_t) x_overlap * y_overlap;
+}
+
+lay_real_t lay_overlap_area(const lay_coord_t* pos1, const lay_extent_t* size1, 
+                            const lay_coord_t* pos2, const lay_extent_t* size2,
+                            lay_real_t* grad) {
+    return lay_overlap_area_margin(pos1, size1, pos2, size2, 0, grad);
 }
 
 lay_real_t lay_all_overlap_area(const int num_rects, 
@@ -104,6 +114,42 @@ int lay_any_overlap(const int num_rects,
     return 0;
 }
 
+int lay_any_overlap_each(const int num_rects, 
+                         const lay_coord_t* pos, const lay_extent_t* size,
+                         int* overlaps) {
+    lay_bitset bits;
+    lay_coord_t* boxes;
+    int i, sum = 0;
+    
+    assert(num_rects >= 0 && ((pos && size && overlaps) || num_rects == 0));
+    
+    if (num_rects == 0)
+        return 0;
+    if (num_rects > LAY_BITSET_MAX_BOXES) {
+        for (i = 0; i < num_rects; ++i)
+            sum += overlaps[i] = lay_any_overlap(num_rects, pos, size, i);
+        return sum;
+    }
+    
+    boxes = malloc(sizeof(lay_coord_t) * 4 * num_rects);
+    assert(boxes);
+    for (i = 0; i < num_rects; ++i) {
+        boxes[4*i  ] = pos[2*i];
+        boxes[4*i+1] = pos[2*i+1];
+        boxes[4*i+2] = pos[2*i] + size[2*i];
+        boxes[4*i+3] = pos[2*i+1] + size[2*i+1];
+    }
+    
+    memset(&bits, 0, sizeof(bits));
+    lay_bitset_build(&bits, boxes, num_rects);
+    for (i = 0; i < num_rects; ++i)
+        sum += overlaps[i] = lay_bitset_any(&bits, i);
+    
+    lay_bitset_destroy(&bits);
+    free(boxes);
+    return sum;
+}
+
 /* Ah, sweet O(N^2). */
 int lay_any_overlap_any(const int num_rects, 
                         const lay_coord_t* pos, const lay_extent_t* size) {
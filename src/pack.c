@@ -0,0 +1,254 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+/** \file src/pack.c
+* Skyline packing for starting layouts.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <layout/pack.h>
+#include "strided.h"
+
+/** The upper envelope of the rectangles placed so far.  Segment \c k covers 
+    <tt>[start[k], start[k+1])</tt> at height \c top[k], and \c start[count] is 
+    the end of the strip. 
+*/
+typedef struct {
+    int count;              /**< The number of segments. */
+    int capacity;           /**< The number of segments allocated. */
+    lay_coord_t* start;     /**< The start of each segment, plus the end of the strip. */
+    lay_coord_t* top;       /**< The height of each segment. */
+} skyline;
+
+/** A rectangle waiting to be placed. */
+typedef struct {
+    lay_coord_t y;          /**< The current y coordinate. */
+    lay_coord_t x;          /**< The current x coordinate. */
+    int index;              /**< The index of the rectangle. */
+} pack_entry;
+
+/** The best placement found so far for one rectangle. */
+typedef struct {
+    lay_real_t cost;        /**< The squared distance from the current position, or negative if none. */
+    lay_coord_t x;          /**< The x coordinate. */
+    lay_coord_t y;          /**< The y coordinate. */
+} placement;
+
+static int compare_pack_entries(const void* a, const void* b) {
+    const pack_entry* e1 = (const pack_entry*) a;
+    const pack_entry* e2 = (const pack_entry*) b;
+    
+    if (e1->y != e2->y)
+        return (e1->y < e2->y ? -1 : 1);
+    if (e1->x != e2->x)
+        return (e1->x < e2->x ? -1 : 1);
+    return e1->index - e2->index;
+}
+
+/** The segment containing \c x, clamped to the strip. */
+static int find_segment(const skyline* s, const lay_coord_t x) {
+    int lo = 0, hi = s->count - 1;
+    
+    while (lo < hi) {
+        const int mid = (lo + hi + 1) / 2;
+        if (s->start[mid] <= x)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+/** The highest point of the skyline over <tt>[x, x + width)</tt>. */
+static lay_coord_t span_top(const skyline* s, const lay_coord_t x, const lay_extent_t width) {
+    int k = find_segment(s, x);
+    lay_coord_t result = s->top[k];
+    
+    for (++k; k < s->count && s->start[k] < x + width; ++k)
+        if (s->top[k] > result)
+            result = s->top[k];
+    return result;
+}
+
+/** Raise the skyline over <tt>[x, x + width)</tt> to \c top. */
+static void raise_skyline(skyline* s, const lay_coord_t x, const lay_extent_t width, 
+                          const lay_coord_t top) {
+    const lay_coord_t end = x + width;
+    lay_coord_t new_start[3], new_top[3];
+    int k1, k2, num_new = 0, num_old;
+    
+    if (!(width > 0))
+        return;
+    
+    k1 = find_segment(s, x);
+    k2 = find_segment(s, end);
+    if (k2 > k1 && s->start[k2] >= end)
+        --k2;
+    
+    if (s->start[k1] < x) {
+        new_start[num_new] = s->start[k1];
+        new_top[num_new++] = s->top[k1];
+    }
+    new_start[num_new] = x;
+    new_top[num_new++] = top;
+    if (end < s->start[k2 + 1]) {
+        new_start[num_new] = end;
+        new_top[num_new++] = s->top[k2];
+    }
+    
+    num_old = k2 - k1 + 1;
+    if (s->count - num_old + num_new > s->capacity) {
+        s->capacity = 2 * (s->count - num_old + num_new);
+        s->start = realloc(s->start, sizeof(lay_coord_t) * (s->capacity + 1));
+        s->top = realloc(s->top, sizeof(lay_coord_t) * s->capacity);
+        assert(s->start && s->top);
+    }
+    
+    /* Shift the following segments and the strip end into place. */
+    memmove(s->start + k1 + num_new, s->start + k2 + 1, 
+            sizeof(lay_coord_t) * (s->count - k2));
+    memmove(s->top + k1 + num_new, s->top + k2 + 1, 
+            sizeof(lay_coord_t) * (s->count - k2 - 1));
+    memcpy(s->start + k1, new_start, sizeof(lay_coord_t) * num_new);
+    memcpy(s->top + k1, new_top, sizeof(lay_coord_t) * num_new);
+    s->count += num_new - num_old;
+}
+
+/** Consider placing a rectangle with its left edge at \c x. */
+static void try_placement(const skyline* s, lay_coord_t x, 
+                          const lay_coord_t* orig, const lay_extent_t* size,
+                          const lay_coord_t min_x, const lay_coord_t max_x, 
+                          placement* best) {
+    lay_coord_t y;
+    lay_real_t dx, dy, cost;
+    
+    if (x < min_x) x = min_x;
+    if (x > max_x) x = max_x;
+    
+    y = span_top(s, x, size[0]);
+    if (y < orig[1])
+        y = orig[1];
+    
+    dx = (lay_real_t) x - orig[0];
+    dy = (lay_real_t) y - orig[1];
+    cost = dx * dx + dy * dy;
+    if (best->cost < 0 || cost < best->cost || (cost == best->cost && x < best->x)) {
+        best->cost = cost;
+        best->x = x;
+        best->y = y;
+    }
+}
+
+void lay_initial_pack(lay_coord_t* rect_pos, const ptrdiff_t pos_skip,
+                      const lay_extent_t* rect_size, const ptrdiff_t size_skip,
+                      const int count, const lay_coord_t strip_width) {
+    const ptrdiff_t pskip = LAY_PACKED_SKIP(pos_skip, lay_coord_t);
+    const ptrdiff_t sskip = LAY_PACKED_SKIP(size_skip, lay_extent_t);
+    lay_coord_t min_x, max_x, min_y, width;
+    lay_extent_t max_width;
+    pack_entry* entries;
+    skyline sky;
+    int i, k;
+    
+    assert(count >= 0);
+    if (count == 0)
+        return;
+    assert(rect_pos && rect_size);
+    
+    entries = malloc(sizeof(pack_entry) * count);
+    assert(entries);
+    
+    min_x = max_x = rect_pos[0];
+    min_y = rect_pos[1];
+    max_width = 0;
+    for (i = 0; i < count; ++i) {
+        const lay_coord_t* p = LAY_STRIDED(const lay_coord_t, rect_pos, pskip, i);
+        const lay_extent_t* s = LAY_STRIDED(const lay_extent_t, rect_size, sskip, i);
+        
+        if (p[0] < min_x)        min_x = p[0];
+        if (p[0] + s[0] > max_x) max_x = p[0] + s[0];
+        if (p[1] < min_y)        min_y = p[1];
+        if (s[0] > max_width)    max_width = s[0];
+        
+        entries[i].y = p[1];
+        entries[i].x = p[0];
+        entries[i].index = i;
+    }
+    
+    width = (strip_width > 0 ? strip_width : max_x - min_x);
+    if (width < max_width)
+        width = max_width;
+    
+    qsort(entries, count, sizeof(pack_entry), compare_pack_entries);
+    
+    sky.count = 1;
+    sky.capacity = 64;
+    sky.start = malloc(sizeof(lay_coord_t) * (sky.capacity + 1));
+    sky.top = malloc(sizeof(lay_coord_t) * sky.capacity);
+    assert(sky.start && sky.top);
+    sky.start[0] = min_x;
+    sky.start[1] = min_x + width;
+    sky.top[0] = min_y;
+    
+    for (i = 0; i < count; ++i) {
+        lay_coord_t* p = LAY_STRIDED(lay_coord_t, rect_pos, pskip, entries[i].index);
+        const lay_extent_t* s = LAY_STRIDED(const lay_extent_t, rect_size, sskip, entries[i].index);
+        const lay_coord_t hi_x = min_x + width - s[0];
+        const int k0 = find_segment(&sky, p[0]);
+        placement best;
+        lay_real_t d;
+        
+        best.cost = -1;
+        best.x = p[0];
+        best.y = p[1];
+        
+        try_placement(&sky, p[0], p, s, min_x, hi_x, &best);
+        
+        /* Align with the segment ends on either side, nearest first, until 
+           the horizontal distance alone rules out any improvement. */
+        for (k = k0; k < sky.count; ++k) {
+            d = (lay_real_t) sky.start[k] - s[0] - p[0];
+            if (d > 0 && d * d > best.cost)
+                break;
+            try_placement(&sky, sky.start[k], p, s, min_x, hi_x, &best);
+            try_placement(&sky, sky.start[k+1] - s[0], p, s, min_x, hi_x, &best);
+        }
+        for (k = k0 - 1; k >= 0; --k) {
+            d = (lay_real_t) p[0] - sky.start[k+1];
+            if (d > 0 && d * d > best.cost)
+                break;
+            try_placement(&sky, sky.start[k], p, s, min_x, hi_x, &best);
+            try_placement(&sky, sky.start[k+1] - s[0], p, s, min_x, hi_x, &best);
+        }
+        
+        p[0] = best.x;
+        p[1] = best.y;
+        raise_skyline(&sky, best.x, s[0], best.y + s[1]);
+    }
+    
+    free(sky.start);
+    free(sky.top);
+    free(entries);
+}
@@ -0,0 +1,111 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "broadphase.h"
+
+/** The most bytes a varint of 32 bits takes. */
+#define VARINT_MAX_BYTES 5
+
+/** Append \c value to \c data as a varint, returning the end. */
+static unsigned char* write_varint(unsigned char* data, unsigned int value) {
+    while (value >= 0x80) {
+        *data++ = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    *data++ = (unsigned char) value;
+    return data;
+}
+
+/** Zigzag encode a signed value, so that small magnitudes of either sign 
+    become small unsigned values. */
+static unsigned int zigzag(const int value) {
+    return (value < 0 ? ~((unsigned int) value << 1) : (unsigned int) value << 1);
+}
+
+static int compare_ints(const void* a, const void* b) {
+    const int x = *(const int*) a, y = *(const int*) b;
+    return (x > y) - (x < y);
+}
+
+void lay_packed_pairs_clear(lay_packed_pairs* pairs, const int* ids) {
+    assert(pairs);
+    pairs->count = 0;
+    pairs->size = 0;
+    pairs->ids = ids;
+    pairs->last_index = 0;
+    pairs->row_count = 0;
+}
+
+void lay_packed_pairs_end_row(lay_packed_pairs* pairs, const int index) {
+    const int n = pairs->row_count;
+    const int* row = pairs->row;
+    unsigned char* data;
+    long need;
+    int k;
+
+    assert(pairs && index >= 0);
+    if (n == 0)
+        return;
+
+    /* Most rows are found in order, or nearly, so check before sorting. */
+    for (k = 1; k < n && row[k-1] < row[k]; ++k)
+        ;
+    if (k < n)
+        qsort(pairs->row, n, sizeof(int), compare_ints);
+
+    need = pairs->size + (long) VARINT_MAX_BYTES * (n + 3);
+    if (need > pairs->capacity) {
+        pairs->capacity = (2 * pairs->capacity > need ? 2 * pairs->capacity : need + 4096);
+        pairs->data = realloc(pairs->data, pairs->capacity);
+        assert(pairs->data);
+    }
+
+    data = pairs->data + pairs->size;
+    data = write_varint(data, zigzag(index - pairs->last_index));
+    data = write_varint(data, (unsigned int) n);
+    data = write_varint(data, zigzag(row[0] - index));
+    for (k = 1; k < n; ++k) {
+        assert(row[k] > row[k-1]);
+        data = write_varint(data, (unsigned int) (row[k] - row[k-1]));
+    }
+
+    pairs->size = data - pairs->data;
+    pairs->count += n;
+    pairs->last_index = index;
+    pairs->row_count = 0;
+}
+
+void lay_packed_pairs_destroy(lay_packed_pairs* pairs) {
+    assert(pairs);
+    free(pairs->data);
+    free(pairs->row);
+    pairs->data = NULL;
+    pairs->row = NULL;
+    pairs->capacity = 0;
+    pairs->row_capacity = 0;
+    pairs->count = 0;
+    pairs->size = 0;
+    pairs->row_count = 0;
+}
@@ -0,0 +1,162 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+/** The argument passed to each worker thread. */
+typedef struct {
+    lay_pool* pool;         /**< The pool. */
+    int id;                 /**< The index of this worker. */
+} worker_arg;
+
+struct lay_pool {
+    pthread_mutex_t lock;   /**< Protects everything below. */
+    pthread_cond_t start;   /**< Signalled when a new function is posted or the pool stops. */
+    pthread_cond_t done;    /**< Signalled when the last worker finishes a function. */
+    lay_pool_func func;     /**< The function being run. */
+    void* arg;              /**< Its argument. */
+    unsigned long generation;   /**< Counts the functions posted. */
+    int pending;            /**< Worker threads still running the function. */
+    int stop;               /**< Whether the threads should exit. */
+    
+    int num_workers;        /**< The number of workers, counting the caller. */
+    pthread_t* threads;     /**< The worker threads, <tt>num_workers - 1</tt>. */
+    worker_arg* args;       /**< Their arguments. */
+};
+
+static void* worker(void* arg) {
+    const worker_arg* w = (const worker_arg*) arg;
+    lay_pool* pool = w->pool;
+    unsigned long seen = 0;
+    lay_pool_func func;
+    void* func_arg;
+    
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->stop)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stop)
+            break;
+        seen = pool->generation;
+        func = pool->func;
+        func_arg = pool->arg;
+        pthread_mutex_unlock(&pool->lock);
+        
+        func(func_arg, w->id, pool->num_workers);
+        
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+lay_pool* lay_pool_create(const int num_threads) {
+    lay_pool* pool;
+    int num_workers = num_threads, i;
+    
+    if (num_workers <= 0)
+        num_workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_workers <= 1)
+        return NULL;
+    
+    pool = malloc(sizeof(lay_pool));
+    assert(pool);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->func = NULL;
+    pool->arg = NULL;
+    pool->generation = 0;
+    pool->pending = 0;
+    pool->stop = 0;
+    
+    pool->threads = malloc(sizeof(pthread_t) * (num_workers - 1));
+    pool->args = malloc(sizeof(worker_arg) * (num_workers - 1));
+    assert(pool->threads && pool->args);
+    
+    /* The calling thread is worker zero.  If a thread cannot be started, the
+       pool makes do with fewer workers. */
+    for (i = 1; i < num_workers; ++i) {
+        pool->args[i-1].pool = pool;
+        pool->args[i-1].id = i;
+        if (pthread_create(pool->threads + i - 1, NULL, worker, pool->args + i - 1) != 0)
+            break;
+    }
+    pool->num_workers = i;
+    
+    return pool;
+}
+
+int lay_pool_size(const lay_pool* pool) {
+    return (pool ? pool->num_workers : 1);
+}
+
+void lay_pool_run(lay_pool* pool, lay_pool_func func, void* arg) {
+    assert(func);
+    if (!pool || pool->num_workers == 1) {
+        func(arg, 0, 1);
+        return;
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->func = func;
+    pool->arg = arg;
+    pool->pending = pool->num_workers - 1;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    
+    func(arg, 0, pool->num_workers);
+    
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void lay_pool_destroy(lay_pool* pool) {
+    int i;
+    
+    if (!pool)
+        return;
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 1; i < pool->num_workers; ++i)
+        pthread_join(pool->threads[i-1], NULL);
+    
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool->args);
+    free(pool);
+}
@@ -0,0 +1,53 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_POOL_H
+#define LAY_POOL_H
+
+/** \file src/pool.h
+* Private pool of worker threads kept by a state between evaluations.
+*/
+
+/** A function run by every worker of a pool.  \c worker is zero for the 
+    calling thread and counts up to <tt>num_workers - 1</tt>. */
+typedef void (*lay_pool_func)(void* arg, const int worker, const int num_workers);
+
+/** A pool of threads waiting to run a function together. */
+typedef struct lay_pool lay_pool;
+
+/** Start a pool of \c num_threads workers, counting the calling thread.  If
+    \c num_threads is zero or negative, there is one per online processor.  
+    Returns NULL if only one worker would run. */
+lay_pool* lay_pool_create(const int num_threads);
+
+/** The number of workers in a pool, or one if it is NULL. */
+int lay_pool_size(const lay_pool* pool);
+
+/** Run \c func on every worker of a pool, including the calling thread, and 
+    return once all have finished.  If \c pool is NULL, \c func runs once on 
+    the calling thread. */
+void lay_pool_run(lay_pool* pool, lay_pool_func func, void* arg);
+
+/** Stop the threads of a pool and free it. */
+void lay_pool_destroy(lay_pool* pool);
+
+#endif
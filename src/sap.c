@@ -0,0 +1,235 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "broadphase.h"
+
+/** The number of bits sorted by each pass of the radix sort. */
+#define RADIX_BITS 11
+
+/** The number of passes needed to sort 32-bit keys. */
+#define RADIX_PASSES ((32 + RADIX_BITS - 1) / RADIX_BITS)
+
+/** The number of boxes tested together against one box. */
+#define SWEEP_BLOCK 16
+
+/** An unsigned key that orders like the coordinate \c x.  Coordinates are 
+    rounded to float, which keeps their order, except that some may tie. */
+static unsigned int edge_key(const lay_coord_t x) {
+    union {
+        float f;
+        unsigned int u;
+    } bits;
+
+    bits.f = (float) x;
+    if (bits.f == 0)
+        return 0x80000000u;     /* Minus zero sorts with zero. */
+    
+    /* Flip the negatives, so they order downwards below the positives. */
+    return (bits.u & 0x80000000u ? ~bits.u : bits.u | 0x80000000u);
+}
+
+/** Make room for \c count boxes. */
+static void reserve(lay_sap* sap, const int count) {
+    if (count <= sap->capacity)
+        return;
+    
+    sap->capacity = count;
+    sap->keys = realloc(sap->keys, sizeof(unsigned int) * count);
+    sap->order = realloc(sap->order, sizeof(int) * count);
+    sap->scratch_keys = realloc(sap->scratch_keys, sizeof(unsigned int) * count);
+    sap->scratch_order = realloc(sap->scratch_order, sizeof(int) * count);
+    sap->sorted = realloc(sap->sorted, sizeof(lay_coord_t) * 4 * (count + SWEEP_BLOCK));
+    assert(sap->keys && sap->order && sap->scratch_keys && sap->scratch_order && sap->sorted);
+}
+
+/** The axis along which the box centers are most spread out. */
+static int sweep_axis(const lay_coord_t* boxes, const int count) {
+    double sum[2] = {0, 0}, sum_sq[2] = {0, 0}, c, var[2];
+    int i, axis;
+    
+    for (i = 0; i < count; ++i) {
+        for (axis = 0; axis < 2; ++axis) {
+            c = 0.5 * ((double) boxes[4*i + axis] + boxes[4*i + axis + 2]);
+            sum[axis] += c;
+            sum_sq[axis] += c * c;
+        }
+    }
+    for (axis = 0; axis < 2; ++axis)
+        var[axis] = sum_sq[axis] - sum[axis] * sum[axis] / (count > 0 ? count : 1);
+    return (var[1] > var[0]);
+}
+
+/** Sort the keys and box indices by key with an LSD radix sort.  Passes on
+    digits that all the keys share are skipped. */
+static void radix_sort(lay_sap* sap, const int count) {
+    int histogram[RADIX_PASSES][1 << RADIX_BITS];
+    const unsigned int mask = (1u << RADIX_BITS) - 1;
+    unsigned int *keys = sap->keys, *out_keys = sap->scratch_keys, *swap_keys;
+    int *order = sap->order, *out_order = sap->scratch_order, *swap_order;
+    int i, pass, shift, digit, next, n;
+
+    /* All the histograms come from one read of the keys. */
+    memset(histogram, 0, sizeof(histogram));
+    for (i = 0; i < count; ++i)
+        for (pass = 0; pass < RADIX_PASSES; ++pass)
+            ++histogram[pass][(keys[i] >> (pass * RADIX_BITS)) & mask];
+
+    for (pass = 0; pass < RADIX_PASSES; ++pass) {
+        shift = pass * RADIX_BITS;
+        if (count == 0 || histogram[pass][(keys[0] >> shift) & mask] == count)
+            continue;
+
+        for (digit = 0, next = 0; digit <= (int) mask; ++digit) {
+            n = histogram[pass][digit];
+            histogram[pass][digit] = next;
+            next += n;
+        }
+        for (i = 0; i < count; ++i) {
+            digit = (keys[i] >> shift) & mask;
+            n = histogram[pass][digit]++;
+            out_keys[n] = keys[i];
+            out_order[n] = order[i];
+        }
+
+        swap_keys = keys; keys = out_keys; out_keys = swap_keys;
+        swap_order = order; order = out_order; out_order = swap_order;
+    }
+
+    /* Leave the result in the main arrays. */
+    sap->keys = keys;
+    sap->scratch_keys = out_keys;
+    sap->order = order;
+    sap->scratch_order = out_order;
+}
+
+/** The first box from \c begin whose key is greater than \c key, searching 
+    forwards in steps that double and then by bisection. */
+static int first_above(const unsigned int* keys, const int begin, const int end, 
+                       const unsigned int key) {
+    int lo = begin, hi = begin, step = 1, mid;
+    
+    /* Find a bracket: keys[lo - 1] <= key < keys[hi]. */
+    while (hi < end && keys[hi] <= key) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    if (hi > end)
+        hi = end;
+    
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (keys[mid] <= key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void lay_sap_find_pairs(lay_sap* sap, const lay_coord_t* boxes, const int count,
+                        lay_packed_pairs* pairs) {
+    unsigned char hit[SWEEP_BLOCK];
+    const lay_coord_t *lo0s, *hi0s, *lo1s, *hi1s;
+    lay_coord_t lo0, hi0, lo1, hi1;
+    int stride, i, k, l, end, axis, other;
+    
+    assert(sap && (boxes || count == 0) && count >= 0 && pairs);
+    lay_packed_pairs_clear(pairs, NULL);
+    if (count == 0)
+        return;
+    reserve(sap, count);
+    stride = sap->capacity + SWEEP_BLOCK;
+    
+    axis = sap->axis = sweep_axis(boxes, count);
+    other = 1 - axis;
+    for (i = 0; i < count; ++i) {
+        sap->keys[i] = edge_key(boxes[4*i + axis]);
+        sap->order[i] = i;
+    }
+    radix_sort(sap, count);
+    
+    /* Positions in the sweep are closer than box indices, so they pack 
+       smaller. */
+    lay_packed_pairs_clear(pairs, sap->order);
+
+    /* Gather the edges in sweep order, an array per edge, padded so that 
+       every block can be tested whole. */
+    lo0s = sap->sorted;
+    hi0s = sap->sorted + stride;
+    lo1s = sap->sorted + 2 * stride;
+    hi1s = sap->sorted + 3 * stride;
+    for (k = 0; k < count; ++k) {
+        const lay_coord_t* box = boxes + 4 * sap->order[k];
+        sap->sorted[k]              = box[axis];
+        sap->sorted[k + stride]     = box[axis + 2];
+        sap->sorted[k + 2 * stride] = box[other];
+        sap->sorted[k + 3 * stride] = box[other + 2];
+    }
+    for (k = count; k < count + SWEEP_BLOCK; ++k)
+        sap->sorted[k] = sap->sorted[k + stride] = 
+            sap->sorted[k + 2 * stride] = sap->sorted[k + 3 * stride] = 0;
+
+    for (i = 0; i < count; ++i) {
+        lo0 = lo0s[i];
+        hi0 = hi0s[i];
+        lo1 = lo1s[i];
+        hi1 = hi1s[i];
+        
+        /* The boxes that start before this one ends along the sweep axis.  
+           Keys can tie where coordinates do not, so the test below checks 
+           the coordinates as well. */
+        end = first_above(sap->keys, i + 1, count, edge_key(hi0));
+        
+        for (k = i + 1; k < end; k += SWEEP_BLOCK) {
+            /* Test a whole block without branches, so that it vectorizes, 
+               then report its hits. */
+            for (l = 0; l < SWEEP_BLOCK; ++l)
+                hit[l] = (lo0s[k+l] < hi0) & (lo0 < hi0s[k+l]) &
+                         (lo1s[k+l] < hi1) & (lo1 < hi1s[k+l]) & (k + l < end);
+            for (l = 0; l < SWEEP_BLOCK; ++l)
+                if (hit[l])
+                    lay_packed_pairs_push(pairs, k + l);
+        }
+        lay_packed_pairs_end_row(pairs, i);
+    }
+}
+
+void lay_sap_destroy(lay_sap* sap) {
+    assert(sap);
+    free(sap->keys);
+    free(sap->order);
+    free(sap->scratch_keys);
+    free(sap->scratch_order);
+    free(sap->sorted);
+    sap->keys = NULL;
+    sap->order = NULL;
+    sap->scratch_keys = NULL;
+    sap->scratch_order = NULL;
+    sap->sorted = NULL;
+    sap->capacity = 0;
+}
@@ -0,0 +1,136 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include <layout/layout.h>
+#include "sfc.h"
+#include "strided.h"
+
+/** The number of bits per axis of a curve key. */
+#define CURVE_BITS 16
+
+/** A rectangle's position along a curve. */
+typedef struct {
+    unsigned int key;   /**< The curve key. */
+    int index;          /**< The index of the rectangle. */
+} curve_entry;
+
+static int compare_curve_entries(const void* a, const void* b) {
+    const curve_entry* e1 = (const curve_entry*) a;
+    const curve_entry* e2 = (const curve_entry*) b;
+
+    if (e1->key != e2->key)
+        return (e1->key < e2->key ? -1 : 1);
+    return e1->index - e2->index;
+}
+
+/** Spread the low 16 bits of \c v out to the even bits. */
+static unsigned int spread_bits(unsigned int v) {
+    v &= 0xffff;
+    v = (v | (v << 8)) & 0x00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+/** The Morton (Z-order) key of a cell. */
+static unsigned int morton_key(const unsigned int x, const unsigned int y) {
+    return spread_bits(x) | (spread_bits(y) << 1);
+}
+
+/** The distance of a cell along the Hilbert curve that fills the grid. */
+static unsigned int hilbert_key(unsigned int x, unsigned int y) {
+    unsigned int rx, ry, s, t, d = 0;
+
+    for (s = 1u << (CURVE_BITS - 1); s > 0; s >>= 1) {
+        rx = (x & s) > 0;
+        ry = (y & s) > 0;
+        d += s * s * ((3 * rx) ^ ry);
+
+        /* Rotate the quadrant so the curve inside it starts and ends at the
+           right corners. */
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - (x & (s - 1));
+                y = s - 1 - (y & (s - 1));
+            }
+            t = x;
+            x = y;
+            y = t;
+        }
+    }
+    return d;
+}
+
+void lay_curve_order(const lay_coord_t* rect_pos, const ptrdiff_t pos_skip,
+                     const lay_extent_t* rect_size, const ptrdiff_t size_skip,
+                     const int count, const int curve, int* order) {
+    const ptrdiff_t pskip = LAY_PACKED_SKIP(pos_skip, lay_coord_t);
+    const ptrdiff_t sskip = LAY_PACKED_SKIP(size_skip, lay_extent_t);
+    const double cells = (double) ((1u << CURVE_BITS) - 1);
+    double lo[2], hi[2], scale[2], c;
+    curve_entry* entries;
+    unsigned int cell[2];
+    int i, axis;
+
+    assert((rect_pos && rect_size) || count == 0);
+    assert(curve == LAY_REORDER_MORTON || curve == LAY_REORDER_HILBERT);
+    assert(order || count == 0);
+    if (count == 0)
+        return;
+
+    /* Bound the centers. */
+    for (i = 0; i < count; ++i) {
+        const lay_coord_t* p = LAY_STRIDED(const lay_coord_t, rect_pos, pskip, i);
+        const lay_extent_t* s = LAY_STRIDED(const lay_extent_t, rect_size, sskip, i);
+        for (axis = 0; axis < 2; ++axis) {
+            c = p[axis] + 0.5 * s[axis];
+            if (i == 0 || c < lo[axis])
+                lo[axis] = c;
+            if (i == 0 || c > hi[axis])
+                hi[axis] = c;
+        }
+    }
+    for (axis = 0; axis < 2; ++axis)
+        scale[axis] = (hi[axis] > lo[axis] ? cells / (hi[axis] - lo[axis]) : 0);
+
+    entries = malloc(sizeof(curve_entry) * count);
+    assert(entries);
+    for (i = 0; i < count; ++i) {
+        const lay_coord_t* p = LAY_STRIDED(const lay_coord_t, rect_pos, pskip, i);
+        const lay_extent_t* s = LAY_STRIDED(const lay_extent_t, rect_size, sskip, i);
+        for (axis = 0; axis < 2; ++axis)
+            cell[axis] = (unsigned int) ((p[axis] + 0.5 * s[axis] - lo[axis]) * scale[axis]);
+        entries[i].key = (curve == LAY_REORDER_HILBERT ? hilbert_key(cell[0], cell[1])
+                                                       : morton_key(cell[0], cell[1]));
+        entries[i].index = i;
+    }
+
+    qsort(entries, count, sizeof(curve_entry), compare_curve_entries);
+    for (i = 0; i < count; ++i)
+        order[i] = entries[i].index;
+
+    free(entries);
+}
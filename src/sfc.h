@@ -0,0 +1,42 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_SFC_H
+#define LAY_SFC_H
+
+/** \file src/sfc.h
+* Private space-filling curve ordering of rectangles.
+*/
+
+#include <stddef.h>
+#include <layout/types.h>
+
+/** Sort rectangles along a space-filling curve through their centers.  
+    \c order receives the \c count rectangle indices in curve order.  The 
+    arrays are strided as for lay_register_rects(), and \c curve is 
+    LAY_REORDER_MORTON or LAY_REORDER_HILBERT.
+*/
+void lay_curve_order(const lay_coord_t* rect_pos, const ptrdiff_t pos_skip,
+                     const lay_extent_t* rect_size, const ptrdiff_t size_skip,
+                     const int count, const int curve, int* order);
+
+#endif
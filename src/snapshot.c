@@ -0,0 +1,477 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+/** \file src/snapshot.c
+* Saving and memory-mapped loading of layout problems.
+*/
+
+/* For mmap() */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <layout/snapshot.h>
+#include "strided.h"
+#include "state.h"
+
+/** The magic string at the start of every snapshot, including its terminator. */
+#define SNAPSHOT_MAGIC "LAYSNAP"
+
+/** The current format version. */
+#define SNAPSHOT_VERSION 3
+
+/** The size of the header.  The arrays start at multiples of SNAPSHOT_ALIGN after it. */
+#define SNAPSHOT_HEADER_SIZE 128
+
+/** The offset of the optimizer settings in version 2, just after the header. */
+#define SNAPSHOT_SETTINGS_OFFSET SNAPSHOT_HEADER_SIZE
+
+/** The size of the optimizer settings. */
+#define SNAPSHOT_SETTINGS_SIZE 128
+
+/** The size of the optimizer settings in version 3, which are followed by 
+    the offset of the fixed flags. */
+#define SNAPSHOT_SETTINGS_SIZE_3 (SNAPSHOT_SETTINGS_SIZE + 8)
+
+/** The alignment of the arrays within the file. */
+#define SNAPSHOT_ALIGN 64
+
+/** The number of array elements written at a time. */
+#define SNAPSHOT_CHUNK 4096
+
+struct lay_snapshot {
+    void* map;              /**< The mapping of the whole file. */
+    size_t length;          /**< The length of the mapping. */
+    int count;              /**< The number of rectangles. */
+    lay_coord_t* pos;       /**< The positions, inside the mapping. */
+    lay_extent_t* size;     /**< The sizes, inside the mapping. */
+};
+
+static int host_is_little_endian(void) {
+    const unsigned int one = 1;
+    return *(const unsigned char*) &one == 1;
+}
+
+/** Reverse the bytes of each of \c count elements of \c elem_size bytes. */
+static void swap_bytes(void* data, const size_t elem_size, const size_t count) {
+    unsigned char* p = (unsigned char*) data;
+    size_t i, j;
+    
+    for (i = 0; i < count; ++i, p += elem_size) {
+        for (j = 0; j < elem_size / 2; ++j) {
+            const unsigned char t = p[j];
+            p[j] = p[elem_size - 1 - j];
+            p[elem_size - 1 - j] = t;
+        }
+    }
+}
+
+static void put_u64(unsigned char* p, unsigned long long v) {
+    int i;
+    for (i = 0; i < 8; ++i, v >>= 8)
+        p[i] = (unsigned char) (v & 0xff);
+}
+
+static unsigned long long get_u64(const unsigned char* p) {
+    unsigned long long v = 0;
+    int i;
+    for (i = 7; i >= 0; --i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static void put_i32(unsigned char* p, const int v) {
+    const unsigned int u = (unsigned int) v;
+    int i;
+    for (i = 0; i < 4; ++i)
+        p[i] = (unsigned char) ((u >> (8 * i)) & 0xff);
+}
+
+static int get_i32(const unsigned char* p) {
+    unsigned int u = 0;
+    int i;
+    for (i = 3; i >= 0; --i)
+        u = (u << 8) | p[i];
+    return (int) u;
+}
+
+static void put_f64(unsigned char* p, const double d) {
+    unsigned long long v;
+    assert(sizeof(v) == sizeof(d));
+    memcpy(&v, &d, sizeof(v));
+    put_u64(p, v);
+}
+
+static double get_f64(const unsigned char* p) {
+    const unsigned long long v = get_u64(p);
+    double d;
+    memcpy(&d, &v, sizeof(d));
+    return d;
+}
+
+static size_t align_offset(const size_t offset) {
+    return (offset + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+}
+
+/** The type description stored at offset 12 of the header. */
+static void type_info(unsigned char info[4]) {
+    info[0] = (unsigned char) sizeof(lay_coord_t);
+    info[1] = ((lay_coord_t) 0.5 == 0);
+    info[2] = (unsigned char) sizeof(lay_extent_t);
+    info[3] = ((lay_extent_t) 0.5 == 0);
+}
+
+/** Store the optimizer settings of \c a at \c p. */
+static void put_settings(unsigned char* p, const macopt_args* a) {
+    put_f64(p,      a->tol);
+    put_f64(p + 8,  a->grad_tol_tiny);
+    put_f64(p + 16, a->step_tol_tiny);
+    put_f64(p + 24, a->stepmax);
+    put_f64(p + 32, a->linmin_g1);
+    put_f64(p + 40, a->linmin_g2);
+    put_f64(p + 48, a->linmin_g3);
+    put_f64(p + 56, a->lastx);
+    put_f64(p + 64, a->lastx_default);
+    put_u64(p + 72,  (unsigned long long) a->end_if_small_step);
+    put_u64(p + 80,  (unsigned long long) a->itmax);
+    put_u64(p + 88,  (unsigned long long) a->rich);
+    put_u64(p + 96,  (unsigned long long) a->verbose);
+    put_u64(p + 104, (unsigned long long) a->linmin_maxits);
+    put_u64(p + 112, (unsigned long long) a->max_evals);
+    put_u64(p + 120, (unsigned long long) a->max_ns);
+}
+
+/** Set the optimizer settings of \c a from \c p. */
+static void get_settings(const unsigned char* p, macopt_args* a) {
+    a->tol = (float) get_f64(p);
+    a->grad_tol_tiny = (float) get_f64(p + 8);
+    a->step_tol_tiny = (float) get_f64(p + 16);
+    a->stepmax = (float) get_f64(p + 24);
+    a->linmin_g1 = (float) get_f64(p + 32);
+    a->linmin_g2 = (float) get_f64(p + 40);
+    a->linmin_g3 = (float) get_f64(p + 48);
+    a->lastx = (float) get_f64(p + 56);
+    a->lastx_default = (float) get_f64(p + 64);
+    a->end_if_small_step = (int) get_u64(p + 72);
+    a->itmax = (int) get_u64(p + 80);
+    a->rich = (int) get_u64(p + 88);
+    a->verbose = (int) get_u64(p + 96);
+    a->linmin_maxits = (int) get_u64(p + 104);
+    a->max_evals = (long) get_u64(p + 112);
+    a->max_ns = (long long) get_u64(p + 120);
+}
+
+/** Whether \c v is finite, non-negative and representable as a float, as 
+    the tolerances and the margin must be. */
+static int valid_amount(const double v) {
+    return isfinite(v) && v >= 0 && v <= FLT_MAX;
+}
+
+/** Whether the settings in a version 2 \c header and its optimizer 
+    \c settings are ones the setters accept, so that a damaged file is 
+    refused instead of failing their assertions or leaving nonsense in 
+    the state. */
+static int valid_settings(const unsigned char* header, const unsigned char* settings) {
+    const int broad_phase = get_i32(header + 104);
+    const int reorder = get_i32(header + 108);
+    const int precision = get_i32(header + 112);
+    
+    return valid_amount(get_f64(header + 72)) &&
+           broad_phase >= LAY_BROAD_PHASE_AUTO && broad_phase <= LAY_BROAD_PHASE_BITSET &&
+           reorder >= LAY_REORDER_NONE && reorder <= LAY_REORDER_HILBERT &&
+           (precision == LAY_PRECISION_FLOAT || precision == LAY_PRECISION_DOUBLE) &&
+           valid_amount(get_f64(settings)) &&              /* tol */
+           valid_amount(get_f64(settings + 8)) &&          /* grad_tol_tiny */
+           valid_amount(get_f64(settings + 16)) &&         /* step_tol_tiny */
+           get_u64(settings + 80) <= INT_MAX &&            /* itmax */
+           get_u64(settings + 104) <= INT_MAX &&           /* linmin_maxits */
+           get_u64(settings + 112) <= LONG_MAX &&          /* max_evals */
+           get_u64(settings + 120) <= LLONG_MAX;           /* max_ns */
+}
+
+/** Write zeros until the file reaches \c offset. */
+static int pad_to(FILE* out, const size_t offset) {
+    long pos = ftell(out);
+    if (pos < 0)
+        return -1;
+    for (; (size_t) pos < offset; ++pos)
+        if (fputc(0, out) == EOF)
+            return -1;
+    return 0;
+}
+
+/** Write a strided array of \c count items of \c per_item elements each as
+    a tightly-packed little-endian array. */
+static int write_array(FILE* out, const void* data, const ptrdiff_t skip, 
+                       const size_t elem_size, const int per_item, const int count) {
+    unsigned char buffer[SNAPSHOT_CHUNK * 2 * 8];
+    int i, n = 0;
+    
+    assert(elem_size <= 8 && per_item <= 2);
+    for (i = 0; i < count; ++i) {
+        memcpy(buffer + n * elem_size, LAY_STRIDED(const char, data, skip, i), per_item * elem_size);
+        n += per_item;
+        if (n == per_item * SNAPSHOT_CHUNK || i == count - 1) {
+            if (!host_is_little_endian())
+                swap_bytes(buffer, elem_size, n);
+            if (fwrite(buffer, elem_size, n, out) != (size_t) n)
+                return -1;
+            n = 0;
+        }
+    }
+    return 0;
+}
+
+/** Write an optional per-rectangle array at \c offset, if it is registered. */
+static int write_optional(FILE* out, const size_t offset, const void* data, 
+                          const ptrdiff_t skip, const size_t elem_size, const int count) {
+    if (!data)
+        return 0;
+    if (pad_to(out, offset) != 0)
+        return -1;
+    return write_array(out, data, skip, elem_size, 1, count);
+}
+
+int lay_save_state(const lay_statep state, const char* filename) {
+    unsigned char header[SNAPSHOT_HEADER_SIZE], settings[SNAPSHOT_SETTINGS_SIZE_3];
+    lay_rect_arrays a;
+    const int count = lay_state_get_arrays(state, &a);
+    const size_t pos_offset = align_offset(SNAPSHOT_SETTINGS_OFFSET + SNAPSHOT_SETTINGS_SIZE_3);
+    const size_t size_offset = align_offset(pos_offset + sizeof(lay_coord_t) * 2 * count);
+    size_t margins_offset, overlap_offset, orig_pos_offset, fixed_offset, end;
+    FILE* out;
+    int result = 0;
+    
+    assert(state && filename && count >= 0);
+    assert(count == 0 || (a.pos && a.size));
+    
+    /* The optional arrays follow the sizes, in order, if they are registered. */
+    end = align_offset(size_offset + sizeof(lay_extent_t) * 2 * count);
+    margins_offset = (a.margins ? end : 0);
+    end = (a.margins ? align_offset(end + sizeof(lay_extent_t) * count) : end);
+    overlap_offset = (a.overlap_weights ? end : 0);
+    end = (a.overlap_weights ? align_offset(end + sizeof(lay_real_t) * count) : end);
+    orig_pos_offset = (a.orig_pos_weights ? end : 0);
+    end = (a.orig_pos_weights ? align_offset(end + sizeof(lay_real_t) * count) : end);
+    fixed_offset = (a.fixed ? end : 0);
+    end = (a.fixed ? align_offset(end + sizeof(int) * count) : end);
+    
+    memset(header, 0, sizeof(header));
+    memcpy(header, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header[8] = SNAPSHOT_VERSION;
+    type_info(header + 12);
+    put_u64(header + 16, count);
+    put_u64(header + 24, pos_offset);
+    put_u64(header + 32, size_offset);
+    put_f64(header + 40, lay_get_overlap_weight(state));
+    put_f64(header + 48, lay_get_edge_weight(state));
+    put_f64(header + 56, lay_get_center_weight(state));
+    put_f64(header + 64, lay_get_orig_pos_weight(state));
+    put_f64(header + 72, lay_get_margin(state));
+    put_u64(header + 80, margins_offset);
+    put_u64(header + 88, overlap_offset);
+    put_u64(header + 96, orig_pos_offset);
+    put_i32(header + 104, lay_get_broad_phase(state));
+    put_i32(header + 108, lay_get_reorder(state));
+    put_i32(header + 112, lay_get_precision(state));
+    header[116] = (unsigned char) sizeof(lay_real_t);
+    put_u64(header + 120, SNAPSHOT_SETTINGS_OFFSET);
+    put_settings(settings, lay_state_opt_args(state));
+    put_u64(settings + SNAPSHOT_SETTINGS_SIZE, fixed_offset);
+    
+    out = fopen(filename, "wb");
+    if (!out)
+        return -1;
+    
+    if (fwrite(header, 1, sizeof(header), out) != sizeof(header) ||
+        fwrite(settings, 1, sizeof(settings), out) != sizeof(settings) ||
+        pad_to(out, pos_offset) != 0 ||
+        write_array(out, a.pos, a.pos_skip, sizeof(lay_coord_t), 2, count) != 0 ||
+        pad_to(out, size_offset) != 0 ||
+        write_array(out, a.size, a.size_skip, sizeof(lay_extent_t), 2, count) != 0 ||
+        write_optional(out, margins_offset, a.margins, a.margins_skip, 
+                       sizeof(lay_extent_t), count) != 0 ||
+        write_optional(out, overlap_offset, a.overlap_weights, a.overlap_weights_skip, 
+                       sizeof(lay_real_t), count) != 0 ||
+        write_optional(out, orig_pos_offset, a.orig_pos_weights, a.orig_pos_weights_skip, 
+                       sizeof(lay_real_t), count) != 0 ||
+        write_optional(out, fixed_offset, a.fixed, a.fixed_skip, sizeof(int), count) != 0 ||
+        pad_to(out, end) != 0)
+        result = -1;
+    
+    if (fclose(out) != 0)
+        result = -1;
+    return result;
+}
+
+/** Whether an array of \c bytes at \c offset lies within a file of \c length
+    bytes and is aligned.  A zero offset is an absent array, which is valid. */
+static int valid_array(const unsigned long long offset, const unsigned long long bytes,
+                       const unsigned long long length) {
+    if (offset == 0)
+        return 1;
+    return offset % SNAPSHOT_ALIGN == 0 && offset <= length && bytes <= length - offset;
+}
+
+lay_snapshotp lay_load_state(lay_statep state, const char* filename) {
+    const unsigned char* header;
+    unsigned char info[4];
+    unsigned long long count, pos_offset, size_offset, length, version;
+    unsigned long long margins_offset = 0, overlap_offset = 0, orig_pos_offset = 0, settings_offset = 0;
+    unsigned long long settings_size = 0, fixed_offset = 0;
+    lay_snapshotp result;
+    struct stat st;
+    void* map;
+    char* base;
+    int fd;
+    
+    assert(state && filename);
+    
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size < SNAPSHOT_HEADER_SIZE) {
+        close(fd);
+        return NULL;
+    }
+    
+    /* A private mapping lets the optimizer write positions without touching the file. */
+    map = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+    
+    header = (const unsigned char*) map;
+    base = (char*) map;
+    length = (unsigned long long) st.st_size;
+    type_info(info);
+    version = get_u64(header + 8) & 0xffffffffULL;
+    count = get_u64(header + 16);
+    pos_offset = get_u64(header + 24);
+    size_offset = get_u64(header + 32);
+    
+    /* Version 1 holds only the rectangles and the penalty weights. */
+    if (version >= 2) {
+        margins_offset = get_u64(header + 80);
+        overlap_offset = get_u64(header + 88);
+        orig_pos_offset = get_u64(header + 96);
+        settings_offset = get_u64(header + 120);
+        settings_size = (version >= 3 ? SNAPSHOT_SETTINGS_SIZE_3 : SNAPSHOT_SETTINGS_SIZE);
+    }
+    
+    /* Version 3 adds the fixed flags. */
+    if (version >= 3 && settings_offset != 0 && 
+        valid_array(settings_offset, settings_size, length))
+        fixed_offset = get_u64(header + settings_offset + SNAPSHOT_SETTINGS_SIZE);
+    
+    if (memcmp(header, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+        version < 1 || version > SNAPSHOT_VERSION || memcmp(header + 12, info, 4) != 0 ||
+        (version >= 2 && header[116] != sizeof(lay_real_t)) ||
+        count > INT_MAX || pos_offset == 0 || size_offset == 0 ||
+        !valid_array(pos_offset, count * 2 * sizeof(lay_coord_t), length) ||
+        !valid_array(size_offset, count * 2 * sizeof(lay_extent_t), length) ||
+        !valid_array(margins_offset, count * sizeof(lay_extent_t), length) ||
+        !valid_array(overlap_offset, count * sizeof(lay_real_t), length) ||
+        !valid_array(orig_pos_offset, count * sizeof(lay_real_t), length) ||
+        !valid_array(fixed_offset, count * sizeof(int), length) ||
+        (version >= 2 && (settings_offset == 0 || 
+                          !valid_array(settings_offset, settings_size, length) ||
+                          !valid_settings(header, header + settings_offset)))) {
+        munmap(map, (size_t) st.st_size);
+        return NULL;
+    }
+    
+    result = malloc(sizeof(struct lay_snapshot));
+    assert(result);
+    result->map = map;
+    result->length = (size_t) st.st_size;
+    result->count = (int) count;
+    result->pos = (lay_coord_t*) (base + pos_offset);
+    result->size = (lay_extent_t*) (base + size_offset);
+    
+    if (!host_is_little_endian()) {
+        swap_bytes(result->pos, sizeof(lay_coord_t), 2 * result->count);
+        swap_bytes(result->size, sizeof(lay_extent_t), 2 * result->count);
+        if (margins_offset)
+            swap_bytes(base + margins_offset, sizeof(lay_extent_t), result->count);
+        if (overlap_offset)
+            swap_bytes(base + overlap_offset, sizeof(lay_real_t), result->count);
+        if (orig_pos_offset)
+            swap_bytes(base + orig_pos_offset, sizeof(lay_real_t), result->count);
+        if (fixed_offset)
+            swap_bytes(base + fixed_offset, sizeof(int), result->count);
+    }
+    
+    lay_set_overlap_weight(state, (lay_real_t) get_f64(header + 40));
+    lay_set_edge_weight(state, (lay_real_t) get_f64(header + 48));
+    lay_set_center_weight(state, (lay_real_t) get_f64(header + 56));
+    lay_set_orig_pos_weight(state, (lay_real_t) get_f64(header + 64));
+    if (version >= 2) {
+        lay_set_margin(state, (lay_extent_t) get_f64(header + 72));
+        lay_set_broad_phase(state, get_i32(header + 104));
+        lay_set_reorder(state, get_i32(header + 108));
+        lay_set_precision(state, get_i32(header + 112));
+        get_settings(header + settings_offset, lay_state_opt_args(state));
+    }
+    
+    lay_register_rects(state, result->pos, 0, result->size, 0, result->count);
+    if (margins_offset)
+        lay_register_margins(state, (const lay_extent_t*) (base + margins_offset), 0);
+    lay_register_weights(state, 
+                         overlap_offset ? (const lay_real_t*) (base + overlap_offset) : NULL, 0,
+                         orig_pos_offset ? (const lay_real_t*) (base + orig_pos_offset) : NULL, 0);
+    lay_register_fixed(state, fixed_offset ? (const int*) (base + fixed_offset) : NULL, 0);
+    
+    return result;
+}
+
+void lay_unload_state(lay_snapshotp snapshot) {
+    if (!snapshot)
+        return;
+    munmap(snapshot->map, snapshot->length);
+    free(snapshot);
+}
+
+int lay_snapshot_count(const lay_snapshotp snapshot) {
+    assert(snapshot);
+    return snapshot->count;
+}
+
+lay_coord_t* lay_snapshot_positions(const lay_snapshotp snapshot) {
+    assert(snapshot);
+    return snapshot->pos;
+}
+
+lay_extent_t* lay_snapshot_sizes(const lay_snapshotp snapshot) {
+    assert(snapshot);
+    return snapshot->size;
+}
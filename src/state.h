@@ -0,0 +1,81 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_STATE_H
+#define LAY_STATE_H
+
+/** \file src/state.h
+* Private access to the layout state for the modules built on lay_optimize().
+*/
+
+#include <stddef.h>
+#include <layout/layout.h>
+#include <layout/macopt.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** The per-rectangle arrays registered with a state, which eval() reads. */
+typedef struct {
+    lay_coord_t* pos;                   /**< Pointer to position data. */
+    ptrdiff_t pos_skip;                 /**< Bytes between positions. */
+    lay_extent_t* size;                 /**< Pointer to size data. */
+    ptrdiff_t size_skip;                /**< Bytes between sizes. */
+    const lay_extent_t* margins;        /**< Pointer to margins, or NULL. */
+    ptrdiff_t margins_skip;             /**< Bytes between margins. */
+    const lay_real_t* overlap_weights;  /**< Pointer to overlap weights, or NULL. */
+    ptrdiff_t overlap_weights_skip;     /**< Bytes between overlap weights. */
+    const lay_real_t* orig_pos_weights; /**< Pointer to original position weights, or NULL. */
+    ptrdiff_t orig_pos_weights_skip;    /**< Bytes between original position weights. */
+    const int* fixed;                   /**< Pointer to fixed flags, or NULL. */
+    ptrdiff_t fixed_skip;               /**< Bytes between fixed flags. */
+} lay_rect_arrays;
+
+/** Get the arrays registered with \c state, with zero skips resolved, and 
+    return the number of rectangles. */
+int lay_state_get_arrays(const lay_statep state, lay_rect_arrays* arrays);
+
+/** The optimizer arguments of \c state.  Their settings apply to both 
+    precisions; the callbacks are set by lay_optimize() itself. */
+macopt_args* lay_state_opt_args(lay_statep state);
+
+#if !defined(LAY_USE_INTEGER_COORDS)
+/** Evaluate the energy of the registered rectangles placed at the dense 
+    positions \c cur_pos, two per rectangle in registered order, with their 
+    registered positions as the original positions.  If \c grad is not NULL, 
+    the gradient is stored there in the same layout. */
+lay_real_t lay_state_eval(lay_statep state, const lay_coord_t* cur_pos, 
+                          lay_real_t* grad);
+#endif
+
+/** Copy the settings of \c from into \c to: the penalty weights, the margin,
+    the broad phase, the internal order, the precision, the number of threads
+    and the optimizer settings.  The rectangles and their per-rectangle 
+    arrays, optimizing in place and the progress callback are not copied. */
+void lay_copy_settings(lay_statep to, const lay_statep from);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,365 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+/** \file src/stream.c
+* Streaming, tile-partitioned layout.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include <layout/stream.h>
+#include <layout/batch.h>
+#include <layout/legalize.h>
+#include "state.h"
+
+/** A growable array of rectangles. */
+typedef struct {
+    int count;                  /**< The number of rectangles. */
+    int capacity;               /**< The number of rectangles allocated. */
+    lay_stream_rect* items;     /**< The rectangles. */
+} rect_buffer;
+
+/** A run of rectangles in the current row that share a tile. */
+typedef struct {
+    long long column;           /**< The tile column. */
+    int start;                  /**< The first rectangle of the tile. */
+    int end;                    /**< One past the last rectangle of the tile. */
+} tile;
+
+/** A rectangle waiting to be sorted into tiles. */
+typedef struct {
+    long long key;              /**< The sort key. */
+    int index;                  /**< The index of the rectangle in the row. */
+} tile_entry;
+
+struct lay_stream {
+    lay_statep settings;        /**< A copy of the caller's settings, applied to every tile. */
+    lay_coord_t tile_width;     /**< The width of a tile. */
+    lay_coord_t tile_height;    /**< The height of a tile. */
+    lay_coord_t halo;           /**< The reach of the halo around a tile. */
+    lay_batchp batch;           /**< The workers that optimize the tiles, kept for the life of the stream. */
+    lay_stream_emit_func emit;  /**< Receives finished tiles. */
+    void* context;              /**< Passed to \c emit. */
+    int has_row;                /**< Whether \c row is valid. */
+    long long row;              /**< The current tile row. */
+    rect_buffer cur;            /**< The rectangles of the current row. */
+    rect_buffer prev;           /**< The finished rectangles of the previous row, sorted by x. */
+    lay_extent_t prev_max_width;/**< The widest rectangle in \c prev. */
+};
+
+static void buffer_reserve(rect_buffer* b, const int capacity) {
+    assert(b);
+    if (capacity > b->capacity) {
+        b->capacity = (capacity > 2 * b->capacity ? capacity : 2 * b->capacity);
+        b->items = realloc(b->items, sizeof(lay_stream_rect) * b->capacity);
+        assert(b->items);
+    }
+}
+
+static void buffer_add(rect_buffer* b, const lay_stream_rect* r) {
+    buffer_reserve(b, b->count + 1);
+    b->items[b->count++] = *r;
+}
+
+static long long tile_index(const lay_coord_t v, const lay_coord_t size) {
+    return (long long) floor((lay_real_t) v / size);
+}
+
+static int compare_tile_entries(const void* a, const void* b) {
+    const tile_entry* e1 = (const tile_entry*) a;
+    const tile_entry* e2 = (const tile_entry*) b;
+    
+    if (e1->key != e2->key)
+        return (e1->key < e2->key ? -1 : 1);
+    return e1->index - e2->index;
+}
+
+static int compare_rect_x(const void* a, const void* b) {
+    const lay_stream_rect* r1 = (const lay_stream_rect*) a;
+    const lay_stream_rect* r2 = (const lay_stream_rect*) b;
+    
+    if (r1->pos[0] != r2->pos[0])
+        return (r1->pos[0] < r2->pos[0] ? -1 : 1);
+    return (r1->id < r2->id ? -1 : (r1->id > r2->id ? 1 : 0));
+}
+
+/** Whether rectangle \c r reaches into <tt>[x0, x1]</tt> along x. */
+static int reaches(const lay_stream_rect* r, const lay_coord_t x0, const lay_coord_t x1) {
+    return r->pos[0] <= x1 && r->pos[0] + r->size[0] >= x0;
+}
+
+/** Sort the current row by tile column, keeping the push order within a 
+    tile, and return the tiles. 
+*/
+static tile* split_tiles(lay_streamp s, int* num_tiles) {
+    const int n = s->cur.count;
+    lay_stream_rect* sorted;
+    tile_entry* entries;
+    tile* tiles;
+    int i, count = 0;
+    
+    entries = malloc(sizeof(tile_entry) * n);
+    sorted = malloc(sizeof(lay_stream_rect) * n);
+    tiles = malloc(sizeof(tile) * n);
+    assert(entries && sorted && tiles);
+    
+    for (i = 0; i < n; ++i) {
+        entries[i].key = tile_index(s->cur.items[i].pos[0], s->tile_width);
+        entries[i].index = i;
+    }
+    qsort(entries, n, sizeof(tile_entry), compare_tile_entries);
+    
+    for (i = 0; i < n; ++i) {
+        sorted[i] = s->cur.items[entries[i].index];
+        if (i == 0 || entries[i].key != entries[i-1].key) {
+            tiles[count].column = entries[i].key;
+            tiles[count].start = i;
+            ++count;
+        }
+        tiles[count-1].end = i + 1;
+    }
+    
+    memcpy(s->cur.items, sorted, sizeof(lay_stream_rect) * n);
+    free(sorted);
+    free(entries);
+    
+    *num_tiles = count;
+    return tiles;
+}
+
+/** Gather a tile's rectangles followed by its halo into \c out. */
+static void gather_tile(const lay_streamp s, const tile* tiles, const int num_tiles, 
+                        const int t, const int with_neighbors, rect_buffer* out) {
+    const lay_coord_t x0 = (lay_coord_t) (tiles[t].column * s->tile_width) - s->halo;
+    const lay_coord_t x1 = (lay_coord_t) ((tiles[t].column + 1) * s->tile_width) + s->halo;
+    const lay_coord_t y0 = (lay_coord_t) (s->row * s->tile_height) - s->halo;
+    int i, lo, hi, k;
+    
+    out->count = 0;
+    for (i = tiles[t].start; i < tiles[t].end; ++i)
+        buffer_add(out, s->cur.items + i);
+    
+    /* The previous row is sorted by x, so skip everything that ends before x0. */
+    lo = 0;
+    hi = s->prev.count;
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (s->prev.items[mid].pos[0] < x0 - s->prev_max_width)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (i = lo; i < s->prev.count && s->prev.items[i].pos[0] <= x1; ++i) {
+        const lay_stream_rect* r = s->prev.items + i;
+        if (reaches(r, x0, x1) && r->pos[1] + r->size[1] >= y0)
+            buffer_add(out, r);
+    }
+    
+    if (with_neighbors) {
+        for (k = t - 1; k <= t + 1; k += 2) {
+            if (k < 0 || k >= num_tiles || 
+                (tiles[k].column != tiles[t].column - 1 && tiles[k].column != tiles[t].column + 1))
+                continue;
+            for (i = tiles[k].start; i < tiles[k].end; ++i)
+                if (reaches(s->cur.items + i, x0, x1))
+                    buffer_add(out, s->cur.items + i);
+        }
+    }
+}
+
+/** Fix the halo of a tile, which follows the tile's \c own rectangles in 
+    problem \c p.  Returns the flags, which must outlive the optimization of 
+    \c p, or NULL if there is no halo.
+*/
+static int* fix_halo(lay_problem* p, const int own) {
+    int* fixed;
+    int i;
+    
+    if (p->count == own)
+        return NULL;
+    
+    fixed = malloc(sizeof(int) * p->count);
+    assert(fixed);
+    for (i = 0; i < p->count; ++i)
+        fixed[i] = (i >= own);
+    
+    p->fixed = fixed;
+    p->fixed_skip = 0;
+    return fixed;
+}
+
+/** Optimize the tiles of the current row whose column has the given parity. */
+static void optimize_tiles(lay_streamp s, const tile* tiles, const int num_tiles, 
+                           const int parity) {
+    rect_buffer* buffers;
+    lay_problem* problems;
+    int** fixed;
+    int* which;
+    int t, i, num_problems = 0;
+    
+    buffers = calloc(num_tiles, sizeof(rect_buffer));
+    problems = calloc(num_tiles, sizeof(lay_problem));
+    fixed = malloc(sizeof(int*) * num_tiles);
+    which = malloc(sizeof(int) * num_tiles);
+    assert(buffers && problems && fixed && which);
+    
+    for (t = 0; t < num_tiles; ++t) {
+        lay_problem* p;
+        rect_buffer* b;
+        
+        if ((tiles[t].column & 1) != parity)
+            continue;
+        
+        b = buffers + num_problems;
+        gather_tile(s, tiles, num_tiles, t, parity == 1, b);
+        
+        p = problems + num_problems;
+        p->rect_pos = b->items[0].pos;
+        p->pos_skip = sizeof(lay_stream_rect);
+        p->rect_size = b->items[0].size;
+        p->size_skip = sizeof(lay_stream_rect);
+        p->count = b->count;
+        p->overlap_weight = lay_get_overlap_weight(s->settings);
+        p->edge_weight = lay_get_edge_weight(s->settings);
+        p->center_weight = lay_get_center_weight(s->settings);
+        p->orig_pos_weight = lay_get_orig_pos_weight(s->settings);
+        p->settings = s->settings;
+        fixed[num_problems] = fix_halo(p, tiles[t].end - tiles[t].start);
+        which[num_problems++] = t;
+    }
+    
+    lay_run_batch(s->batch, problems, num_problems);
+    
+    /* Remove the residual overlaps, moving only the tile's own rectangles,
+       and keep those. */
+    for (i = 0; i < num_problems; ++i) {
+        const tile* tl = tiles + which[i];
+        lay_legalize_fixed(buffers[i].items[0].pos, sizeof(lay_stream_rect),
+                           buffers[i].items[0].size, sizeof(lay_stream_rect),
+                           fixed[i], 0, buffers[i].count);
+        memcpy(s->cur.items + tl->start, buffers[i].items, 
+               sizeof(lay_stream_rect) * (tl->end - tl->start));
+        free(buffers[i].items);
+        free(fixed[i]);
+    }
+    
+    free(buffers);
+    free(problems);
+    free(fixed);
+    free(which);
+}
+
+/** Lay out and emit the current row, which then becomes the previous row. */
+static void flush_row(lay_streamp s) {
+    rect_buffer finished;
+    tile* tiles;
+    int t, num_tiles, i;
+    
+    if (s->cur.count > 0) {
+        tiles = split_tiles(s, &num_tiles);
+        optimize_tiles(s, tiles, num_tiles, 0);
+        optimize_tiles(s, tiles, num_tiles, 1);
+        
+        for (t = 0; t < num_tiles; ++t)
+            s->emit(s->context, s->cur.items + tiles[t].start, tiles[t].end - tiles[t].start);
+        free(tiles);
+    }
+    
+    finished = s->cur;
+    s->cur = s->prev;
+    s->cur.count = 0;
+    s->prev = finished;
+    
+    qsort(s->prev.items, s->prev.count, sizeof(lay_stream_rect), compare_rect_x);
+    s->prev_max_width = 0;
+    for (i = 0; i < s->prev.count; ++i)
+        if (s->prev.items[i].size[0] > s->prev_max_width)
+            s->prev_max_width = s->prev.items[i].size[0];
+}
+
+lay_streamp lay_stream_create(const lay_statep settings, 
+                              const lay_coord_t tile_width, const lay_coord_t tile_height,
+                              const lay_coord_t halo, const int num_threads,
+                              lay_stream_emit_func emit, void* context) {
+    lay_streamp s;
+    
+    assert(settings && emit);
+    assert(tile_width > 0 && tile_height > 0 && halo >= 0);
+    
+    s = calloc(1, sizeof(struct lay_stream));
+    assert(s);
+    
+    s->settings = lay_create_state();
+    lay_copy_settings(s->settings, settings);
+    s->tile_width = tile_width;
+    s->tile_height = tile_height;
+    s->halo = halo;
+    s->batch = lay_create_batch(num_threads);
+    s->emit = emit;
+    s->context = context;
+    
+    return s;
+}
+
+void lay_stream_push(lay_streamp stream, const lay_stream_rect* rects, const int count) {
+    int i;
+    
+    assert(stream && count >= 0);
+    assert(count == 0 || rects);
+    
+    for (i = 0; i < count; ++i) {
+        const long long row = tile_index(rects[i].pos[1], stream->tile_height);
+        
+        if (!stream->has_row) {
+            stream->row = row;
+            stream->has_row = 1;
+        } else if (row > stream->row) {
+            flush_row(stream);
+            
+            /* A skipped row leaves nothing to serve as a halo. */
+            if (row > stream->row + 1)
+                stream->prev.count = 0;
+            stream->row = row;
+        }
+        buffer_add(&stream->cur, rects + i);
+    }
+}
+
+void lay_stream_finish(lay_streamp stream) {
+    assert(stream);
+    flush_row(stream);
+    stream->prev.count = 0;
+    stream->has_row = 0;
+}
+
+void lay_stream_destroy(lay_streamp stream) {
+    if (!stream)
+        return;
+    lay_destroy_batch(stream->batch);
+    lay_destroy_state(stream->settings);
+    free(stream->cur.items);
+    free(stream->prev.items);
+    free(stream);
+}
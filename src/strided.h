@@ -0,0 +1,47 @@
+/* 
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_STRIDED_H
+#define LAY_STRIDED_H
+
+/** \file src/strided.h
+* Private helpers for walking the strided arrays passed to liblayout.
+*/
+
+#include <stddef.h>
+#include <layout/types.h>
+
+/** Increment a pointer \c count times, skipping \c skip bytes each time. */
+#define LAY_INCR_POINTER(pointer, count, skip) (((char*) (pointer)) + (ptrdiff_t) (count) * (skip))
+
+/** The address of element \c i of a strided array of \c type that starts at
+    \c base and has \c skip bytes between consecutive elements.
+*/
+#define LAY_STRIDED(type, base, skip, i) ((type*) LAY_INCR_POINTER(base, i, skip))
+
+/** Resolve a zero skip to the tightly-packed stride of a pair of \c type, 
+    following the convention of lay_register_rects(). 
+*/
+#define LAY_PACKED_SKIP(skip, type) \
+    ((skip) != 0 ? (ptrdiff_t) (skip) : (ptrdiff_t) (2 * sizeof(type)))
+
+#endif
@@ -0,0 +1,172 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <layout/layout.h>
+#include "state.h"
+
+#define COUNT 300
+#define EXTENT 400
+#define LAYOUTS 4
+#define QUERIES 500
+#define TOLERANCE 1e-3
+
+/* Scatter rectangles of mixed sizes, with a few large ones, on whole
+   coordinates so that some of them touch exactly. */
+void scatter(lay_coord_t* pos, lay_extent_t* size, lay_extent_t* margins,
+             lay_real_t* overlap_weights, lay_real_t* orig_pos_weights) {
+    int i;
+
+    for (i = 0; i < COUNT; ++i) {
+        pos[2*i]   = rand() % EXTENT;
+        pos[2*i+1] = rand() % EXTENT;
+        size[2*i]   = (i % 50 == 0 ? 60 + rand() % 60 : 1 + rand() % 20);
+        size[2*i+1] = (i % 50 == 0 ? 60 + rand() % 60 : 1 + rand() % 20);
+        margins[i] = (i % 3 == 0 ? 0 : rand() % 4);
+        overlap_weights[i] = (lay_real_t) (0.5 + rand() % 4);
+        orig_pos_weights[i] = (lay_real_t) (rand() % 3);
+    }
+}
+
+/* Does rectangle i meet the closed region from (x0, y0) to (x1, y1)? */
+int meets(const lay_coord_t* pos, const lay_extent_t* size, const int i,
+          const lay_coord_t x0, const lay_coord_t y0,
+          const lay_coord_t x1, const lay_coord_t y1) {
+    return pos[2*i] <= x1 && x0 <= pos[2*i] + size[2*i] &&
+           pos[2*i+1] <= y1 && y0 <= pos[2*i+1] + size[2*i+1];
+}
+
+int compare_ints(const void* a, const void* b) {
+    return *(const int*) a - *(const int*) b;
+}
+
+/* Compare a query's results with a linear scan, and return the number of
+   mismatches. */
+int check_query(const lay_coord_t* pos, const lay_extent_t* size,
+                const lay_coord_t x0, const lay_coord_t y0,
+                const lay_coord_t x1, const lay_coord_t y1,
+                int* found, const int num_found) {
+    int expected[COUNT];
+    int i, num_expected = 0;
+
+    for (i = 0; i < COUNT; ++i) {
+        if (meets(pos, size, i, x0, y0, x1, y1))
+            expected[num_expected++] = i;
+    }
+    if (num_found != num_expected)
+        return 1;
+    qsort(found, num_found, sizeof(int), compare_ints);
+    for (i = 0; i < num_found; ++i) {
+        if (found[i] != expected[i])
+            return 1;
+    }
+    return 0;
+}
+
+/* Query regions and points of the registered rectangles, and return the
+   number of queries that disagree with a linear scan. */
+int check_queries(lay_statep state, const lay_coord_t* pos, const lay_extent_t* size) {
+    int found[COUNT];
+    int q, num_found, failed = 0;
+
+    for (q = 0; q < QUERIES; ++q) {
+        const lay_coord_t x0 = rand() % EXTENT - 20;
+        const lay_coord_t y0 = rand() % EXTENT - 20;
+        const lay_coord_t x1 = x0 + rand() % 50;
+        const lay_coord_t y1 = y0 + rand() % 50;
+
+        num_found = lay_query_region(state, x0, y0, x1, y1, found, COUNT);
+        failed += check_query(pos, size, x0, y0, x1, y1, found, num_found);
+
+        num_found = lay_query_point(state, x0, y0, found, COUNT);
+        failed += check_query(pos, size, x0, y0, x0, y0, found, num_found);
+    }
+    return failed;
+}
+
+#if !defined(LAY_USE_INTEGER_COORDS)
+/* Evaluate with every broad phase, threaded and not, at positions moved off
+   the registered ones, and return the number of evaluations whose energy or
+   gradient differs from those of LAY_BROAD_PHASE_NONE. */
+int check_broad_phases(lay_statep state, const lay_coord_t* pos) {
+    static const int broad_phases[] = {
+        LAY_BROAD_PHASE_AUTO, LAY_BROAD_PHASE_HGRID, LAY_BROAD_PHASE_BVH,
+        LAY_BROAD_PHASE_TILED, LAY_BROAD_PHASE_SAP, LAY_BROAD_PHASE_BITSET
+    };
+    lay_coord_t cur_pos[2 * COUNT];
+    lay_real_t grad[2 * COUNT], expected_grad[2 * COUNT];
+    lay_real_t energy, expected, scale = 0;
+    int b, i, threads, failed = 0;
+
+    for (i = 0; i < 2 * COUNT; ++i)
+        cur_pos[i] = pos[i] + (rand() % 9 - 4);
+
+    lay_set_num_threads(state, 1);
+    lay_set_broad_phase(state, LAY_BROAD_PHASE_NONE);
+    expected = lay_state_eval(state, cur_pos, expected_grad);
+    for (i = 0; i < 2 * COUNT; ++i)
+        scale = (fabs(expected_grad[i]) > scale ? fabs(expected_grad[i]) : scale);
+
+    for (threads = 1; threads <= 4; threads += 3) {
+        lay_set_num_threads(state, threads);
+        for (b = 0; b < (int) (sizeof(broad_phases) / sizeof(broad_phases[0])); ++b) {
+            lay_set_broad_phase(state, broad_phases[b]);
+            energy = lay_state_eval(state, cur_pos, grad);
+            if (fabs(energy - expected) > TOLERANCE * fabs(expected)) {
+                printf("Broad phase %d, %d threads: energy %g, expected %g\n",
+                       broad_phases[b], threads, energy, expected);
+                ++failed;
+                continue;
+            }
+            for (i = 0; i < 2 * COUNT; ++i) {
+                if (fabs(grad[i] - expected_grad[i]) > TOLERANCE * scale) {
+                    printf("Broad phase %d, %d threads: gradient %d is %g, expected %g\n",
+                           broad_phases[b], threads, i, grad[i], expected_grad[i]);
+                    ++failed;
+                    break;
+                }
+            }
+        }
+    }
+    lay_set_broad_phase(state, LAY_BROAD_PHASE_AUTO);
+    lay_set_num_threads(state, 1);
+    return failed;
+}
+#endif
+
+/* Check that the broad phases find the same overlaps as the pairwise
+   evaluation, and that the queries find what a linear scan finds, before and
+   after optimizing. */
+int main() {
+    lay_coord_t pos[2 * COUNT];
+    lay_extent_t size[2 * COUNT], margins[COUNT];
+    lay_real_t overlap_weights[COUNT], orig_pos_weights[COUNT];
+    lay_statep state = lay_create_state();
+    int layout, energy_failed = 0, query_failed = 0;
+
+    srand(1);
+    lay_set_overlap_weight(state, 1);
+    lay_set_orig_pos_weight(state, 0.1);
+    for (layout = 0; layout < LAYOUTS; ++layout) {
+        scatter(pos, size, margins, overlap_weights, orig_pos_weights);
+        lay_register_rects(state, pos, 0, size, 0, COUNT);
+        lay_set_margin(state, layout % 3);
+        lay_register_margins(state, (layout % 2 ? margins : NULL), 0);
+        lay_register_weights(state, overlap_weights, 0, orig_pos_weights, 0);
+
+#if !defined(LAY_USE_INTEGER_COORDS)
+        energy_failed += check_broad_phases(state, pos);
+#endif
+        query_failed += check_queries(state, pos, size);
+
+        /* The queries must follow the positions lay_optimize() moved. */
+        lay_state_opt_args(state)->itmax = 20;
+        lay_optimize(state);
+        query_failed += check_queries(state, pos, size);
+    }
+    printf("Broad phase mismatches: %d, query mismatches: %d\n", energy_failed, query_failed);
+
+    lay_destroy_state(state);
+
+    return (energy_failed > 0 || query_failed > 0 ? 1 : 0);
+}
@@ -0,0 +1,147 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <layout/layout.hpp>
+#include "state.h"
+
+#define COUNT 60
+#define EXTENT 80
+#define TOLERANCE 1e-3
+
+template <typename Coord, typename Extent>
+struct rect {
+    Coord x, y;
+    Extent w, h;
+};
+
+typedef rect<float, float> float_rect;
+typedef rect<double, double> double_rect;
+typedef lay::aos<float_rect, float, float, offsetof(float_rect, x), offsetof(float_rect, w)> float_aos;
+typedef lay::aos<double_rect, double, double, offsetof(double_rect, x), offsetof(double_rect, w)> double_aos;
+
+/* Crowd rectangles into a small square, on whole coordinates so that some
+   of them share a center or touch exactly. */
+template <typename Layout, typename Real>
+void scatter(const Layout& rects, typename Layout::extent_type* margins,
+             Real* overlap_weights, Real* orig_pos_weights) {
+    int i;
+
+    for (i = 0; i < COUNT; ++i) {
+        rects.x(i) = rand() % EXTENT;
+        rects.y(i) = rand() % EXTENT;
+        rects.w(i) = 2 + rand() % 12;
+        rects.h(i) = 2 + rand() % 12;
+        margins[i] = rand() % 3;
+        overlap_weights[i] = Real(0.5 + rand() % 4);
+        orig_pos_weights[i] = Real(rand() % 3);
+    }
+}
+
+/* Lay out the same rectangles with lay::optimize() in the layout and
+   precision given, and return non-zero unless it removes most of the
+   overlap. */
+template <typename Real, typename Layout>
+int check_optimize(const Layout& rects, const char* name) {
+    typename Layout::extent_type margins[COUNT];
+    Real overlap_weights[COUNT], orig_pos_weights[COUNT];
+    lay::penalties<Real, typename Layout::extent_type> p;
+    Real before, after;
+
+    srand(2);
+    scatter(rects, margins, overlap_weights, orig_pos_weights);
+    p.orig_pos_weight = Real(0.01);
+    p.margin = 1;
+    p.margins = margins;
+    p.overlap_weights = overlap_weights;
+    p.orig_pos_weights = orig_pos_weights;
+
+    before = lay::overlap_energy(rects, COUNT, p, static_cast<Real*>(0));
+    lay::optimize(rects, COUNT, p);
+    after = lay::overlap_energy(rects, COUNT, p, static_cast<Real*>(0));
+    printf("%s: overlap energy %g before, %g after\n", name, double(before), double(after));
+    return !(after < 0.01 * before);
+}
+
+#if !defined(LAY_USE_INTEGER_COORDS)
+typedef rect<lay_coord_t, lay_extent_t> lib_rect;
+typedef lay::aos<lib_rect, lay_coord_t, lay_extent_t, offsetof(lib_rect, x), offsetof(lib_rect, w)> lib_aos;
+
+/* Evaluate the energy and gradient of rectangles moved off their registered
+   positions with the kernels and with the library, and return non-zero if
+   they differ. */
+int check_energy() {
+    lib_rect registered[COUNT], moved[COUNT];
+    const lib_aos orig_rects(registered), rects(moved);
+    lay_coord_t orig[2 * COUNT], cur_pos[2 * COUNT];
+    lay_extent_t margins[COUNT];
+    lay_real_t overlap_weights[COUNT], orig_pos_weights[COUNT];
+    lay_real_t grad[2 * COUNT], expected_grad[2 * COUNT];
+    lay_real_t energy, expected, scale = 0;
+    lay::penalties<lay_real_t, lay_extent_t> p;
+    lay::state state;
+    int i, failed = 0;
+
+    srand(1);
+    scatter(orig_rects, margins, overlap_weights, orig_pos_weights);
+    for (i = 0; i < COUNT; ++i) {
+        moved[i] = registered[i];
+        moved[i].x += rand() % 5 - 2;
+        moved[i].y += rand() % 5 - 2;
+        orig[2*i] = registered[i].x;
+        orig[2*i+1] = registered[i].y;
+        cur_pos[2*i] = moved[i].x;
+        cur_pos[2*i+1] = moved[i].y;
+    }
+
+    state.register_rects(orig_rects, COUNT);
+    state.set_orig_pos_weight(lay_real_t(0.1));
+    lay_set_margin(state.get(), 1);
+    lay_set_broad_phase(state.get(), LAY_BROAD_PHASE_NONE);
+    lay_register_margins(state.get(), margins, 0);
+    lay_register_weights(state.get(), overlap_weights, 0, orig_pos_weights, 0);
+    expected = lay_state_eval(state.get(), cur_pos, expected_grad);
+
+    p.orig_pos_weight = lay_real_t(0.1);
+    p.margin = 1;
+    p.margins = margins;
+    p.overlap_weights = overlap_weights;
+    p.orig_pos_weights = orig_pos_weights;
+    energy = lay::energy(rects, orig, COUNT, p, grad);
+
+    printf("Energy %g, library %g\n", double(energy), double(expected));
+    if (std::fabs(energy - expected) > TOLERANCE * std::fabs(expected))
+        failed = 1;
+    for (i = 0; i < 2 * COUNT; ++i)
+        scale = (std::fabs(expected_grad[i]) > scale ? std::fabs(expected_grad[i]) : scale);
+    for (i = 0; i < 2 * COUNT; ++i) {
+        if (std::fabs(grad[i] - expected_grad[i]) > TOLERANCE * scale) {
+            printf("Gradient %d is %g, library %g\n", i, double(grad[i]), double(expected_grad[i]));
+            failed = 1;
+            break;
+        }
+    }
+    return failed;
+}
+#endif
+
+/* Check that the kernels evaluate the library's energy, and that
+   lay::optimize() lays out rectangles in each memory layout and precision,
+   whichever the library was built with. */
+int main() {
+    float_rect float_rects[COUNT];
+    double_rect double_rects[COUNT];
+    float xs[COUNT], ys[COUNT], ws[COUNT], hs[COUNT];
+    double dxs[COUNT], dys[COUNT], dws[COUNT], dhs[COUNT];
+    int failed = 0;
+
+#if !defined(LAY_USE_INTEGER_COORDS)
+    failed += check_energy();
+#endif
+    failed += check_optimize<float>(float_aos(float_rects), "float aos, float macopt");
+    failed += check_optimize<double>(double_aos(double_rects), "double aos, double macopt");
+    failed += check_optimize<double>(lay::soa<float, float>(xs, ys, ws, hs), "float soa, double macopt");
+    failed += check_optimize<float>(lay::soa<double, double>(dxs, dys, dws, dhs), "double soa, float macopt");
+
+    return (failed > 0 ? 1 : 0);
+}
@@ -23,7 +23,7 @@ void print(double* w, int its, void* context) {
 
 int main() {
     int dim = 2;
-    macopt_args args;
+    dmacopt_args args;
     double* x;
     const double epsilon = 0.001;
     
@@ -33,10 +33,10 @@ int main() {
     
     /* Check that the gradient_function is the gradient of the function  */
     /* You don't have to do this, but it is a good idea when debugging ! */
-    maccheckgrad(x, dim, epsilon, energy, NULL, vgrad_energy, NULL, 0) ;
+    dmaccheckgrad(x, dim, epsilon, energy, NULL, vgrad_energy, NULL, 0) ;
     
     /* initialize the arguments of the optimizer */
-    macopt_defaults ( &args ) ; 
+    dmacopt_defaults ( &args ) ; 
     
     /* modify macopt parameters from their default values */
     args.do_newitfunc = 1 ; /* this means that I want to have an auxiliary
@@ -48,7 +48,7 @@ int main() {
     args.verbose = 2 ; 
     
     /* Do an optimization */
-    macoptII(x, dim, vgrad_energy, NULL, &args) ;
+    dmacoptII(x, dim, vgrad_energy, NULL, &args) ;
     
     printf("Solution: %g %g: %g\n", x[1], x[2], energy(x, NULL));
     
@@ -0,0 +1,97 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <layout/layout.h>
+#include <layout/stream.h>
+
+#define TILE 64
+#define HALO 32
+#define ROWS 6
+#define COLUMNS 6
+#define PER_TILE 12
+
+typedef struct {
+    lay_stream_rect* rects;
+    int* tile;
+    int count;
+    int num_tiles;
+} collected;
+
+void emit(void* context, const lay_stream_rect* rects, const int count) {
+    collected* c = (collected*) context;
+    int i;
+    
+    assert(c && rects);
+    for (i = 0; i < count; ++i) {
+        c->rects[c->count] = rects[i];
+        c->tile[c->count] = c->num_tiles;
+        ++c->count;
+    }
+    ++c->num_tiles;
+}
+
+double overlap(const lay_stream_rect* a, const lay_stream_rect* b) {
+    double w = (a->pos[0] + a->size[0] < b->pos[0] + b->size[0] ? a->pos[0] + a->size[0] : b->pos[0] + b->size[0])
+             - (a->pos[0] > b->pos[0] ? a->pos[0] : b->pos[0]);
+    double h = (a->pos[1] + a->size[1] < b->pos[1] + b->size[1] ? a->pos[1] + a->size[1] : b->pos[1] + b->size[1])
+             - (a->pos[1] > b->pos[1] ? a->pos[1] : b->pos[1]);
+    return (w > 0 && h > 0 ? w * h : 0);
+}
+
+/* Stream crowded tiles and check that no rectangle overlaps one from another 
+   tile, which it would if the halo were pushed aside. */
+int main() {
+    const int n = ROWS * COLUMNS * PER_TILE;
+    lay_stream_rect* rects = malloc(sizeof(lay_stream_rect) * n);
+    collected c;
+    lay_statep settings;
+    lay_streamp stream;
+    double seam = 0, worst = 0, inside = 0;
+    int i, j, row, column;
+    
+    c.rects = malloc(sizeof(lay_stream_rect) * n);
+    c.tile = malloc(sizeof(int) * n);
+    c.count = c.num_tiles = 0;
+    
+    /* Crowd each tile, and put many rectangles across its seams. */
+    srand(1);
+    for (i = 0, row = 0; row < ROWS; ++row) {
+        for (column = 0; column < COLUMNS; ++column) {
+            for (j = 0; j < PER_TILE; ++j, ++i) {
+                rects[i].pos[0] = column * TILE + rand() % TILE;
+                rects[i].pos[1] = row * TILE + rand() % TILE;
+                rects[i].size[0] = 4 + rand() % 8;
+                rects[i].size[1] = 4 + rand() % 8;
+                rects[i].id = i;
+            }
+        }
+    }
+    
+    settings = lay_create_state();
+    lay_set_overlap_weight(settings, 1);
+    lay_set_orig_pos_weight(settings, 0.1);
+    stream = lay_stream_create(settings, TILE, TILE, HALO, 1, emit, &c);
+    lay_stream_push(stream, rects, n);
+    lay_stream_finish(stream);
+    assert(c.count == n);
+    
+    for (i = 0; i < n; ++i) {
+        for (j = i + 1; j < n; ++j) {
+            const double area = overlap(c.rects + i, c.rects + j);
+            if (c.tile[i] != c.tile[j]) {
+                seam += area;
+                worst = (area > worst ? area : worst);
+            } else
+                inside += area;
+        }
+    }
+    printf("Overlap across seams: %g (worst pair %g), within tiles: %g\n", seam, worst, inside);
+    
+    lay_stream_destroy(stream);
+    lay_destroy_state(settings);
+    free(c.rects);
+    free(c.tile);
+    free(rects);
+    
+    return (seam > 0 ? 1 : 0);
+}
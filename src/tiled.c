@@ -0,0 +1,156 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+
+#include "tiled.h"
+
+void lay_tiled_reserve(lay_tiled* tiled, const int count) {
+    int axis;
+
+    assert(tiled && count >= 0);
+    if (count > tiled->capacity) {
+        for (axis = 0; axis < 2; ++axis) {
+            tiled->center[axis] = realloc(tiled->center[axis], sizeof(lay_real_t) * count);
+            tiled->extent[axis] = realloc(tiled->extent[axis], sizeof(lay_real_t) * count);
+            assert(tiled->center[axis] && tiled->extent[axis]);
+        }
+        tiled->weight = realloc(tiled->weight, sizeof(lay_real_t) * count);
+        assert(tiled->weight);
+        tiled->capacity = count;
+    }
+    tiled->count = count;
+}
+
+/** Accumulate the overlaps of rectangles <tt>[i0, i1)</tt> with rectangles 
+    <tt>[j0, j1)</tt>, only counting pairs with <tt>i < j</tt>.  The 
+    gradients go into the tile buffers \c grad_i and \c grad_j, per axis and
+    indexed from the start of each tile, which may be the same buffers if 
+    the tiles are. */
+static long overlap_tiles(const lay_tiled* tiled, const int i0, const int i1,
+                          const int j0, const int j1, double* energy,
+                          lay_real_t* grad_i[2], lay_real_t* grad_j[2]) {
+    const lay_real_t *cx = tiled->center[0], *cy = tiled->center[1];
+    const lay_real_t *ex = tiled->extent[0], *ey = tiled->extent[1];
+    const lay_real_t *w = tiled->weight;
+    lay_real_t *gjx = grad_j[0] - j0, *gjy = grad_j[1] - j0;
+    lay_real_t dx, dy, ox, oy, pair_weight, gx, gy, gix, giy, sum;
+    long hits = 0;
+    int i, j;
+
+    for (i = i0; i < i1; ++i) {
+        const lay_real_t cxi = cx[i], cyi = cy[i], exi = ex[i], eyi = ey[i], wi = w[i];
+
+        gix = giy = sum = 0;
+        for (j = (i + 1 > j0 ? i + 1 : j0); j < j1; ++j) {
+            /* Most pairs are rejected by the first axis alone. */
+            dx = cx[j] - cxi;
+            ox = exi + ex[j] - LAY_REAL_ABS(dx);
+            if (ox <= 0)
+                continue;
+            dy = cy[j] - cyi;
+            oy = eyi + ey[j] - LAY_REAL_ABS(dy);
+            if (oy <= 0)
+                continue;
+
+            pair_weight = wi + w[j];
+            gx = (dx >= 0 ? 2 : -2) * oy * pair_weight;
+            gy = (dy >= 0 ? 2 : -2) * ox * pair_weight;
+            sum += pair_weight * ox * oy;
+            gix += gx;
+            giy += gy;
+            gjx[j] -= gx;
+            gjy[j] -= gy;
+            ++hits;
+        }
+
+        *energy += sum;
+        grad_i[0][i-i0] += gix;
+        grad_i[1][i-i0] += giy;
+    }
+    return hits;
+}
+
+long lay_tiled_overlap(const lay_tiled* tiled, double* energy, lay_real_t* global_grad) {
+    lay_real_t buffers[4][LAY_TILE_SIZE];
+    lay_real_t *grad_i[2], *grad_j[2];
+    const int n = tiled->count;
+    int i0, i1, j0, j1, k;
+    long hits = 0;
+
+    assert(tiled && energy);
+    grad_i[0] = buffers[0];
+    grad_i[1] = buffers[1];
+    grad_j[0] = buffers[2];
+    grad_j[1] = buffers[3];
+
+    /* The gradient costs little next to the tests, so it is always 
+       accumulated in the tile buffers and only written back if wanted. */
+    for (i0 = 0; i0 < n; i0 += LAY_TILE_SIZE) {
+        i1 = (i0 + LAY_TILE_SIZE < n ? i0 + LAY_TILE_SIZE : n);
+        for (k = 0; k < i1 - i0; ++k)
+            grad_i[0][k] = grad_i[1][k] = 0;
+
+        /* The diagonal tile accumulates into one set of buffers. */
+        hits += overlap_tiles(tiled, i0, i1, i0, i1, energy, grad_i, grad_i);
+        
+        for (j0 = i1; j0 < n; j0 += LAY_TILE_SIZE) {
+            j1 = (j0 + LAY_TILE_SIZE < n ? j0 + LAY_TILE_SIZE : n);
+            for (k = 0; k < j1 - j0; ++k)
+                grad_j[0][k] = grad_j[1][k] = 0;
+            hits += overlap_tiles(tiled, i0, i1, j0, j1, energy, grad_i, grad_j);
+            if (global_grad) {
+                for (k = j0; k < j1; ++k) {
+                    global_grad[2*k  ] += grad_j[0][k-j0];
+                    global_grad[2*k+1] += grad_j[1][k-j0];
+                }
+            }
+        }
+
+        if (global_grad) {
+            for (k = i0; k < i1; ++k) {
+                global_grad[2*k  ] += grad_i[0][k-i0];
+                global_grad[2*k+1] += grad_i[1][k-i0];
+            }
+        }
+    }
+    return hits;
+}
+
+void lay_tiled_destroy(lay_tiled* tiled) {
+    int axis;
+
+    assert(tiled);
+    for (axis = 0; axis < 2; ++axis) {
+        free(tiled->center[axis]);
+        free(tiled->extent[axis]);
+        tiled->center[axis] = NULL;
+        tiled->extent[axis] = NULL;
+    }
+    free(tiled->weight);
+    tiled->weight = NULL;
+    tiled->count = 0;
+    tiled->capacity = 0;
+}
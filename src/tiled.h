@@ -0,0 +1,62 @@
+/*
+    liblayout, an experimental 2D layout library.
+    Copyright (C) 2006 Adrian Secord.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Contact information for the author is available at http://mrl.nyu.edu/~ajsecord/
+    or send an email to ajsecord *at* cs *dot* nyu *dot* edu.
+*/
+
+#ifndef LAY_TILED_H
+#define LAY_TILED_H
+
+/** \file src/tiled.h
+* Private cache-tiled kernel for the overlap of every pair of rectangles.
+*/
+
+#include <layout/types.h>
+
+/** The number of rectangles in a tile.  Two tiles of dense data and their 
+    gradient buffers fit comfortably in a 32 KiB L1 cache. */
+#define LAY_TILE_SIZE 128
+
+/** Dense rectangle data for the tiled kernel, as separate arrays per field
+    so that the inner loop reads consecutive memory.  Rectangle \c i is given
+    by its doubled center and its extents grown by its margins, so that for
+    every pair the kernel computes the same overlap as 
+    lay_overlap_area_margin() with the pair's combined margin.
+    The storage is kept between evaluations.
+*/
+typedef struct {
+    lay_real_t* center[2];  /**< Twice the center of each rectangle, <tt>2 p + s</tt>, per axis. */
+    lay_real_t* extent[2];  /**< The extent of each rectangle plus twice its margin, per axis. */
+    lay_real_t* weight;     /**< Half the overlap weight of each rectangle. */
+    int count;              /**< The number of rectangles. */
+    int capacity;           /**< The number of rectangles allocated. */
+} lay_tiled;
+
+/** Make room for \c count rectangles and set the count. */
+void lay_tiled_reserve(lay_tiled* tiled, const int count);
+
+/** Add the weighted overlap of every pair of rectangles to \c energy and, if 
+    it is not NULL, their gradient with respect to the positions to 
+    \c global_grad.  Returns the number of overlapping pairs. */
+long lay_tiled_overlap(const lay_tiled* tiled, double* energy, lay_real_t* global_grad);
+
+/** Free the storage of a tiled kernel. */
+void lay_tiled_destroy(lay_tiled* tiled);
+
+#endif